@@ -0,0 +1,7 @@
+TIMEOUT(DURATION, log.testOK()); /* DURATION is set by run-sweep.sh */
+/* Copy all mote output to the test log in the loglistener.txt format,
+ * time in milliseconds, for log-analyzer */
+while(true) {
+  log.log(Math.floor(time / 1000) + "\tID:" + id + "\t" + msg + "\n");
+  YIELD();
+}
@@ -0,0 +1,656 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Single-pass analyzer for the Cooja logs of the GT-TSCH and
+ *         Orchestra scenarios (loglistener.txt or cooja.testlog).
+ *
+ *         Each line is "TIME ID:NODE MESSAGE", TIME in milliseconds. Matches
+ *         "SendData ID" with "RecvData ID" through a hash map from packet ID
+ *         to the pending sends, and collects the end-of-run statistics of
+ *         udp-client.c (dutycycle:, drops, controlDrops, staleDrops,
+ *         parentChange, icmpPackets). Prints a summary, or per-node and
+ *         overall figures as CSV or JSON.
+ *
+ *         Like ddr.py, a packet counts as received if its RecvData comes
+ *         after its SendData and within the latency window (10 s by default).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+/*---------------------------------------------------------------------------*/
+#define LINE_SIZE           512
+#define DEFAULT_WINDOW_MS   10000
+#define MAP_INITIAL_SIZE    1024
+#define NONE                UINT32_MAX
+
+enum format { FORMAT_TEXT, FORMAT_CSV, FORMAT_JSON };
+
+/* A SendData line not matched yet. Sends of the same packet ID are
+ * chained oldest first. */
+struct send {
+  uint64_t time;
+  uint32_t node;
+  uint32_t next;
+};
+
+/* Open addressing map from packet ID to its chain of pending sends */
+struct map_entry {
+  uint64_t id;
+  uint32_t head; /* NONE if the slot is unused */
+  uint32_t tail;
+  uint8_t used;
+};
+
+struct latency {
+  uint32_t node;
+  uint32_t ms;
+};
+
+struct node_stats {
+  uint8_t seen;
+  uint8_t has_dutycycle;
+  uint8_t has_counters;
+  unsigned long sent;
+  unsigned long received;
+  unsigned long radio_on;
+  unsigned long total_time;
+  unsigned long duty_cycle;
+  long drops;
+  long control_drops;
+  long stale_drops;
+  long parent_changes;
+  long icmp_packets;
+};
+
+/* Figures printed for one node, or for the whole run */
+struct record {
+  long node; /* -1 for the whole run */
+  unsigned long sent;
+  unsigned long received;
+  const struct latency *latencies; /* Sorted by latency */
+  size_t latency_count;
+  int has_dutycycle;
+  double radio_on;
+  double total_time;
+  double duty_cycle;
+  int has_counters;
+  double drops;
+  double control_drops;
+  double stale_drops;
+  double parent_changes;
+  double icmp_packets;
+};
+/*---------------------------------------------------------------------------*/
+static struct send *sends;
+static size_t sends_count, sends_size;
+
+static struct map_entry *map;
+static size_t map_used, map_size;
+
+static struct latency *latencies;
+static size_t latencies_count, latencies_size;
+
+static struct node_stats *nodes;
+static size_t nodes_size;
+
+static unsigned long unmatched_recv;
+static uint64_t window_ms = DEFAULT_WINDOW_MS;
+/*---------------------------------------------------------------------------*/
+static void *
+grow(void *array, size_t *size, size_t elem_size, size_t min_size)
+{
+  size_t new_size = *size ? *size : 64;
+  while(new_size < min_size) {
+    new_size *= 2;
+  }
+  if(new_size != *size) {
+    array = realloc(array, new_size * elem_size);
+    if(array == NULL) {
+      fprintf(stderr, "log-analyzer: out of memory\n");
+      exit(1);
+    }
+    *size = new_size;
+  }
+  return array;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+map_hash(uint64_t id)
+{
+  /* 64-bit mix, from splitmix64 */
+  id ^= id >> 30;
+  id *= 0xbf58476d1ce4e5b9ULL;
+  id ^= id >> 27;
+  id *= 0x94d049bb133111ebULL;
+  id ^= id >> 31;
+  return (size_t)id & (map_size - 1);
+}
+/*---------------------------------------------------------------------------*/
+static struct map_entry *
+map_get(uint64_t id, int add)
+{
+  size_t i;
+
+  if(add && (map_used + 1) * 2 > map_size) {
+    /* Keep the load under one half: rehash into a table twice as large */
+    struct map_entry *old = map;
+    size_t old_size = map_size;
+    map_size = map_size ? map_size * 2 : MAP_INITIAL_SIZE;
+    map = calloc(map_size, sizeof(struct map_entry));
+    if(map == NULL) {
+      fprintf(stderr, "log-analyzer: out of memory\n");
+      exit(1);
+    }
+    for(i = 0; i < old_size; i++) {
+      if(old[i].used) {
+        size_t j = map_hash(old[i].id);
+        while(map[j].used) {
+          j = (j + 1) & (map_size - 1);
+        }
+        map[j] = old[i];
+      }
+    }
+    free(old);
+  }
+  if(map_size == 0) {
+    return NULL;
+  }
+
+  for(i = map_hash(id); map[i].used; i = (i + 1) & (map_size - 1)) {
+    if(map[i].id == id) {
+      return &map[i];
+    }
+  }
+  if(!add) {
+    return NULL;
+  }
+  map[i].used = 1;
+  map[i].id = id;
+  map[i].head = map[i].tail = NONE;
+  map_used++;
+  return &map[i];
+}
+/*---------------------------------------------------------------------------*/
+static struct node_stats *
+node_get(unsigned long node)
+{
+  if(node >= nodes_size) {
+    size_t old_size = nodes_size;
+    nodes = grow(nodes, &nodes_size, sizeof(struct node_stats), node + 1);
+    memset(nodes + old_size, 0, (nodes_size - old_size) * sizeof(struct node_stats));
+  }
+  nodes[node].seen = 1;
+  return &nodes[node];
+}
+/*---------------------------------------------------------------------------*/
+static void
+on_send(uint64_t time, unsigned long node, uint64_t id)
+{
+  struct map_entry *e = map_get(id, 1);
+  struct send *s;
+
+  sends = grow(sends, &sends_size, sizeof(struct send), sends_count + 1);
+  s = &sends[sends_count];
+  s->time = time;
+  s->node = node;
+  s->next = NONE;
+  if(e->tail == NONE) {
+    e->head = sends_count;
+  } else {
+    sends[e->tail].next = sends_count;
+  }
+  e->tail = sends_count;
+  sends_count++;
+
+  node_get(node)->sent++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+on_recv(uint64_t time, uint64_t id)
+{
+  struct map_entry *e = map_get(id, 0);
+  struct send *s;
+
+  if(e == NULL) {
+    unmatched_recv++;
+    return;
+  }
+  /* Log lines are in time order: sends too old for this reception are
+   * too old for any later one, and are lost for good */
+  while(e->head != NONE && window_ms != 0
+        && sends[e->head].time + window_ms <= time) {
+    e->head = sends[e->head].next;
+  }
+  if(e->head == NONE || sends[e->head].time >= time) {
+    if(e->head == NONE) {
+      e->tail = NONE;
+    }
+    unmatched_recv++;
+    return;
+  }
+
+  s = &sends[e->head];
+  latencies = grow(latencies, &latencies_size, sizeof(struct latency), latencies_count + 1);
+  latencies[latencies_count].node = s->node;
+  latencies[latencies_count].ms = (uint32_t)(time - s->time);
+  latencies_count++;
+  node_get(s->node)->received++;
+
+  e->head = s->next;
+  if(e->head == NONE) {
+    e->tail = NONE;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Parses "TIME ID:NODE MESSAGE" (the node may also be a plain number) */
+static void
+parse_line(char *line)
+{
+  char *end;
+  uint64_t time;
+  unsigned long node;
+  unsigned long a, b, c;
+  long value;
+  char keyword[32];
+  struct node_stats *ns;
+
+  time = strtoull(line, &end, 10);
+  if(end == line) {
+    return;
+  }
+  line = end + strspn(end, " \t");
+  if(strncmp(line, "ID:", 3) == 0) {
+    line += 3;
+  }
+  node = strtoul(line, &end, 10);
+  if(end == line) {
+    return;
+  }
+  line = end + strspn(end, " \t:");
+
+  if(strncmp(line, "SendData ", 9) == 0) {
+    on_send(time, node, strtoull(line + 9, NULL, 10));
+  } else if(strncmp(line, "RecvData ", 9) == 0) {
+    on_recv(time, strtoull(line + 9, NULL, 10));
+  } else if(sscanf(line, "dutycycle:%lu %lu %lu", &a, &b, &c) == 3) {
+    ns = node_get(node);
+    ns->has_dutycycle = 1;
+    ns->radio_on = a;
+    ns->total_time = b;
+    ns->duty_cycle = c;
+  } else if(sscanf(line, "%31s %ld", keyword, &value) == 2) {
+    ns = node_get(node);
+    if(strcmp(keyword, "drops") == 0) {
+      ns->drops = value;
+    } else if(strcmp(keyword, "controlDrops") == 0) {
+      ns->control_drops = value;
+    } else if(strcmp(keyword, "staleDrops") == 0) {
+      ns->stale_drops = value;
+    } else if(strcmp(keyword, "parentChange") == 0) {
+      ns->parent_changes = value;
+    } else if(strcmp(keyword, "icmpPackets") == 0) {
+      ns->icmp_packets = value;
+    } else {
+      return;
+    }
+    ns->has_counters = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+latency_cmp(const void *a, const void *b)
+{
+  const struct latency *la = a;
+  const struct latency *lb = b;
+  if(la->ms != lb->ms) {
+    return la->ms < lb->ms ? -1 : 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+latency_node_cmp(const void *a, const void *b)
+{
+  const struct latency *la = a;
+  const struct latency *lb = b;
+  if(la->node != lb->node) {
+    return la->node < lb->node ? -1 : 1;
+  }
+  return latency_cmp(a, b);
+}
+/*---------------------------------------------------------------------------*/
+/* Nearest-rank percentile of sorted latencies */
+static double
+percentile(const struct record *r, unsigned p)
+{
+  size_t rank;
+  if(r->latency_count == 0) {
+    return 0;
+  }
+  rank = (r->latency_count * p + 99) / 100;
+  return r->latencies[rank > 0 ? rank - 1 : 0].ms;
+}
+/*---------------------------------------------------------------------------*/
+static double
+mean_latency(const struct record *r)
+{
+  double sum = 0;
+  size_t i;
+  for(i = 0; i < r->latency_count; i++) {
+    sum += r->latencies[i].ms;
+  }
+  return r->latency_count ? sum / r->latency_count : 0;
+}
+/*---------------------------------------------------------------------------*/
+static double
+pdr(const struct record *r)
+{
+  return r->sent ? (double)r->received / r->sent : 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_csv_header(void)
+{
+  printf("node,sent,received,lost,pdr,"
+         "latency_mean_ms,latency_p50_ms,latency_p90_ms,latency_p95_ms,latency_p99_ms,latency_max_ms,"
+         "radio_on_s,total_s,duty_cycle,"
+         "drops,control_drops,stale_drops,parent_changes,icmp_packets\n");
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_csv(const struct record *r)
+{
+  if(r->node < 0) {
+    printf("all,");
+  } else {
+    printf("%ld,", r->node);
+  }
+  printf("%lu,%lu,%lu,%.4f,", r->sent, r->received, r->sent - r->received, pdr(r));
+  if(r->latency_count) {
+    printf("%.1f,%.0f,%.0f,%.0f,%.0f,%.0f,", mean_latency(r),
+           percentile(r, 50), percentile(r, 90), percentile(r, 95),
+           percentile(r, 99), percentile(r, 100));
+  } else {
+    printf(",,,,,,");
+  }
+  if(r->has_dutycycle) {
+    printf("%.0f,%.0f,%.2f,", r->radio_on, r->total_time, r->duty_cycle);
+  } else {
+    printf(",,,");
+  }
+  if(r->has_counters) {
+    printf("%.2f,%.2f,%.2f,%.2f,%.2f\n", r->drops, r->control_drops,
+           r->stale_drops, r->parent_changes, r->icmp_packets);
+  } else {
+    printf(",,,,\n");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_json(const struct record *r, const char *indent)
+{
+  printf("{");
+  if(r->node >= 0) {
+    printf("\"node\": %ld, ", r->node);
+  }
+  printf("\"sent\": %lu, \"received\": %lu, \"lost\": %lu, \"pdr\": %.4f",
+         r->sent, r->received, r->sent - r->received, pdr(r));
+  if(r->latency_count) {
+    printf(",\n%s \"latency_ms\": {\"mean\": %.1f, \"p50\": %.0f, \"p90\": %.0f, "
+           "\"p95\": %.0f, \"p99\": %.0f, \"max\": %.0f}",
+           indent, mean_latency(r), percentile(r, 50), percentile(r, 90),
+           percentile(r, 95), percentile(r, 99), percentile(r, 100));
+  }
+  if(r->has_dutycycle) {
+    printf(",\n%s \"radio_on_s\": %.0f, \"total_s\": %.0f, \"duty_cycle\": %.2f",
+           indent, r->radio_on, r->total_time, r->duty_cycle);
+  }
+  if(r->has_counters) {
+    printf(",\n%s \"drops\": %.2f, \"control_drops\": %.2f, \"stale_drops\": %.2f, "
+           "\"parent_changes\": %.2f, \"icmp_packets\": %.2f",
+           indent, r->drops, r->control_drops, r->stale_drops,
+           r->parent_changes, r->icmp_packets);
+  }
+  printf("}");
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_text(const struct record *r)
+{
+  printf("Sent Number = %lu\n", r->sent);
+  printf("Recv Number = %lu\n", r->received);
+  printf("loss = %lu\n", r->sent - r->received);
+  printf("Delivery Ratio = %.4f\n", pdr(r));
+  printf("Unmatched RecvData = %lu\n", unmatched_recv);
+  if(r->latency_count) {
+    printf("Average E2E Delay = %.1f\n", mean_latency(r));
+    printf("E2E Delay p50/p90/p95/p99/max = %.0f/%.0f/%.0f/%.0f/%.0f\n",
+           percentile(r, 50), percentile(r, 90), percentile(r, 95),
+           percentile(r, 99), percentile(r, 100));
+  }
+  if(r->has_counters) {
+    printf("Average Queue Loss = %.2f\n", r->drops);
+    printf("Average Control Drops = %.2f\n", r->control_drops);
+    printf("Average Stale Drops = %.2f\n", r->stale_drops);
+    printf("Average Parent Changes = %.2f\n", r->parent_changes);
+    printf("Average Icmp Packets = %.2f\n", r->icmp_packets);
+  }
+  if(r->has_dutycycle) {
+    printf("Average Duty Cycle = %.2f\n", r->duty_cycle);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+report(enum format format)
+{
+  struct record all;
+  struct record r;
+  struct latency *by_node;
+  size_t node, first = 0;
+  unsigned dutycycle_nodes = 0, counter_nodes = 0;
+  int printed = 0;
+
+  /* Whole run: per-node end-of-run figures are averaged over the nodes
+   * that reported them, as ddr2.py did */
+  memset(&all, 0, sizeof(all));
+  all.node = -1;
+  all.sent = sends_count;
+  all.received = latencies_count;
+  for(node = 0; node < nodes_size; node++) {
+    const struct node_stats *ns = &nodes[node];
+    if(ns->has_dutycycle) {
+      all.radio_on += ns->radio_on;
+      all.total_time += ns->total_time;
+      all.duty_cycle += ns->duty_cycle;
+      dutycycle_nodes++;
+    }
+    if(ns->has_counters) {
+      all.drops += ns->drops;
+      all.control_drops += ns->control_drops;
+      all.stale_drops += ns->stale_drops;
+      all.parent_changes += ns->parent_changes;
+      all.icmp_packets += ns->icmp_packets;
+      counter_nodes++;
+    }
+  }
+  if(dutycycle_nodes) {
+    all.has_dutycycle = 1;
+    all.radio_on /= dutycycle_nodes;
+    all.total_time /= dutycycle_nodes;
+    all.duty_cycle /= dutycycle_nodes;
+  }
+  if(counter_nodes) {
+    all.has_counters = 1;
+    all.drops /= counter_nodes;
+    all.control_drops /= counter_nodes;
+    all.stale_drops /= counter_nodes;
+    all.parent_changes /= counter_nodes;
+    all.icmp_packets /= counter_nodes;
+  }
+
+  /* Per-node latencies: a copy sorted by node, then latency */
+  by_node = malloc((latencies_count ? latencies_count : 1) * sizeof(struct latency));
+  if(by_node == NULL) {
+    fprintf(stderr, "log-analyzer: out of memory\n");
+    exit(1);
+  }
+  memcpy(by_node, latencies, latencies_count * sizeof(struct latency));
+  qsort(by_node, latencies_count, sizeof(struct latency), latency_node_cmp);
+  qsort(latencies, latencies_count, sizeof(struct latency), latency_cmp);
+  all.latencies = latencies;
+  all.latency_count = latencies_count;
+
+  if(format == FORMAT_TEXT) {
+    print_text(&all);
+    free(by_node);
+    return;
+  }
+
+  if(format == FORMAT_CSV) {
+    print_csv_header();
+  } else {
+    printf("{\n  \"summary\": ");
+    print_json(&all, "  ");
+    printf(",\n  \"nodes\": [");
+  }
+  for(node = 0; node < nodes_size; node++) {
+    const struct node_stats *ns = &nodes[node];
+    size_t last = first;
+    while(last < latencies_count && by_node[last].node == node) {
+      last++;
+    }
+    if(ns->seen) {
+      memset(&r, 0, sizeof(r));
+      r.node = node;
+      r.sent = ns->sent;
+      r.received = ns->received;
+      r.latencies = by_node + first;
+      r.latency_count = last - first;
+      r.has_dutycycle = ns->has_dutycycle;
+      r.radio_on = ns->radio_on;
+      r.total_time = ns->total_time;
+      r.duty_cycle = ns->duty_cycle;
+      r.has_counters = ns->has_counters;
+      r.drops = ns->drops;
+      r.control_drops = ns->control_drops;
+      r.stale_drops = ns->stale_drops;
+      r.parent_changes = ns->parent_changes;
+      r.icmp_packets = ns->icmp_packets;
+      if(format == FORMAT_CSV) {
+        print_csv(&r);
+      } else {
+        printf("%s\n    ", printed ? "," : "");
+        print_json(&r, "    ");
+      }
+      printed = 1;
+    }
+    first = last;
+  }
+  if(format == FORMAT_CSV) {
+    print_csv(&all);
+  } else {
+    printf("\n  ]\n}\n");
+  }
+  free(by_node);
+}
+/*---------------------------------------------------------------------------*/
+static int
+usage(int result)
+{
+  fprintf(stderr, "Usage: log-analyzer [-f text|csv|json] [-w WINDOW_MS] [LOGFILE]\n");
+  fprintf(stderr, "       Reads LOGFILE, or standard input if none or \"-\"\n");
+  fprintf(stderr, "       -f output format (default text)\n");
+  fprintf(stderr, "       -w latency above which a packet counts as lost, 0 for none (default %d)\n",
+          DEFAULT_WINDOW_MS);
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  enum format format = FORMAT_TEXT;
+  char line[LINE_SIZE];
+  FILE *in = stdin;
+  int opt;
+
+  while((opt = getopt(argc, argv, "f:w:h")) != -1) {
+    switch(opt) {
+    case 'f':
+      if(strcmp(optarg, "text") == 0) {
+        format = FORMAT_TEXT;
+      } else if(strcmp(optarg, "csv") == 0) {
+        format = FORMAT_CSV;
+      } else if(strcmp(optarg, "json") == 0) {
+        format = FORMAT_JSON;
+      } else {
+        return usage(1);
+      }
+      break;
+    case 'w':
+      window_ms = strtoull(optarg, NULL, 10);
+      break;
+    case 'h':
+      return usage(0);
+    default:
+      return usage(1);
+    }
+  }
+  if(optind + 1 < argc) {
+    return usage(1);
+  }
+  if(optind < argc && strcmp(argv[optind], "-") != 0) {
+    in = fopen(argv[optind], "r");
+    if(in == NULL) {
+      perror(argv[optind]);
+      return 1;
+    }
+  }
+
+  while(fgets(line, sizeof(line), in) != NULL) {
+    size_t len = strlen(line);
+    if(len > 0 && line[len - 1] != '\n' && !feof(in)) {
+      /* Overlong line: parse its head, skip the rest */
+      int ch;
+      while((ch = getc(in)) != EOF && ch != '\n');
+    }
+    parse_line(line);
+  }
+  if(in != stdin) {
+    fclose(in);
+  }
+
+  report(format);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,190 @@
+#!/bin/bash
+# Runs the GT-TSCH and Orchestra scenarios headless in Cooja, with several
+# random seeds each and as many simulations in parallel as there are cores.
+# Each run is analyzed with log-analyzer and its overall figures appended to
+# OUTDIR/history.csv under the current commit. The per-scenario averages are
+# then compared with those of the previous commit in the history, and the
+# script fails if PDR, throughput, latency or duty cycle regressed.
+#
+# Usage: run-sweep.sh [-s SEEDS] [-b BASESEED] [-j JOBS] [-d DURATION_MS]
+#                     [-o OUTDIR] [SCENARIO.csc...]
+# Default: all gt-*.csc and orchestra-*.csc, 3 seeds from 1, one job per
+# core, 131 minutes (udp-client.c prints its statistics after 130).
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+CONTIKI=$(cd "$HERE/.." && pwd)
+
+SEEDS=3
+BASESEED=1
+JOBS=$(nproc 2>/dev/null || echo 1)
+DURATION=7860000
+OUTDIR=$HERE/results
+
+# Regression thresholds, relative to the previous commit
+PDR_TOLERANCE=${PDR_TOLERANCE:-0.02}           # absolute PDR drop
+THROUGHPUT_TOLERANCE=${THROUGHPUT_TOLERANCE:-0.05} # relative throughput drop
+LATENCY_TOLERANCE=${LATENCY_TOLERANCE:-0.10}   # relative mean latency increase
+DUTY_CYCLE_TOLERANCE=${DUTY_CYCLE_TOLERANCE:-0.10} # relative duty cycle increase
+
+usage() {
+  sed -n '9,13p' "$0" | sed 's/^# \{0,1\}//'
+  exit 1
+}
+
+while getopts "s:b:j:d:o:h" opt; do
+  case $opt in
+    s) SEEDS=$OPTARG ;;
+    b) BASESEED=$OPTARG ;;
+    j) JOBS=$OPTARG ;;
+    d) DURATION=$OPTARG ;;
+    o) OUTDIR=$OPTARG ;;
+    *) usage ;;
+  esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -gt 0 ]; then
+  SCENARIOS=("$@")
+else
+  SCENARIOS=("$HERE"/gt-*.csc "$HERE"/orchestra-*.csc)
+fi
+
+if COMMIT=$(git -C "$CONTIKI" rev-parse --short HEAD 2>/dev/null); then
+  git -C "$CONTIKI" diff --quiet HEAD || COMMIT=$COMMIT-dirty
+else
+  COMMIT=unknown
+fi
+RUNDIR=$OUTDIR/$COMMIT
+HISTORY=$OUTDIR/history.csv
+mkdir -p "$RUNDIR" || exit 1
+OUTDIR=$(cd "$OUTDIR" && pwd)
+RUNDIR=$OUTDIR/$COMMIT
+HISTORY=$OUTDIR/history.csv
+
+make -s -C "$HERE" log-analyzer || exit 1
+if [ ! -f "$CONTIKI/tools/cooja/dist/cooja.jar" ]; then
+  (cd "$CONTIKI/tools/cooja" && ant jar) || exit 1
+fi
+
+# Headless copy of each scenario: firmware prebuilt here rather than by
+# every Cooja instance in parallel, and a script that logs mote output and
+# ends the simulation
+SCRIPT=$(sed "s/DURATION/$DURATION/" "$HERE/headless.js")
+NAMES=()
+FIRMWARES=
+for csc in "${SCENARIOS[@]}"; do
+  name=$(basename "$csc" .csc)
+  NAMES+=("$name")
+  FIRMWARES+=$(sed -n 's/.*<firmware[^>]*>\[CONTIKI_DIR\]\/\(.*\)<\/firmware>.*/\1/p' "$csc" \
+               | sed 's/6tisch\/GT\//6tisch\/gt\//')$'\n'
+  SCRIPT=$SCRIPT awk '
+    /<source EXPORT="discard">/ || /<commands EXPORT="discard">/ { next }
+    /<\/simconf>/ {
+      print "  <plugin>"
+      print "    org.contikios.cooja.plugins.ScriptRunner"
+      print "    <plugin_config>"
+      print "      <script>" ENVIRON["SCRIPT"] "</script>"
+      print "      <active>true</active>"
+      print "    </plugin_config>"
+      print "  </plugin>"
+    }
+    { gsub("6tisch/GT/", "6tisch/gt/"); print }
+  ' "$csc" > "$RUNDIR/$name.csc" || exit 1
+done
+for firmware in $(echo "$FIRMWARES" | sort -u); do
+  echo "Building $firmware"
+  make -s -C "$CONTIKI/$(dirname "$firmware")" "$(basename "$firmware")" TARGET=z1 > /dev/null || exit 1
+done
+
+# One simulation: its own directory, as Cooja writes COOJA.testlog in the
+# working directory
+run_one() {
+  local name=$1 seed=$2
+  local dir=$RUNDIR/$name.$seed
+  mkdir -p "$dir" && cd "$dir" || return 1
+  "$CONTIKI/tests/simexec.sh" "$RUNDIR/$name.csc" "$CONTIKI" "$name" "$seed" 1 > simexec.log
+  if grep -q "TEST OK" "$name.testlog"; then
+    "$HERE/log-analyzer" -f csv "$name.$seed.scriptlog" > analysis.csv
+    echo "$name.$seed OK"
+  else
+    echo "$name.$seed FAIL, see $dir"
+  fi
+}
+export -f run_one
+export RUNDIR CONTIKI HERE
+
+echo "Running ${#NAMES[@]} scenarios x $SEEDS seeds, $JOBS in parallel, results in $RUNDIR"
+for name in "${NAMES[@]}"; do
+  for ((seed = BASESEED; seed < BASESEED + SEEDS; seed++)); do
+    echo "$name $seed"
+  done
+done | xargs -P "$JOBS" -n 2 bash -c 'run_one "$@"' _
+
+# Append the overall row of every run to the history, replacing any
+# earlier rows of this commit
+HEADER="commit,scenario,seed,sent,received,pdr,throughput_pps,latency_mean_ms,latency_p50_ms,latency_p95_ms,latency_p99_ms,duty_cycle,drops,control_drops,stale_drops,parent_changes"
+if [ -f "$HISTORY" ]; then
+  awk -F, -v c="$COMMIT" 'NR > 1 && $1 != c' "$HISTORY" > "$HISTORY.tmp"
+else
+  : > "$HISTORY.tmp"
+fi
+{
+  echo "$HEADER"
+  cat "$HISTORY.tmp"
+  for name in "${NAMES[@]}"; do
+    for ((seed = BASESEED; seed < BASESEED + SEEDS; seed++)); do
+      analysis=$RUNDIR/$name.$seed/analysis.csv
+      [ -f "$analysis" ] || continue
+      awk -F, -v c="$COMMIT" -v n="$name" -v s="$seed" -v d="$DURATION" '$1 == "all" {
+        printf "%s,%s,%s,%s,%s,%s,%.4f,%s,%s,%s,%s,%s,%s,%s,%s,%s\n",
+          c, n, s, $2, $3, $5, $3 * 1000 / d, $6, $7, $9, $10, $14, $15, $16, $17, $18
+      }' "$analysis"
+    done
+  done
+} > "$HISTORY.new"
+rm -f "$HISTORY.tmp"
+mv "$HISTORY.new" "$HISTORY"
+
+# Average each scenario over seeds, for this commit and the previous one
+# in the history, and flag regressions
+awk -F, -v c="$COMMIT" \
+    -v pdr_tol="$PDR_TOLERANCE" -v tput_tol="$THROUGHPUT_TOLERANCE" \
+    -v lat_tol="$LATENCY_TOLERANCE" -v dc_tol="$DUTY_CYCLE_TOLERANCE" '
+  NR == 1 { next }
+  {
+    if(!($1 in seen)) { seen[$1] = 1; order[ncommits++] = $1 }
+    k = $1 SUBSEP $2
+    runs[k]++; pdr[k] += $6; tput[k] += $7; lat[k] += $8; dc[k] += $12
+    if($1 == c && !($2 in scen)) { scen[$2] = 1; scenarios[nscen++] = $2 }
+  }
+  END {
+    prev = ""
+    for(i = 0; i < ncommits; i++) {
+      if(order[i] == c) break
+      prev = order[i]
+    }
+    printf "%-16s %8s %10s %10s %8s", "scenario", "pdr", "tput_pps", "lat_ms", "dc_%"
+    if(prev != "") printf "   vs %s", prev
+    printf "\n"
+    failed = 0
+    for(i = 0; i < nscen; i++) {
+      s = scenarios[i]; k = c SUBSEP s; n = runs[k]
+      p = pdr[k] / n; t = tput[k] / n; l = lat[k] / n; d = dc[k] / n
+      printf "%-16s %8.4f %10.4f %10.1f %8.2f", s, p, t, l, d
+      pk = prev SUBSEP s
+      if(prev != "" && (pk in runs)) {
+        pn = runs[pk]
+        pp = pdr[pk] / pn; pt = tput[pk] / pn; pl = lat[pk] / pn; pd = dc[pk] / pn
+        msg = ""
+        if(p < pp - pdr_tol) msg = msg " PDR"
+        if(t < pt * (1 - tput_tol)) msg = msg " THROUGHPUT"
+        if(l > pl * (1 + lat_tol)) msg = msg " LATENCY"
+        if(d > pd * (1 + dc_tol)) msg = msg " DUTY-CYCLE"
+        printf "   %+.4f %+.4f %+.1f %+.2f", p - pp, t - pt, l - pl, d - pd
+        if(msg != "") { printf "   REGRESSION:%s", msg; failed = 1 }
+      }
+      printf "\n"
+    }
+    exit failed
+  }
+' "$HISTORY"
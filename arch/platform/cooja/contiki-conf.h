@@ -50,6 +50,10 @@
 
 #define ASSERT_CONF_RETURNS  1
 
+#ifndef AES_128_CONF
+#define AES_128_CONF aes_128_ttable_driver
+#endif /* AES_128_CONF */
+
 #ifndef EEPROM_CONF_SIZE
 #define EEPROM_CONF_SIZE				1024
 #endif
@@ -56,6 +56,10 @@ int select_set_callback(int fd, const struct select_callback *callback);
 #define CC_CONF_VA_ARGS                1
 /*#define CC_CONF_INLINE                 inline*/
 
+#ifndef AES_128_CONF
+#define AES_128_CONF aes_128_ttable_driver
+#endif /* AES_128_CONF */
+
 #ifndef EEPROM_CONF_SIZE
 #define EEPROM_CONF_SIZE				1024
 #endif
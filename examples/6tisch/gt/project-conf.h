@@ -18,6 +18,13 @@
 
 #define TSCH_SCHEDULE_CONF_DEFAULT_LENGTH 32
 
+/* Set to 1 to put EB/shared, 6P control and data cells in separate slotframes,
+ * sized with TSCH_SCHEDULE_CONF_GT_{SHARED,CONTROL,DATA}_LENGTH */
+#define TSCH_SCHEDULE_CONF_GT_MULTI_SLOTFRAME 0
+
+/* Data packets get a lifetime in the TSCH queue */
+#define TSCH_CALLBACK_PACKET_READY sf_simple_callback_packet_ready
+
 
 #undef TSCH_SCHEDULE_CONF_MAX_LINKS
 #define TSCH_SCHEDULE_CONF_MAX_LINKS 32
@@ -27,12 +34,20 @@
 #define TSCH_CONF_MAX_EB_PERIOD (2 * CLOCK_SECOND)
 
 
-#define TSCH_CONF_DEFAULT_TIMESLOT_LENGTH 15000
+/* Timeslot timing template. tsch_timeslot_timing_us_15000 is there for
+ * platforms too slow for the standard 10ms timeslot: build with
+ * TSCH_STATS_CONF_SLOT_TIMING and check the 'tsch-timing' shell command */
+#define TSCH_CONF_DEFAULT_TIMESLOT_TIMING tsch_timeslot_timing_us_10000
 
 
 #undef RPL_CONF_MOP
 #define RPL_CONF_MOP RPL_MOP_NON_STORING 
 
+/* The non-storing root indexes its source routes and caches each node's
+ * path length and SRH compression, so that forwarding does not walk the
+ * node list. Costs about 12 bytes per node, plus the index (uip-sr.h) */
+#define UIP_SR_CONF_WITH_CACHE 1
+
 #undef SYS_CTRL_CONF_OSC32K_USE_XTAL
 #define SYS_CTRL_CONF_OSC32K_USE_XTAL 1
 
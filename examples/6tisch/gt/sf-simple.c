@@ -12,6 +12,7 @@
 #include "node-id.h"
 #include "lib/assert.h"
 #include "lib/list.h"
+#include "net/ipv6/uip.h"
 #include "net/mac/tsch/tsch.h"
 #include "net/mac/tsch/tsch-schedule.h"
 #include "net/mac/tsch/sixtop/sixtop.h"
@@ -25,16 +26,21 @@
 #define DEBUG DEBUG_PRINT
 #include "net/net-debug.h"
 
+/* Log configuration */
+#include "sys/log.h"
+#define LOG_MODULE "SF Simple"
+#define LOG_LEVEL LOG_LEVEL_6TOP
 
 
-static const uint16_t slotframe_handle = 0;
+
+/* Uplink/downlink cells go in the data slotframe, the parent/child cells
+ * carrying 6P (called adv links here) in the control slotframe */
+static const uint16_t slotframe_handle = TSCH_SCHEDULE_GT_DATA_HANDLE;
+static const uint16_t control_slotframe_handle = TSCH_SCHEDULE_GT_CONTROL_HANDLE;
 static uint8_t res_storage[4 + SF_SIMPLE_MAX_LINKS * 4];
 static uint8_t req_storage[4 + SF_SIMPLE_MAX_LINKS * 4];
 int check_adv_link = 0;
 
-static uint8_t two_hop_channel[8];
-static linkaddr_t children_address[8];
-
 
 static void read_cell(const uint8_t *buf, sf_simple_cell_t *cell);
 //static void print_cell_list(const uint8_t *cell_list, uint16_t cell_list_len);
@@ -50,6 +56,7 @@ static void add_adv_link_response_sent_callback(void *arg, uint16_t arg_len,
                                        sixp_output_status_t status);
                     
 static void add_uplink_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t *peer_addr);
+static void load_release_done(const linkaddr_t *peer_addr, sixp_output_status_t status);
 
 static void input(sixp_pkt_type_t type, sixp_pkt_code_t code,
                   const uint8_t *body, uint16_t body_len,
@@ -62,6 +69,7 @@ static void response_input(sixp_pkt_rc_t rc,
                            const linkaddr_t *peer_addr);
                            
 static uint16_t find_two_hop_frequency();
+static void give_back_cell(const linkaddr_t *peer_addr, sixp_pkt_cmd_t cmd, const sf_simple_cell_t *cell);
 
 
 
@@ -74,6 +82,20 @@ read_cell(const uint8_t *buf, sf_simple_cell_t *cell)
   cell->channel_offset = buf[2] + (buf[3] << 8);
 }
 
+/* Decodes a 6P cell list, up to SF_SIMPLE_MAX_LINKS cells. Returns the
+ * number of cells */
+static uint16_t
+read_cells(const uint8_t *cell_list, uint16_t cell_list_len, sf_simple_cell_t *cells)
+{
+  uint16_t count = 0;
+  uint16_t i;
+  for(i = 0; i + sizeof(sf_simple_cell_t) <= cell_list_len && count < SF_SIMPLE_MAX_LINKS;
+      i += sizeof(sf_simple_cell_t)) {
+    read_cell(&cell_list[i], &cells[count++]);
+  }
+  return count;
+}
+
 
 static void
 add_uplinks_to_schedule(const linkaddr_t *peer_addr, uint8_t link_option,
@@ -82,32 +104,54 @@ add_uplinks_to_schedule(const linkaddr_t *peer_addr, uint8_t link_option,
  
 
   
-  sf_simple_cell_t cell;
+  sf_simple_cell_t cells[SF_SIMPLE_MAX_LINKS];
+  uint8_t installed[SF_SIMPLE_MAX_LINKS];
   struct tsch_slotframe *slotframe;
-  int i;
+  uint16_t count;
+  uint16_t i;
 
   assert(cell_list != NULL);
 
-  slotframe = tsch_schedule_get_slotframe_by_handle(0);
+  slotframe = tsch_schedule_get_slotframe_by_handle(slotframe_handle);
 
   if(slotframe == NULL) {
     return;
   }
  
-  if(cell_list_len>0)
+  count = read_cells(cell_list, cell_list_len, cells);
+  if(count > 0)
   {
-      for(i = 0; i < cell_list_len; i += sizeof(cell)) 
+      /* One schedule transaction for the whole response, all or nothing */
+      if(tsch_schedule_add_links(slotframe, link_option, LINK_TYPE_NORMAL, peer_addr,
+                                 cells, count, installed) < 0)
       {
-            read_cell(&cell_list[i], &cell);
-            tsch_schedule_add_link(slotframe,
-                                 link_option, LINK_TYPE_NORMAL, peer_addr,
-                                 cell.timeslot_offset, cell.channel_offset);
-            
-        
-        
+            /* Install the valid cells in a second transaction, and hand the
+             * others back so that the parent frees its Rx cells. They are
+             * still missing from required_slots, and asked for again. */
+            uint16_t kept = 0;
+            for(i = 0; i < count; i++)
+            {
+                if(installed[i])
+                {
+                    cells[kept++] = cells[i];
+                }
+                else
+                {
+                    give_back_cell(peer_addr, SIXP_PKT_CMD_DELETE_UPLINK, &cells[i]);
+                }
+            }
+            count = kept;
+            if(count > 0
+               && tsch_schedule_add_links(slotframe, link_option, LINK_TYPE_NORMAL, peer_addr,
+                                          cells, count, NULL) < 0)
+            {
+                for(i = 0; i < count; i++)
+                {
+                    give_back_cell(peer_addr, SIXP_PKT_CMD_DELETE_UPLINK, &cells[i]);
+                }
+            }
+            sf_simple_rebalance_trigger();
       }
-      
-    
   }
 
   
@@ -115,54 +159,92 @@ add_uplinks_to_schedule(const linkaddr_t *peer_addr, uint8_t link_option,
 
 
 
-static void
+/* Installs the Rx cells granted to a child. Returns the number of cells
+ * that could not be installed, e.g. because they would break the uplink
+ * chain: the child is asked to drop them, and they stay owed to it */
+static int
 add_downlinks_to_schedule(const linkaddr_t *peer_addr, uint8_t link_option,
                       const uint8_t *cell_list, uint16_t cell_list_len)
 {
 
 
   
-  sf_simple_cell_t cell;
+  sf_simple_cell_t cells[SF_SIMPLE_MAX_LINKS];
+  uint8_t installed[SF_SIMPLE_MAX_LINKS];
   struct tsch_slotframe *slotframe;
-  int i;
+  uint16_t count;
+  uint16_t i;
+  int rejected=0;
 
   assert(cell_list != NULL);
 
-  slotframe = tsch_schedule_get_slotframe_by_handle(0);
+  slotframe = tsch_schedule_get_slotframe_by_handle(slotframe_handle);
 
   if(slotframe == NULL) {
-    return;
+    return 0;
   }
   
-  int index=find_in_send_back_by_address(peer_addr);
-
-  
-  
-  if(cell_list_len>0)
+  count = read_cells(cell_list, cell_list_len, cells);
+  if(count > 0)
   {
-      for(i = 0; i < cell_list_len; i += sizeof(cell)) 
+      uint16_t kept = 0;
+      for(i = 0; i < count; i++)
       {
-            read_cell(&cell_list[i], &cell);
-            tsch_schedule_add_link(slotframe,
-                                 link_option, LINK_TYPE_NORMAL, peer_addr,
-                                 cell.timeslot_offset, cell.channel_offset);
-            if(index>=0)
+            tsch_ledger_remove_pending(peer_addr, cells[i].timeslot_offset, cells[i].channel_offset);
+#if TSCH_SCHEDULE_GT_PIPELINE
+            /* Admission control: an Rx cell for a child must feed one of
+             * our uplinks, which may be gone since the cell was offered */
+            if(!tsch_is_coordinator
+               && dtsf_chain_next_tx(slotframe, cells[i].timeslot_offset) < 0)
             {
-                        if(send_back_number_links[index]>0)
-                        {  
-                           
-                                send_back_number_links[index] = send_back_number_links[index] -1;
-                
-                
-                        }
+                LOG_WARN("Rx ts=%u would break the uplink chain\n", cells[i].timeslot_offset);
+                give_back_cell(peer_addr, SIXP_PKT_CMD_DELETE_DOWNLINK, &cells[i]);
+                rejected++;
+                continue;
             }
-        
+#endif /* TSCH_SCHEDULE_GT_PIPELINE */
+            cells[kept++] = cells[i];
       }
-    
+      count = kept;
+      /* One schedule transaction, all or nothing */
+      if(count > 0
+         && tsch_schedule_add_links(slotframe, link_option, LINK_TYPE_NORMAL, peer_addr,
+                                    cells, count, installed) < 0)
+      {
+            /* Some cells cannot be installed: have the child drop them,
+             * and install the others in a second transaction */
+            kept = 0;
+            for(i = 0; i < count; i++)
+            {
+                if(installed[i])
+                {
+                    cells[kept++] = cells[i];
+                }
+                else
+                {
+                    give_back_cell(peer_addr, SIXP_PKT_CMD_DELETE_DOWNLINK, &cells[i]);
+                    rejected++;
+                }
+            }
+            count = kept;
+            if(count > 0
+               && tsch_schedule_add_links(slotframe, link_option, LINK_TYPE_NORMAL, peer_addr,
+                                          cells, count, NULL) < 0)
+            {
+                for(i = 0; i < count; i++)
+                {
+                    give_back_cell(peer_addr, SIXP_PKT_CMD_DELETE_DOWNLINK, &cells[i]);
+                }
+                rejected += count;
+                count = 0;
+            }
+      }
+      /* One cell less owed to this child for each installed, if we owed any */
+      tsch_ledger_remove_owed(peer_addr, count);
   }
 
 
-  
+  return rejected;
 }
 
 
@@ -172,13 +254,13 @@ delete_downlinks_from_schedule(const linkaddr_t *peer_addr,
 {
 
   
-  sf_simple_cell_t cell;
+  sf_simple_cell_t cells[SF_SIMPLE_MAX_LINKS];
   struct tsch_slotframe *slotframe;
-  int i;
+  uint16_t count;
 
   assert(cell_list != NULL);
 
-  slotframe = tsch_schedule_get_slotframe_by_handle(0);
+  slotframe = tsch_schedule_get_slotframe_by_handle(slotframe_handle);
 
   if(slotframe == NULL) {
     return -1;
@@ -186,24 +268,13 @@ delete_downlinks_from_schedule(const linkaddr_t *peer_addr,
 
   int out=0;
   
-  if(cell_list_len>0)
+  count = read_cells(cell_list, cell_list_len, cells);
+  if(count > 0)
   {
-      for(i = 0; i < cell_list_len; i += sizeof(sf_simple_cell_t)) 
-      {
-            read_cell(&cell_list[i], &cell);
-            int out=tsch_schedule_delete_link(slotframe, LINK_OPTION_RX, LINK_TYPE_NORMAL, peer_addr, cell.timeslot_offset, cell.channel_offset);
-            if( out != 1 )
-            {
-                                     printf("cannot delete the link\n");
-            }
-            else
-            {
-                out++;
-            }
-                               
-        
-      }
-      
+      /* Cells refused to keep the uplink chain were never installed, and
+       * are skipped */
+      out = tsch_schedule_delete_links(slotframe, LINK_OPTION_RX, LINK_TYPE_NORMAL, peer_addr,
+                                       cells, count, NULL);
   }
   
    return out; 
@@ -217,15 +288,16 @@ static void
 delete_uplinks_from_schedule(const linkaddr_t *peer_addr, const uint8_t *cell_list, uint16_t cell_list_len, uint8_t *cell_list_out, uint16_t* cell_list_len_out)
 {
   
-	  sf_simple_cell_t cell;
-	  
+	  sf_simple_cell_t cells[SF_SIMPLE_MAX_LINKS];
+	  uint8_t deleted[SF_SIMPLE_MAX_LINKS];
 	  sf_simple_cell_t cell_out;
 	  struct tsch_slotframe *slotframe;
-	  int i;
+	  uint16_t count;
+	  uint16_t i;
 
 	  assert(cell_list != NULL);
 
-	  slotframe = tsch_schedule_get_slotframe_by_handle(0);
+	  slotframe = tsch_schedule_get_slotframe_by_handle(slotframe_handle);
 
 	  if(slotframe == NULL) 
 	  {
@@ -235,23 +307,25 @@ delete_uplinks_from_schedule(const linkaddr_t *peer_addr, const uint8_t *cell_li
 	  
 	  
 	  int counter=0;
-	  if(cell_list_len>0)
+	  count = read_cells(cell_list, cell_list_len, cells);
+	  if(count > 0)
 	  {
-		  for(i = 0; i < cell_list_len; i += sizeof(cell)) 
+		  tsch_schedule_delete_links(slotframe, LINK_OPTION_TX, LINK_TYPE_NORMAL, peer_addr,
+		                             cells, count, deleted);
+		  for(i = 0; i < count; i++) 
 		  {
-				read_cell(&cell_list[i], &cell);
-				if(tsch_schedule_delete_link(slotframe,
-									 LINK_OPTION_TX, LINK_TYPE_NORMAL, peer_addr,
-									 cell.timeslot_offset, cell.channel_offset)!=1)
+				if(!deleted[i])
 									 {
 										 printf("cannot delete the link\n");
 									 }
 									 else
 									 {
-										 if(dtsf_check_RX_timeslot(slotframe, cell.timeslot_offset - 1, children_channel)==1)
+										 /* The Rx cells are left untouched by the batch */
+										 int rx_timeslot = dtsf_chain_prev_rx(slotframe, cells[i].timeslot_offset, children_channel);
+										 if(rx_timeslot >= 0)
 										 {
 											 cell_out.channel_offset = children_channel;
-											 cell_out.timeslot_offset= cell.timeslot_offset - 1;
+											 cell_out.timeslot_offset= rx_timeslot;
 											 memcpy(cell_list_out + counter, &cell_out,sizeof(sf_simple_cell_t));
 											  counter=counter + sizeof(sf_simple_cell_t);
 										 }
@@ -279,7 +353,7 @@ add_adv_link_to_schedule(const linkaddr_t *peer_addr, uint8_t link_option,
 
 	  assert(cell_list != NULL);
 
-	  slotframe = tsch_schedule_get_slotframe_by_handle(0);
+	  slotframe = tsch_schedule_get_slotframe_by_handle(control_slotframe_handle);
 
 	  if(slotframe == NULL) {
 		return;
@@ -293,7 +367,8 @@ add_adv_link_to_schedule(const linkaddr_t *peer_addr, uint8_t link_option,
 								 link_option, LINK_TYPE_NORMAL, peer_addr,
 								 cell.timeslot_offset, cell.channel_offset);
 			adv_timeslots++;
-			if(tsch_is_coordinator)
+			/* Only costs a data cell when both share a slotframe */
+			if(tsch_is_coordinator && control_slotframe_handle == slotframe_handle)
 			{
 			
 				free_uplink_timeslots=free_uplink_timeslots -1;
@@ -328,9 +403,20 @@ add_uplink_response_sent_callback(void *arg, uint16_t arg_len,
                             body, body_len) == 0 &&
      (nbr = sixp_nbr_find(dest_addr)) != NULL) {
     
-    add_downlinks_to_schedule(dest_addr, LINK_OPTION_RX,
+    int rejected = add_downlinks_to_schedule(dest_addr, LINK_OPTION_RX,
                           cell_list, cell_list_len);
+    /* The child asked for these cells: owe the ones we had to refuse */
+    if(rejected > 0 && (rejected = tsch_ledger_add_owed(dest_addr, rejected)) > 0)
+    {
+        required_slots = required_slots + rejected;
+    }
+  }
+  else
+  {
+    /* The child never got the cells, offer them again to anyone */
+    tsch_ledger_clear_pending(dest_addr);
   }
+  sf_simple_rebalance_trigger();
 }
 
 
@@ -356,6 +442,11 @@ add_downlink_request_sent_callback(void *arg, uint16_t arg_len,
 		 (nbr = sixp_nbr_find(dest_addr)) != NULL) {
 					add_downlinks_to_schedule(dest_addr, LINK_OPTION_RX,cell_list, cell_list_len);
 	  }
+	  else
+	  {
+		tsch_ledger_clear_pending(dest_addr);
+	  }
+	  sf_simple_rebalance_trigger();
 }
 
 static void
@@ -383,28 +474,43 @@ delete_downlink_request_sent_callback(void *arg, uint16_t arg_len,
 		int out= delete_downlinks_from_schedule(dest_addr,
 							  cell_list, cell_list_len);
 								
-			int index=find_in_send_back_by_address(dest_addr);
-		   if(index<0)
+			if(out>0)
 			{
-				index=find_free_place_in_send_back();
-												 
-				if(index<0)
+				/* We now owe these cells to the child */
+				if((out = tsch_ledger_add_owed(dest_addr, out)) > 0)
 				{
-					printf("Error: cannot find empty space in send back array\n");
+					required_slots = required_slots + out;
+				}
+				else
+				{
+					printf("Error: cannot record the cells owed to the child\n");
 				}
-				send_back_number_links[index]=0;
-				
-				send_back_address[index]=*dest_addr;
-			}
-			  
-			if(out>0)
-			{  
-			send_back_number_links[index] = send_back_number_links[index] +out;
-			required_slots = required_slots + out;
-			
 			}
 
 	  }
+	  else if(status != SIXP_OUTPUT_STATUS_SUCCESS &&
+	          sixp_pkt_get_cell_list_for_delete_downlink(SIXP_PKT_TYPE_REQUEST,
+	                            (sixp_pkt_code_t)(uint8_t)SIXP_PKT_CMD_DELETE_DOWNLINK,
+	                            &cell_list, &cell_list_len,
+	                            body, body_len) == 0)
+	  {
+	    /* The child still holds the uplinks we have no Rx cell behind:
+	     * ask it to drop them again later */
+	    sf_simple_cell_t cells[SF_SIMPLE_MAX_LINKS];
+	    struct tsch_slotframe *slotframe = tsch_schedule_get_slotframe_by_handle(slotframe_handle);
+	    uint16_t count = read_cells(cell_list, cell_list_len, cells);
+	    uint16_t i;
+	    for(i = 0; slotframe != NULL && i < count; i++)
+	    {
+	      struct tsch_link *l = tsch_schedule_get_link_by_timeslot(slotframe,
+	                              cells[i].timeslot_offset, cells[i].channel_offset);
+	      if(l == NULL || !linkaddr_cmp(&l->addr, dest_addr))
+	      {
+	        give_back_cell(dest_addr, SIXP_PKT_CMD_DELETE_DOWNLINK, &cells[i]);
+	      }
+	    }
+	  }
+	  sf_simple_rebalance_trigger();
 }
 
 static void
@@ -441,8 +547,32 @@ delete_uplink_request_sent_callback(void *arg, uint16_t arg_len,
 			}
 		}
 	}
+  else if(status != SIXP_OUTPUT_STATUS_SUCCESS &&
+          sixp_pkt_get_cell_list_for_delete_uplink(SIXP_PKT_TYPE_REQUEST,
+                            (sixp_pkt_code_t)(uint8_t)SIXP_PKT_CMD_DELETE_UPLINK,
+                            &cell_list, &cell_list_len,
+                            body, body_len) == 0)
+  {
+    /* The parent still holds Rx cells for the uplinks we never installed:
+     * give them back again later */
+    sf_simple_cell_t cells[SF_SIMPLE_MAX_LINKS];
+    struct tsch_slotframe *slotframe = tsch_schedule_get_slotframe_by_handle(slotframe_handle);
+    uint16_t count = read_cells(cell_list, cell_list_len, cells);
+    uint16_t i;
+    for(i = 0; slotframe != NULL && i < count; i++)
+    {
+      struct tsch_link *l = tsch_schedule_get_link_by_timeslot(slotframe,
+                              cells[i].timeslot_offset, cells[i].channel_offset);
+      if(l == NULL || !linkaddr_cmp(&l->addr, dest_addr))
+      {
+        give_back_cell(dest_addr, SIXP_PKT_CMD_DELETE_UPLINK, &cells[i]);
+      }
+    }
+  }
+  load_release_done(dest_addr, status);
   
   
+  sf_simple_rebalance_trigger();
 }
 
 static void
@@ -472,31 +602,19 @@ add_adv_link_response_sent_callback(void *arg, uint16_t arg_len,
 			for(i = 0; i < cell_list_len; i += sizeof(cell)) 
 			{
 				read_cell(&cell_list[i], &cell);
-				int out= delete_from_cell_list_reserved(cell.timeslot_offset,cell.channel_offset);
-				if(out!=1)
+				if(tsch_ledger_remove_pending(dest_addr, cell.timeslot_offset, cell.channel_offset)!=1)
 				{
 					printf("error: cannot delete slot\n");
 				}
 			
 			}
 	  }
-}
-
-void set_children_channel(const linkaddr_t *dest_addr,int channel)
-{
-    int i;
-    for(i=0;i<8;i++)
-    {
-        if(two_hop_channel[i]==0)
-        {
-            two_hop_channel[i]=channel;
-            children_address[i]=*dest_addr;
-            return;
-        }
-            
-    }
-    
-    printf("error: no empty space in two_hop_channel\n");
+	  else
+	  {
+		/* The child never got the cells, offer them again to anyone */
+		tsch_ledger_clear_pending(dest_addr);
+	  }
+	  sf_simple_rebalance_trigger();
 }
 
 static void
@@ -520,7 +638,10 @@ channel_response_sent_callback(void *arg, uint16_t arg_len,
 		 {
 			// printf("callback for channel channel=%d\n",channel);
 			 channel=sixp_pkt_get_channel(SIXP_PKT_TYPE_RESPONSE, (sixp_pkt_code_t)(uint8_t)SIXP_PKT_RC_SUCCESS, body, body_len);
-			 set_children_channel(dest_addr,channel);
+			 if(tsch_ledger_set_channel(dest_addr,channel)==0)
+			 {
+				 printf("error: cannot record the channel of the child\n");
+			 }
 			 struct tsch_neighbor *n = NULL;
 			 n = tsch_queue_get_nbr(dest_addr);
 			 n->frequency_offset=channel;
@@ -570,18 +691,16 @@ add_uplink_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t *p
    uint32_t index=0;
 
   // printf("number of cells=%d\n",(int)number_of_cells);
-  if(need_send_back==0)
-  {
-    index = dtsf_find_free_uplink_slot(slotframe, channel_offset, number_of_cells, cell_list, peer_addr ); 
-  }
-   // printf("index=%d\n",(int)index);
-   
    if(allocate_slot_for_packet_generation==0)
    {
-       index=0;
                        printf("error: cannot dedicate timeslot as node needs them for the packet generation\n");
 
    }
+   else if(tsch_ledger_owed_total()==0)
+   {
+    index = dtsf_find_free_uplink_slot(slotframe, channel_offset, number_of_cells, cell_list, peer_addr ); 
+   }
+   // printf("index=%d\n",(int)index);
   
     
     if (index < 1)
@@ -598,32 +717,19 @@ add_uplink_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t *p
 
             
             
-                 need_send_back=1;
-                 int j = find_in_send_back_by_address(peer_addr);
-                 if(j>=0)
+                 /* Owe the missing cells to the child, unless it is already owed some */
+                 struct tsch_ledger_entry *e = tsch_ledger_get(peer_addr);
+                 if(e == NULL || e->owed == 0)
                  {
-                     if(send_back_number_links[j]==0)
+                     uint8_t owed = tsch_ledger_add_owed(peer_addr, number_of_cells - index);
+                     if(owed > 0)
                      {
-                                     required_slots = required_slots + (number_of_cells - index);
-                       send_back_number_links[j]= send_back_number_links[j] + number_of_cells - index;
+                         required_slots = required_slots + owed;
+                     }
+                     else
+                     {
+                         printf("error in recording the cells owed to the child\n");
                      }
-                 }
-                 else
-                 {
-                        j=find_free_place_in_send_back();
-                        if(j>=0)
-                        {
-                                        required_slots = required_slots + (number_of_cells - index);
-                            send_back_number_links[j]= number_of_cells - index;
-                            send_back_address[j]= *peer_addr;
-                        }
-                        else
-                        {
-                            
-                            printf("error in finding empty space in Send_Back_Array\n");
-                            printf("j=%d",j);
-                        }
-                     
                  }
                  
    
@@ -661,11 +767,14 @@ add_uplink_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t *p
       
      
           printf("sending uplink response\n");
-      sixp_output(SIXP_PKT_TYPE_RESPONSE,
+      if(sixp_output(SIXP_PKT_TYPE_RESPONSE,
                   (sixp_pkt_code_t)(uint8_t)SIXP_PKT_RC_SUCCESS,
                   SF_SIMPLE_SFID,
                   res_storage, res_len, peer_addr,
-                  add_uplink_response_sent_callback, res_storage, res_len);
+                  add_uplink_response_sent_callback, res_storage, res_len) < 0)
+      {
+          tsch_ledger_clear_pending(peer_addr);
+      }
 
 }
 
@@ -816,8 +925,6 @@ delete_uplink_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t
          const uint8_t *cell_list;
          uint16_t cell_list_len=0;
          
-          int j=0;
-         
          
           
           
@@ -840,13 +947,8 @@ delete_uplink_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t
             
         }
         
-       j= find_in_send_back_by_address(peer_addr);
-       
-       if(j>0)
-       {
-           required_slots = required_slots - send_back_number_links[j];
-           send_back_number_links[j]=0;
-       }
+       /* The child gave up its uplinks, forget what we owed to it */
+       required_slots = required_slots - tsch_ledger_remove_owed(peer_addr, 0xff);
 
 }
 
@@ -856,16 +958,23 @@ void  dtsf_send_add_downlink()
     
         sf_simple_cell_t cell;
         
-        int i=find_first_place_in_send_back();
-        if(i<0)
+        /* Serve the first owed child that is not already in a 6P
+         * transaction, the others are served when it completes */
+        struct tsch_ledger_entry *e = tsch_ledger_first_owed();
+        while(e != NULL && sixp_trans_find(tsch_ledger_get_addr(e)) != NULL)
+        {
+            e = tsch_ledger_next_owed(e);
+        }
+        if(e == NULL)
         {
            // printf("Error: Cannot find any send back cases\n");
             return;
         }
+        const linkaddr_t *child_addr = tsch_ledger_get_addr(e);
         
         printf("start sendback procedure\n");
         
-        int number_of_cells= send_back_number_links[i];
+        int number_of_cells= e->owed;
         
         
        // printf("number=%d",number_of_cells);
@@ -890,7 +999,7 @@ void  dtsf_send_add_downlink()
    uint32_t index=0;
 
   // printf("number of cells=%d\n",(int)number_of_cells);
-    index = dtsf_find_free_uplink_slot(slotframe, channel_offset, number_of_cells, cell_list, &send_back_address[i]); 
+    index = dtsf_find_free_uplink_slot(slotframe, channel_offset, number_of_cells, cell_list, child_addr); 
     //printf("index=%d\n",(int)index);
    
     if (index < 1)
@@ -927,12 +1036,15 @@ void  dtsf_send_add_downlink()
           req_len += sizeof(cell);
 
       }
-      printf("Send an add downlink to child %d\n", send_back_address[i].u8[7]);
+      printf("Send an add downlink to child %d\n", child_addr->u8[7]);
      
-      sixp_output(SIXP_PKT_TYPE_REQUEST, (sixp_pkt_code_t)(uint8_t)SIXP_PKT_CMD_ADD_DOWNLINKS,
+      if(sixp_output(SIXP_PKT_TYPE_REQUEST, (sixp_pkt_code_t)(uint8_t)SIXP_PKT_CMD_ADD_DOWNLINKS,
                   SF_SIMPLE_SFID,
-                  req_storage, req_len, &send_back_address[i],
-                  add_downlink_request_sent_callback, req_storage, req_len);
+                  req_storage, req_len, child_addr,
+                  add_downlink_request_sent_callback, req_storage, req_len) < 0)
+      {
+          tsch_ledger_clear_pending(child_addr);
+      }
     
 }
 
@@ -1085,7 +1197,7 @@ add_adv_link_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t
  
   // uint16_t channel_offset= children_channel;
   uint16_t channel_offset= children_channel;
-   slotframe = tsch_schedule_get_slotframe_by_handle(slotframe_handle);
+   slotframe = tsch_schedule_get_slotframe_by_handle(control_slotframe_handle);
    if(slotframe == NULL) 
    {
     printf("slotframe is null\n");
@@ -1144,22 +1256,6 @@ add_adv_link_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t
 }
 
 
-int look_in_children_channel(const linkaddr_t *peer_addr)
-{
-    
-    int i;
-    for(i=0;i<8;i++)
-    {
-        
-        if(linkaddr_cmp(&children_address[i],peer_addr) && two_hop_channel[i]!=0)
-        {
-            return two_hop_channel[i];
-        }
-    }
-    return 0;
-}
-
-
 static void
 ask_channel_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t *peer_addr)
 {
@@ -1177,7 +1273,7 @@ ask_channel_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t *
    uint16_t res_len;
    uint16_t channel;
 
-   int ch = look_in_children_channel(peer_addr);
+   int ch = tsch_ledger_get_channel(peer_addr);
    if(ch!=0)
    {
         channel = ch;
@@ -1235,8 +1331,8 @@ input(sixp_pkt_type_t type, sixp_pkt_code_t code,
       break;
   }
   
- 
-  
+  /* Any 6P exchange may have moved cells, see if the budget needs work */
+  sf_simple_rebalance_trigger();
 }
 
 static void
@@ -1364,81 +1460,18 @@ response_input(sixp_pkt_rc_t rc,
   }
 }
 
-int check_children_channel(int in)
-{
-    int i;
-    for(i=0;i<8;i++)
-    {
-        if(two_hop_channel[i]==in)
-        {
-            return 1;
-        }
-        
-    }
-    
-    return 0;
-}
-
 static uint16_t
 find_two_hop_frequency()
 {
-    
-   
      if(children_channel==0 || parent_channel==0)
      {
           printf("error:children_chann=%d , parent_channel=%d",children_channel,parent_channel);
          return -1;
      }
-   
-	int rand= random_rand()%tsch_hopping_sequence_length.val;
-    int i;
-    for(i=rand;i<tsch_hopping_sequence_length.val;i++)
-    {
-       
-        if(i!=parent_channel  && i!=default_channel  && i!=children_channel)
-        {
-            //printf("just_before_check  %d\n",tsch_hopping_sequence_length.val);
 
-            if(check_children_channel(i)==0)
-            {
-             
-            //  printf("children channe=%d\n",i);
-              
-              return i;  
-                
-            }
-        
-            
-        }
-        
-    }
-    
-    
-    for(i=rand;i>-1;i--)
-    {
-       
-        if(i!=parent_channel  && i!=default_channel  && i!=children_channel)
-        {
-            //printf("just_before_check  %d\n",tsch_hopping_sequence_length.val);
-
-            if(check_children_channel(i)==0)
-            {
-             
-           //   printf("children channe=%d\n",i);
-              
-              return i;  
-                
-            }
-        
-            
-        }
-        
-    }
-    
-    
-    printf("Error in selecting two-hop channel\n");
-    return -1;
-      
+    /* Least conflicting channel given our other children and the
+     * channels announced in the EBs we hear */
+    return tsch_coloring_select();
 }
 
 
@@ -1492,33 +1525,324 @@ int dtsf_ask_adv_link(const linkaddr_t* peer_addr, uint32_t number_of_links)
 
 
 
+/*---------------------------------------------------------------------------*/
+/* GT-TSCH rebalancing. Rather than the application polling the budget every
+ * few seconds, every 6P exchange pokes this process, which hands cells owed
+ * to children when we have free uplinks, or asks the parent for more
+ * otherwise. Each transaction carries all the cells needed from or for one
+ * neighbor, so a request converges in a single round-trip. */
+PROCESS(sf_simple_rebalance_process, "GT-TSCH rebalance");
+
+static linkaddr_t rebalance_parent;
+
+/* EWMA of the backlog towards the parent, as in link-stats */
+#define EWMA_SCALE 100
+#define EWMA_ALPHA 20
+static uint16_t backlog_ewma; /* In 1/SF_SIMPLE_BACKLOG_DIVISOR packets */
+static uint8_t load_cells; /* Uplinks asked for because of the backlog */
+static uint8_t load_release_pending; /* A load-driven uplink is being released */
+static uint8_t load_hold; /* Samples left before the next change */
+
+/* Cells a neighbor holds with nothing behind them on our side, given back
+ * with a 6P delete request once no other transaction with it is running.
+ * Until then, the neighbor keeps them in its schedule:
+ * - uplinks a parent granted that we could not install, e.g. because they
+ *   clash with a cell we already have: a delete uplink request has the
+ *   parent free its Rx cells;
+ * - uplinks a child holds with no Rx cell behind them, because installing
+ *   it would have broken the uplink chain: a delete downlink request has
+ *   the child drop them.
+ * One entry per neighbor and request, so that any number of children can
+ * be waiting for a repair at once. */
+static struct {
+  linkaddr_t peer;
+  uint8_t cmd;
+  uint8_t count;
+  sf_simple_cell_t cells[SF_SIMPLE_MAX_LINKS];
+} give_back[SF_SIMPLE_GIVE_BACK_PEERS];
+
 static void
-timeout(sixp_pkt_cmd_t cmd, const linkaddr_t *peer_addr)
+give_back_cell(const linkaddr_t *peer_addr, sixp_pkt_cmd_t cmd, const sf_simple_cell_t *cell)
 {
+  int i;
+  int j;
+  int free_entry = -1;
+  for(i = 0; i < SF_SIMPLE_GIVE_BACK_PEERS; i++)
+  {
+    if(give_back[i].count == 0)
+    {
+      if(free_entry < 0)
+      {
+        free_entry = i;
+      }
+    }
+    else if(give_back[i].cmd == cmd && linkaddr_cmp(&give_back[i].peer, peer_addr))
+    {
+      break;
+    }
+  }
+  if(i == SF_SIMPLE_GIVE_BACK_PEERS)
+  {
+    if(free_entry < 0)
+    {
+      LOG_ERR("cannot give ts=%u back, too many neighbors\n", cell->timeslot_offset);
+      return;
+    }
+    i = free_entry;
+    linkaddr_copy(&give_back[i].peer, peer_addr);
+    give_back[i].cmd = cmd;
+  }
+  for(j = 0; j < give_back[i].count; j++)
+  {
+    if(give_back[i].cells[j].timeslot_offset == cell->timeslot_offset)
+    {
+      return;
+    }
+  }
+  if(give_back[i].count < SF_SIMPLE_MAX_LINKS)
+  {
+    LOG_INFO("giving ts=%u back\n", cell->timeslot_offset);
+    give_back[i].cells[give_back[i].count++] = *cell;
+  }
+}
 
+/* Sends one pending delete request, if any can go.
+ * Returns 1 if one was sent */
+static int
+send_give_back(void)
+{
+  int i;
+  for(i = 0; i < SF_SIMPLE_GIVE_BACK_PEERS; i++)
+  {
+    if(give_back[i].count > 0 && sixp_trans_find(&give_back[i].peer) == NULL)
+    {
+      if(give_back[i].cmd == SIXP_PKT_CMD_DELETE_UPLINK)
+      {
+        dtsf_send_delete_uplink(&give_back[i].peer, give_back[i].cells, give_back[i].count);
+      }
+      else
+      {
+        dtsf_send_delete_downlink(&give_back[i].peer, give_back[i].cells, give_back[i].count);
+      }
+      /* Kept if the request could not go out, for the next pass */
+      if(sixp_trans_find(&give_back[i].peer) != NULL)
+      {
+        give_back[i].count = 0;
+        return 1;
+      }
+    }
+  }
+  return 0;
 }
 
 static void
-init()
+rebalance(void)
 {
-    int i;
-    for(i=0;i<8;i++)
+  if(send_give_back())
+  {
+    /* One request at a time, the rest goes once it is over */
+    return;
+  }
+  if(tsch_ledger_owed_total() > 0 && free_uplink_timeslots > 0)
+  {
+    dtsf_send_add_downlink();
+  }
+  else if(required_slots > 0 && check_ask_uplink == 1
+          && !linkaddr_cmp(&rebalance_parent, &linkaddr_null)
+          && sixp_trans_find(&rebalance_parent) == NULL)
+  {
+    printf("Asking uplink %d\n", required_slots);
+    dtsf_send_add_uplink(&rebalance_parent, required_slots);
+  }
+}
+
+/* Looks for a spare uplink (not reserved for a child nor for our own
+ * generation rate) that has no Rx cell right before it */
+static int
+find_spare_uplink(sf_simple_cell_t *cell)
+{
+  struct tsch_slotframe *slotframe = tsch_schedule_get_slotframe_by_handle(slotframe_handle);
+  struct tsch_link *l;
+  struct tsch_link *prev;
+  uint16_t timeslot;
+
+  if(slotframe == NULL)
+  {
+    return 0;
+  }
+  /* Release from the end of the slotframe, as dtsf_find_last_uplinks does */
+  for(timeslot = slotframe->size.val - 1; timeslot > 0; timeslot--)
+  {
+    l = tsch_schedule_get_link_by_just_timeslot(slotframe, timeslot);
+    if(l == NULL || l->link_options != LINK_OPTION_TX || l->link_type != LINK_TYPE_NORMAL
+       || l->reserved != 0 || !linkaddr_cmp(&l->addr, &rebalance_parent))
     {
-        two_hop_channel[i]=0;
+      continue;
     }
+    prev = tsch_schedule_get_link_by_just_timeslot(slotframe, timeslot - 1);
+    if((prev != NULL && (prev->link_options & LINK_OPTION_RX))
+       || dtsf_chain_prev_rx(slotframe, timeslot, children_channel) >= 0)
+    {
+      continue;
+    }
+    cell->timeslot_offset = l->timeslot;
+    cell->channel_offset = l->channel_offset;
+    return 1;
+  }
+  return 0;
+}
+
+/* Samples the backlog towards the parent and asks for, or releases, one
+ * uplink when its average leaves the [LOW, HIGH] band.
+ * Returns 1 if the cell budget changed */
+static int
+adapt_to_backlog(void)
+{
+  sf_simple_cell_t cell;
+  int backlog = tsch_queue_packet_count(&rebalance_parent);
+
+  if(backlog < 0)
+  {
+    backlog = 0;
+  }
+  backlog_ewma = ((uint32_t)backlog_ewma * (EWMA_SCALE - EWMA_ALPHA) +
+                  (uint32_t)backlog * SF_SIMPLE_BACKLOG_DIVISOR * EWMA_ALPHA) / EWMA_SCALE;
+
+  if(load_hold > 0)
+  {
+    load_hold--;
+    return 0;
+  }
+  /* Only adapt when nothing else is in progress, so that load-driven
+   * requests never mix with rate-driven or children-driven ones */
+  if(required_slots > 0 || tsch_ledger_owed_total() > 0
+     || sixp_trans_find(&rebalance_parent) != NULL)
+  {
+    return 0;
+  }
+
+  if(backlog_ewma > SF_SIMPLE_BACKLOG_HIGH
+     && load_cells < SF_SIMPLE_LOAD_MAX_CELLS && check_ask_uplink == 1)
+  {
+    required_slots++;
+    load_cells++;
+    load_hold = SF_SIMPLE_LOAD_HOLD;
+    return 1;
+  }
+  if(backlog_ewma < SF_SIMPLE_BACKLOG_LOW && load_cells > 0
+     && free_uplink_timeslots > 0 && find_spare_uplink(&cell))
+  {
+    LOG_INFO("releasing uplink ts=%u, backlog is low\n", cell.timeslot_offset);
+    dtsf_send_delete_uplink(&rebalance_parent, &cell, 1);
+    /* load_cells goes down once the request is through, see
+     * load_release_done */
+    load_release_pending = sixp_trans_find(&rebalance_parent) != NULL;
+    load_hold = SF_SIMPLE_LOAD_HOLD;
+  }
+  return 0;
+}
+
+/* Called when a delete uplink request is over: the load-driven uplink is
+ * gone only if the request went through */
+static void
+load_release_done(const linkaddr_t *peer_addr, sixp_output_status_t status)
+{
+  if(load_release_pending && linkaddr_cmp(peer_addr, &rebalance_parent))
+  {
+    load_release_pending = 0;
+    if(status == SIXP_OUTPUT_STATUS_SUCCESS && load_cells > 0)
+    {
+      load_cells--;
+    }
+  }
+}
+
+PROCESS_THREAD(sf_simple_rebalance_process, ev, data)
+{
+  static struct etimer backstop;
+  static struct etimer sample_timer;
+  static int changed;
+
+  PROCESS_BEGIN();
+
+  backlog_ewma = 0;
+  load_cells = 0;
+  load_release_pending = 0;
+  load_hold = 0;
+  etimer_set(&sample_timer, SF_SIMPLE_LOAD_SAMPLE_PERIOD);
+
+  while(1)
+  {
+    rebalance();
+    etimer_set(&backstop, SF_SIMPLE_REBALANCE_BACKSTOP);
+    /* Backlog samples alone do not wake the rebalancing up, unless they
+     * changed the budget */
+    changed = 0;
+    while(!changed)
+    {
+      PROCESS_WAIT_EVENT();
+      if(ev == PROCESS_EVENT_POLL || (ev == PROCESS_EVENT_TIMER && data == &backstop))
+      {
+        break;
+      }
+      if(ev == PROCESS_EVENT_TIMER && data == &sample_timer)
+      {
+        etimer_reset(&sample_timer);
+        changed = adapt_to_backlog();
+      }
+    }
+  }
+
+  PROCESS_END();
+}
+
+void
+sf_simple_rebalance_start(const linkaddr_t *parent_addr)
+{
+  linkaddr_copy(&rebalance_parent, parent_addr);
+  if(process_is_running(&sf_simple_rebalance_process))
+  {
+    process_poll(&sf_simple_rebalance_process);
+  }
+  else
+  {
+    process_start(&sf_simple_rebalance_process, NULL);
+  }
+}
+
+void
+sf_simple_rebalance_trigger(void)
+{
+  if(process_is_running(&sf_simple_rebalance_process))
+  {
+    process_poll(&sf_simple_rebalance_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+
+static void
+timeout(sixp_pkt_cmd_t cmd, const linkaddr_t *peer_addr)
+{
+  /* The transaction is gone, whatever it was waiting for can be retried */
+  sf_simple_rebalance_trigger();
+}
+
+static void
+init()
+{
    // printf("init\n");
    if(tsch_is_coordinator)
    {
-       children_channel=node_id%8;
+       children_channel=node_id%sizeof(TSCH_DEFAULT_HOPPING_SEQUENCE);
        //printf("set parent channel\n");
        parent_channel=children_channel;
        
-       shared_timeslot_children=TSCH_SCHEDULE_CONF_DEFAULT_LENGTH-1;
-       shared_timeslot_parent=TSCH_SCHEDULE_CONF_DEFAULT_LENGTH-1;
+       shared_timeslot_children=tsch_gt_config.shared_length-1;
+       shared_timeslot_parent=tsch_gt_config.shared_length-1;
       
        allocate_slot_for_packet_generation=1;
        
-       free_uplink_timeslots=TSCH_SCHEDULE_CONF_DEFAULT_LENGTH;
+       free_uplink_timeslots=tsch_gt_config.data_length;
        
        check_shared_timeslot=1;
        
@@ -1526,6 +1850,19 @@ init()
   
 }
 
+/*---------------------------------------------------------------------------*/
+int
+sf_simple_callback_packet_ready(void)
+{
+#if TSCH_QUEUE_WITH_DEADLINES
+  /* Only application data: 6P and RPL messages keep their own timers */
+  if(!packetbuf_attr(PACKETBUF_ATTR_MAC_METADATA)
+     && packetbuf_attr(PACKETBUF_ATTR_NETWORK_ID) == UIP_PROTO_UDP) {
+    packetbuf_set_attr(PACKETBUF_ATTR_TSCH_LIFETIME, SF_SIMPLE_DATA_LIFETIME);
+  }
+#endif /* TSCH_QUEUE_WITH_DEADLINES */
+  return 0;
+}
 
 const sixtop_sf_t sf_simple_driver = {
   SF_SIMPLE_SFID,
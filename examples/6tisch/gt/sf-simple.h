@@ -24,9 +24,83 @@ void  dtsf_send_delete_downlink(const linkaddr_t* peer_addr, sf_simple_cell_t* c
 int dtsf_send_add_uplink(const linkaddr_t *peer_addr, uint32_t number_of_links);
 void  dtsf_send_delete_uplink(const linkaddr_t* peer_addr, sf_simple_cell_t* cell_list, uint16_t cell_list_len);
 
+/* Start the rebalancing process once the node has joined, with the parent
+ * it asks uplinks from. Calling it again switches to a new parent. */
+void sf_simple_rebalance_start(const linkaddr_t *parent_addr);
+/* Ask the rebalancing process to look at the cell budget again. Events are
+ * coalesced: many triggers before the process runs cost one pass. */
+void sf_simple_rebalance_trigger(void);
+
 extern int check_adv_link;
 #define SF_SIMPLE_MAX_LINKS  20
 #define SF_SIMPLE_SFID       0x00
+
+/* Safety net in case an event is lost: the budget is also looked at this often */
+#ifdef SF_SIMPLE_CONF_REBALANCE_BACKSTOP
+#define SF_SIMPLE_REBALANCE_BACKSTOP SF_SIMPLE_CONF_REBALANCE_BACKSTOP
+#else
+#define SF_SIMPLE_REBALANCE_BACKSTOP (30 * CLOCK_SECOND)
+#endif
+
+/* How often the backlog towards the parent is sampled */
+#ifdef SF_SIMPLE_CONF_LOAD_SAMPLE_PERIOD
+#define SF_SIMPLE_LOAD_SAMPLE_PERIOD SF_SIMPLE_CONF_LOAD_SAMPLE_PERIOD
+#else
+#define SF_SIMPLE_LOAD_SAMPLE_PERIOD CLOCK_SECOND
+#endif
+
+/* The averaged backlog, and the thresholds below, are in
+ * 1/SF_SIMPLE_BACKLOG_DIVISOR packets */
+#define SF_SIMPLE_BACKLOG_DIVISOR 16
+
+/* Averaged backlog above which one more uplink is asked for */
+#ifdef SF_SIMPLE_CONF_BACKLOG_HIGH
+#define SF_SIMPLE_BACKLOG_HIGH SF_SIMPLE_CONF_BACKLOG_HIGH
+#else
+#define SF_SIMPLE_BACKLOG_HIGH (2 * SF_SIMPLE_BACKLOG_DIVISOR)
+#endif
+
+/* Averaged backlog below which one load-driven uplink is released */
+#ifdef SF_SIMPLE_CONF_BACKLOG_LOW
+#define SF_SIMPLE_BACKLOG_LOW SF_SIMPLE_CONF_BACKLOG_LOW
+#else
+#define SF_SIMPLE_BACKLOG_LOW (SF_SIMPLE_BACKLOG_DIVISOR / 4)
+#endif
+
+/* Max number of uplinks asked for on top of the rate-based allocation */
+#ifdef SF_SIMPLE_CONF_LOAD_MAX_CELLS
+#define SF_SIMPLE_LOAD_MAX_CELLS SF_SIMPLE_CONF_LOAD_MAX_CELLS
+#else
+#define SF_SIMPLE_LOAD_MAX_CELLS 4
+#endif
+
+/* Number of samples to wait after a change before the next one */
+#ifdef SF_SIMPLE_CONF_LOAD_HOLD
+#define SF_SIMPLE_LOAD_HOLD SF_SIMPLE_CONF_LOAD_HOLD
+#else
+#define SF_SIMPLE_LOAD_HOLD 10
+#endif
+
+/* Number of neighbors we can have cells to give back to at once: uplinks
+ * a parent granted that we could not install, or uplinks a child holds
+ * that would break our uplink chain */
+#ifdef SF_SIMPLE_CONF_GIVE_BACK_PEERS
+#define SF_SIMPLE_GIVE_BACK_PEERS SF_SIMPLE_CONF_GIVE_BACK_PEERS
+#else
+#define SF_SIMPLE_GIVE_BACK_PEERS 3
+#endif
+
+/* Lifetime, in timeslots, of a data packet in the TSCH queue. Past it the
+ * packet is dropped instead of taking an uplink cell */
+#ifdef SF_SIMPLE_CONF_DATA_LIFETIME
+#define SF_SIMPLE_DATA_LIFETIME SF_SIMPLE_CONF_DATA_LIFETIME
+#else
+#define SF_SIMPLE_DATA_LIFETIME (8 * TSCH_SCHEDULE_GT_DATA_LENGTH)
+#endif
+
+/* TSCH_CALLBACK_PACKET_READY: sets the lifetime of outgoing data packets */
+int sf_simple_callback_packet_ready(void);
+
 extern const sixtop_sf_t sf_simple_driver;
 
 #endif /* !_SIXTOP_SF_SIMPLE_H_ */
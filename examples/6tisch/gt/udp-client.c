@@ -169,6 +169,9 @@ PROCESS_THREAD(udp_client_process, ev, data)
 		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&periodic_timer));
 	}
             
+	//From now on, sf-simple moves cells between children and parent as 6P events come in
+	sf_simple_rebalance_start(&parent->addr);
+
 	etimer_set(&periodic_timer,CLOCK_SECOND/node_id);
 	static int check;
 	check=0;
@@ -177,26 +180,6 @@ PROCESS_THREAD(udp_client_process, ev, data)
 	{
 		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&periodic_timer));
 		
-		//Allocating Rx timeslots to increase uplink capacity of children nodes
-		if(need_send_back==1  &&  free_uplink_timeslots>0)
-		{
-
-			dtsf_send_add_downlink();
-                       
-		}
-		else
-		{
-			//When node is not able to allocate Rx timeslots, asks from its parent
-			if( required_slots > 0 && check_ask_uplink==1)
-			{
-				 
-				printf("Asking uplink %d\n",required_slots);
-				dtsf_send_add_uplink(&parent->addr, required_slots);
-              
-                            
-			}
-		}
-		
 		etimer_set(&periodic_timer,CLOCK_SECOND*4+ CLOCK_SECOND/node_id);
              
 		if(check==0)
@@ -261,29 +244,6 @@ PROCESS_THREAD(udp_client_process, ev, data)
 			}         
                         
 		}
-		else
-		{
-		   //Check the TSCH allocation requests received from children
-		   if(need_send_back==1  &&  free_uplink_timeslots>0)
-		   {
-			   
-				dtsf_send_add_downlink();
-		   
-		   }
-		   else
-		   {
-			  
-				if( required_slots > 0 && check_ask_uplink==1)
-				{
-					
-					printf("Asking uplink %d\n",required_slots);
-					 
-					dtsf_send_add_uplink(&parent->addr, required_slots);
-												
-				}
-		   }
-                       
-		}
            
          
         
@@ -311,6 +271,8 @@ PROCESS_THREAD(udp_client_process, ev, data)
 			   int final=(int)(test);
 			   printf("  %d\n",final);
 			   printf("drops   %d\n",drops);
+			   printf("controlDrops   %d\n",control_drops);
+			   printf("staleDrops   %d\n",stale_drops);
 			   printf("parentChange %d\n",parent_change);
 			   printf("icmpPackets   %d\n", IcmpPackets);
 			   break;
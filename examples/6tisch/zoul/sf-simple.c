@@ -61,8 +61,7 @@ static uint8_t res_storage[4 + SF_SIMPLE_MAX_LINKS * 4];
 static uint8_t req_storage[4 + SF_SIMPLE_MAX_LINKS * 4];
 int check_adv_link = 0;
 
-static uint8_t two_hop_channel[8];
-static linkaddr_t children_address[8];
+
 
 
 static void read_cell(const uint8_t *buf, sf_simple_cell_t *cell);
@@ -175,7 +174,7 @@ add_downlinks_to_schedule(const linkaddr_t *peer_addr, uint8_t link_option,
     return;
   }
   
-  int index=find_in_send_back_by_address(peer_addr);
+
 
   
   //printf("999 len=%d\n",(int)cell_list_len);
@@ -187,16 +186,8 @@ add_downlinks_to_schedule(const linkaddr_t *peer_addr, uint8_t link_option,
             tsch_schedule_add_link(slotframe,
                                  link_option, LINK_TYPE_NORMAL, peer_addr,
                                  cell.timeslot_offset, cell.channel_offset);
-            if(index>=0)
-            {
-                        if(send_back_number_links[index]>0)
-                        {  
-                           
-                                send_back_number_links[index] = send_back_number_links[index] -1;
-                
-                
-                        }
-            }
+            /* One cell less owed to this child, if we owed any */
+            tsch_ledger_remove_owed(peer_addr, 1);
         
       }
     
@@ -233,8 +224,7 @@ delete_downlinks_from_schedule(const linkaddr_t *peer_addr,
       for(i = 0; i < cell_list_len; i += sizeof(sf_simple_cell_t)) 
       {
             read_cell(&cell_list[i], &cell);
-            int out=tsch_schedule_delete_link(slotframe, LINK_OPTION_RX, LINK_TYPE_NORMAL, peer_addr, cell.timeslot_offset, cell.channel_offset);
-            if( out != 1 )
+            if(tsch_schedule_delete_link(slotframe, LINK_OPTION_RX, LINK_TYPE_NORMAL, peer_addr, cell.timeslot_offset, cell.channel_offset) != 1)
             {
                                      printf("cannot delete the link\n");
             }
@@ -427,25 +417,17 @@ delete_downlink_request_sent_callback(void *arg, uint16_t arg_len,
     int out= delete_downlinks_from_schedule(dest_addr,
                           cell_list, cell_list_len);
                             
-        int index=find_in_send_back_by_address(dest_addr);
-       if(index<0)
+        if(out>0)
         {
-            index=find_free_place_in_send_back();
-                                             
-            if(index<0)
+            /* We now owe these cells to the child */
+            if((out = tsch_ledger_add_owed(dest_addr, out)) > 0)
             {
-                printf("Error: cannot find empty space in send back array\n");
+                required_slots = required_slots + out;
+            }
+            else
+            {
+                printf("Error: cannot record the cells owed to the child\n");
             }
-            send_back_number_links[index]=0;
-            //linkaddr_t temp= *dest_addr;
-            send_back_address[index]=*dest_addr;
-        }
-          
-        if(out>0)
-        {  
-        send_back_number_links[index] = send_back_number_links[index] +out;
-        required_slots = required_slots + out;
-        
         }
 
   }
@@ -522,35 +504,21 @@ add_adv_link_response_sent_callback(void *arg, uint16_t arg_len,
     for(i = 0; i < cell_list_len; i += sizeof(cell)) 
     {
         read_cell(&cell_list[i], &cell);
-        int out= delete_from_cell_list_reserved(cell.timeslot_offset,cell.channel_offset);
-        if(out!=1)
+        if(tsch_ledger_remove_pending(dest_addr, cell.timeslot_offset, cell.channel_offset)!=1)
         {
             printf("error: cannot delete slot\n");
         }
     
     }
-  
-  
-   
+  }
+  else
+  {
+    /* The child never got the cells, offer them again to anyone */
+    tsch_ledger_clear_pending(dest_addr);
   }
 }
 
-void set_children_channel(const linkaddr_t *dest_addr,int channel)
-{
-    int i;
-    for(i=0;i<8;i++)
-    {
-        if(two_hop_channel[i]==0)
-        {
-            two_hop_channel[i]=channel;
-            children_address[i]=*dest_addr;
-            return;
-        }
-            
-    }
-    
-    printf("error: no empty space in two_hop_channel\n");
-}
+
 
 static void
 channel_response_sent_callback(void *arg, uint16_t arg_len,
@@ -573,7 +541,10 @@ channel_response_sent_callback(void *arg, uint16_t arg_len,
      {
         // printf("callback for channel channel=%d\n",channel);
          channel=sixp_pkt_get_channel(SIXP_PKT_TYPE_RESPONSE, (sixp_pkt_code_t)(uint8_t)SIXP_PKT_RC_SUCCESS, body, body_len);
-         set_children_channel(dest_addr,channel);
+         if(tsch_ledger_set_channel(dest_addr,channel)==0)
+         {
+             printf("error: cannot record the channel of the child\n");
+         }
          struct tsch_neighbor *n = NULL;
          n = tsch_queue_get_nbr(dest_addr);
          n->frequency_offset=channel;
@@ -623,7 +594,7 @@ add_uplink_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t *p
    uint32_t index=0;
 
   // printf("number of cells=%d\n",(int)number_of_cells);
-  if(need_send_back==0)
+  if(tsch_ledger_owed_total()==0)
   {
     index = dtsf_find_free_uplink_slot(slotframe, channel_offset, number_of_cells, cell_list, peer_addr ); 
   }
@@ -651,32 +622,19 @@ add_uplink_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t *p
 
             
             
-                 need_send_back=1;
-                 int j = find_in_send_back_by_address(peer_addr);
-                 if(j>=0)
+                 /* Owe the missing cells to the child, unless it is already owed some */
+                 struct tsch_ledger_entry *e = tsch_ledger_get(peer_addr);
+                 if(e == NULL || e->owed == 0)
                  {
-                     if(send_back_number_links[j]==0)
+                     uint8_t owed = tsch_ledger_add_owed(peer_addr, number_of_cells - index);
+                     if(owed > 0)
                      {
-                                     required_slots = required_slots + (number_of_cells - index);
-                       send_back_number_links[j]= send_back_number_links[j] + number_of_cells - index;
+                         required_slots = required_slots + owed;
+                     }
+                     else
+                     {
+                         printf("error in recording the cells owed to the child\n");
                      }
-                 }
-                 else
-                 {
-                        j=find_free_place_in_send_back();
-                        if(j>=0)
-                        {
-                                        required_slots = required_slots + (number_of_cells - index);
-                            send_back_number_links[j]= number_of_cells - index;
-                            send_back_address[j]= *peer_addr;
-                        }
-                        else
-                        {
-                            
-                            printf("error in finding empty space in Send_Back_Array\n");
-                            printf("j=%d",j);
-                        }
-                     
                  }
                  
    
@@ -870,8 +828,6 @@ delete_uplink_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t
          const uint8_t *cell_list;
          uint16_t cell_list_len=0;
          
-          int j=0;
-         
          
           
           
@@ -894,13 +850,8 @@ delete_uplink_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t
             
         }
         
-       j= find_in_send_back_by_address(peer_addr);
-       
-       if(j>0)
-       {
-           required_slots = required_slots - send_back_number_links[j];
-           send_back_number_links[j]=0;
-       }
+       /* The child gave up its uplinks, forget what we owed to it */
+       required_slots = required_slots - tsch_ledger_remove_owed(peer_addr, 0xff);
 
 }
 
@@ -910,16 +861,17 @@ void  dtsf_send_add_downlink()
     
         sf_simple_cell_t cell;
         
-        int i=find_first_place_in_send_back();
-        if(i<0)
+        struct tsch_ledger_entry *e = tsch_ledger_first_owed();
+        if(e == NULL)
         {
            // printf("Error: Cannot find any send back cases\n");
             return;
         }
+        const linkaddr_t *child_addr = tsch_ledger_get_addr(e);
         
         printf("start sendback procedure\n");
         
-        int number_of_cells= send_back_number_links[i];
+        int number_of_cells= e->owed;
         
         
         
@@ -944,7 +896,7 @@ void  dtsf_send_add_downlink()
    uint32_t index=0;
 
   // printf("number of cells=%d\n",(int)number_of_cells);
-    index = dtsf_find_free_uplink_slot(slotframe, channel_offset, number_of_cells, cell_list, &send_back_address[i]); 
+    index = dtsf_find_free_uplink_slot(slotframe, channel_offset, number_of_cells, cell_list, child_addr); 
     //printf("index=%d\n",(int)index);
    
     if (index < 1)
@@ -981,11 +933,11 @@ void  dtsf_send_add_downlink()
           req_len += sizeof(cell);
 
       }
-      printf("Send an add downlink to child %d\n", send_back_address[i].u8[7]);
+      printf("Send an add downlink to child %d\n", child_addr->u8[7]);
      
       sixp_output(SIXP_PKT_TYPE_REQUEST, (sixp_pkt_code_t)(uint8_t)SIXP_PKT_CMD_ADD_DOWNLINKS,
                   SF_SIMPLE_SFID,
-                  req_storage, req_len, &send_back_address[i],
+                  req_storage, req_len, child_addr,
                   add_downlink_request_sent_callback, req_storage, req_len);
     
 }
@@ -1205,20 +1157,7 @@ add_adv_link_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t
 }
 
 
-int look_in_children_channel(const linkaddr_t *peer_addr)
-{
-    
-    int i;
-    for(i=0;i<8;i++)
-    {
-        
-        if(linkaddr_cmp(&children_address[i],peer_addr) && two_hop_channel[i]!=0)
-        {
-            return two_hop_channel[i];
-        }
-    }
-    return 0;
-}
+
 
 
 static void
@@ -1246,7 +1185,7 @@ ask_channel_req_input(const uint8_t *body, uint16_t body_len, const linkaddr_t *
       channel = n->frequency_offset;
       printf("no\n");
    }*/
-   int ch = look_in_children_channel(peer_addr);
+   int ch = tsch_ledger_get_channel(peer_addr);
    if(ch!=0)
    {
         channel = ch;
@@ -1432,20 +1371,7 @@ response_input(sixp_pkt_rc_t rc,
   }
 }
 
-int check_children_channel(int in)
-{
-    int i;
-    for(i=0;i<8;i++)
-    {
-        if(two_hop_channel[i]==in)
-        {
-            return 1;
-        }
-        
-    }
-    
-    return 0;
-}
+
 
 static uint16_t
 find_two_hop_frequency()
@@ -1482,7 +1408,7 @@ find_two_hop_frequency()
         {
             //printf("just_before_check  %d\n",tsch_hopping_sequence_length.val);
 
-            if(check_children_channel(i)==0)
+            if(tsch_ledger_channel_in_use(i)==0)
             {
              
             //  printf("children channe=%d\n",i);
@@ -1504,7 +1430,7 @@ find_two_hop_frequency()
         {
             //printf("just_before_check  %d\n",tsch_hopping_sequence_length.val);
 
-            if(check_children_channel(i)==0)
+            if(tsch_ledger_channel_in_use(i)==0)
             {
              
            //   printf("children channe=%d\n",i);
@@ -1592,11 +1518,6 @@ timeout(sixp_pkt_cmd_t cmd, const linkaddr_t *peer_addr)
 static void
 init()
 {
-    int i;
-    for(i=0;i<8;i++)
-    {
-        two_hop_channel[i]=0;
-    }
    // printf("init\n");
    if(tsch_is_coordinator)
    {
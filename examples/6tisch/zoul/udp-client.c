@@ -330,7 +330,7 @@ PROCESS_THREAD(udp_client_process, ev, data)
       while(!etimer_expired(&start_timer))
       {
            PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&periodic_timer));
-            if(need_send_back==1  &&  free_uplink_timeslots>0)
+            if(tsch_ledger_owed_total()>0  &&  free_uplink_timeslots>0)
             {
                           
 
@@ -432,7 +432,7 @@ PROCESS_THREAD(udp_client_process, ev, data)
            else
            {
 
-                       if(need_send_back==1  &&  free_uplink_timeslots>0)
+                       if(tsch_ledger_owed_total()>0  &&  free_uplink_timeslots>0)
                        {
                            
                             dtsf_send_add_downlink();
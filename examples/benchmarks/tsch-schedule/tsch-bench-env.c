@@ -0,0 +1,123 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Native stand-ins for the parts of tsch.c and slot operation that the
+ *         schedule layer (tsch-schedule.c, tsch-queue.c, tsch-ledger.c,
+ *         tsch-trace.c) relies on. Slot operation never runs here, so the
+ *         lock is always free. The benchmark sets tsch_is_associated itself,
+ *         and plays slot operation by calling
+ *         tsch_schedule_get_next_active_link.
+ */
+
+#include "contiki.h"
+#include "net/mac/tsch/tsch.h"
+
+#if LINKADDR_SIZE == 8
+const linkaddr_t tsch_broadcast_address = { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } };
+const linkaddr_t tsch_eb_address = { { 0, 0, 0, 0, 0, 0, 0, 0 } };
+#else /* LINKADDR_SIZE == 8 */
+const linkaddr_t tsch_broadcast_address = { { 0xff, 0xff } };
+const linkaddr_t tsch_eb_address = { { 0, 0 } };
+#endif /* LINKADDR_SIZE == 8 */
+
+int tsch_is_coordinator = 0;
+int tsch_is_associated = 0;
+struct tsch_asn_t tsch_current_asn;
+struct tsch_link *current_link = NULL;
+struct tsch_link *backup_link = NULL;
+
+/* GT-TSCH state, as in tsch.c */
+uint8_t default_channel = 0;
+uint8_t children_channel = 0;
+uint8_t parent_channel = 0;
+uint16_t required_slots = 0;
+uint16_t free_uplink_timeslots = 0;
+float packet_generation_rate = 1;
+float current_packet_generation_rate = 0;
+int current_number_slots_for_packet_generation = 0;
+int allocate_slot_for_packet_generation = 0;
+
+/* Stale packets purged from the queues go to the dequeued ring, as in
+ * tsch-slot-operation.c. Left uninitialised, it never has room for them:
+ * the purge keeps every packet. */
+struct ringbufindex dequeued_ringbuf;
+struct tsch_packet *dequeued_array[TSCH_DEQUEUED_ARRAY_SIZE];
+
+PROCESS(tsch_pending_events_process, "pending events process");
+
+static int tsch_locked;
+/*---------------------------------------------------------------------------*/
+int
+tsch_is_locked(void)
+{
+  return tsch_locked;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_get_lock(void)
+{
+  if(!tsch_locked) {
+    tsch_locked = 1;
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_release_lock(void)
+{
+  tsch_locked = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_set_ka_timeout(uint32_t timeout)
+{
+}
+/*---------------------------------------------------------------------------*/
+float
+convert_slots_to_rate(int slots)
+{
+  float out = (float)(slots * 2);
+  return out > packet_generation_rate ? packet_generation_rate : out;
+}
+/*---------------------------------------------------------------------------*/
+int
+find_shared_timeslot_children()
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_pending_events_process, ev, data)
+{
+  PROCESS_BEGIN();
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
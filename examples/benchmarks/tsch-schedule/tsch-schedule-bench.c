@@ -0,0 +1,319 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Benchmark: TSCH schedule data structures on the native platform.
+ *         Builds synthetic GT-TSCH slotframes of several lengths and link
+ *         counts, and times link installation and removal, the slot
+ *         operation lookup of the next active link, and the GT-TSCH free
+ *         cell allocators. Each configuration also runs associated, where
+ *         a schedule change is published to slot operation and adopted at
+ *         the next slot boundary: there, links are relocated and the
+ *         adoption timed. Prints one line per operation and configuration,
+ *         with ops/s, mean and worst-case latency.
+ *
+ *         Run: make TARGET=native && ./build/native/tsch-schedule-bench.native
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/mac/tsch/tsch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Synthetic schedules. Lengths above TSCH_SCHEDULE_INDEX_MAX_LENGTH are
+ * not indexed. */
+static const uint16_t lengths[] = { 31, 101, 251, 1021 };
+static const uint16_t link_counts[] = { 8, 32, 128, TSCH_SCHEDULE_MAX_LINKS };
+
+/* Number of times each configuration is built and torn down */
+#define BENCH_ROUNDS 20
+/* get_next_active_link calls per round, in slotframe lengths */
+#define BENCH_SLOTFRAME_SWEEPS 4
+/* Links relocated per round when associated */
+#define BENCH_RELOCATIONS 16
+/* Every BENCH_ADV_STRIDE-th link is an advertising cell */
+#define BENCH_ADV_STRIDE TSCH_SCHEDULE_GT_ADV_STRIDE
+#define BENCH_CHILD_CHANNEL 2
+
+enum bench_op {
+  BENCH_ADD_LINK,
+  BENCH_DELETE_LINK,
+  BENCH_NEXT_ACTIVE_LINK,
+  BENCH_FREE_ADV_SLOT,
+  BENCH_FREE_UPLINK_ROOT,
+  BENCH_FREE_UPLINK_NODE,
+  BENCH_FREE_ADV_LINK_SLOT,
+  BENCH_RELOCATE_LINK,
+  BENCH_ADOPT_VIEW,
+  BENCH_OP_COUNT
+};
+
+static const char *op_names[BENCH_OP_COUNT] = {
+  "add_link", "delete_link", "get_next_active_link", "find_free_adv_slot",
+  "find_free_uplink(root)", "find_free_uplink(node)", "find_free_adv_link_slot",
+  "relocate_link", "adopt_view",
+};
+
+struct bench_stat {
+  uint64_t ops;
+  uint64_t total_ns;
+  uint64_t max_ns;
+};
+
+struct bench_link {
+  uint8_t link_options;
+  enum link_type link_type;
+  const linkaddr_t *addr;
+  uint16_t timeslot;
+  uint16_t channel_offset;
+};
+
+static struct bench_stat stats[BENCH_OP_COUNT];
+static struct bench_link links[TSCH_SCHEDULE_MAX_LINKS];
+static uint16_t timeslots[1024];
+static linkaddr_t parent_addr;
+static linkaddr_t child_addr;
+
+PROCESS(tsch_schedule_bench_process, "TSCH schedule benchmark");
+AUTOSTART_PROCESSES(&tsch_schedule_bench_process);
+/*---------------------------------------------------------------------------*/
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+record(enum bench_op op, uint64_t start)
+{
+  uint64_t elapsed = now_ns() - start;
+  stats[op].ops++;
+  stats[op].total_ns += elapsed;
+  if(elapsed > stats[op].max_ns) {
+    stats[op].max_ns = elapsed;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Picks count distinct random timeslots, 0 excluded, and a GT-TSCH like
+ * mix of cells on them: advertising cells, uplinks to the parent and Rx
+ * cells for a child */
+static void
+make_links(uint16_t length, uint16_t count)
+{
+  uint16_t i;
+  for(i = 0; i < length - 1; i++) {
+    timeslots[i] = i + 1;
+  }
+  for(i = 0; i < count; i++) {
+    uint16_t j = i + random_rand() % (length - 1 - i);
+    uint16_t tmp = timeslots[i];
+    timeslots[i] = timeslots[j];
+    timeslots[j] = tmp;
+
+    links[i].timeslot = timeslots[i];
+    if(i % BENCH_ADV_STRIDE == 0) {
+      links[i].link_options = LINK_OPTION_TX | LINK_OPTION_RX | LINK_OPTION_SHARED | LINK_OPTION_TIME_KEEPING;
+      links[i].link_type = LINK_TYPE_ADVERTISING;
+      links[i].addr = &tsch_broadcast_address;
+      links[i].channel_offset = 0;
+    } else if(i % 2) {
+      links[i].link_options = LINK_OPTION_TX;
+      links[i].link_type = LINK_TYPE_NORMAL;
+      links[i].addr = &parent_addr;
+      links[i].channel_offset = parent_channel;
+    } else {
+      links[i].link_options = LINK_OPTION_RX;
+      links[i].link_type = LINK_TYPE_NORMAL;
+      links[i].addr = &child_addr;
+      links[i].channel_offset = BENCH_CHILD_CHANNEL;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Runs slot operation once. When associated, it adopts the view published
+ * since the last call, if any, and the links retired before can be freed */
+static struct tsch_link *
+slot_boundary(struct tsch_asn_t *asn, uint16_t *time_offset)
+{
+  struct tsch_link *backup;
+  return tsch_schedule_get_next_active_link(asn, time_offset, &backup);
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_round(uint16_t length, uint16_t count, int associated)
+{
+  struct tsch_slotframe *sf;
+  struct tsch_asn_t asn;
+  sf_simple_cell_t cells[TSCH_LEDGER_MAX_PENDING];
+  uint16_t time_offset;
+  uint64_t start;
+  uint32_t i;
+
+  TSCH_ASN_INIT(asn, 0, random_rand() % length);
+  tsch_is_associated = associated;
+  tsch_schedule_remove_all_slotframes();
+  /* Slot operation moves past the links of the last round */
+  slot_boundary(&asn, &time_offset);
+  sf = tsch_schedule_add_slotframe(0, length);
+  make_links(length, count);
+
+  /* Install as the root, so that Rx cells need not feed an uplink */
+  tsch_is_coordinator = 1;
+  for(i = 0; i < count; i++) {
+    start = now_ns();
+    tsch_schedule_add_link(sf, links[i].link_options, links[i].link_type, links[i].addr,
+                           links[i].timeslot, links[i].channel_offset);
+    record(BENCH_ADD_LINK, start);
+  }
+
+  /* Adopts the installed schedule when associated */
+  slot_boundary(&asn, &time_offset);
+  TSCH_ASN_INC(asn, time_offset > 0 ? time_offset : 1);
+  for(i = 0; i < (uint32_t)BENCH_SLOTFRAME_SWEEPS * length; i++) {
+    start = now_ns();
+    slot_boundary(&asn, &time_offset);
+    record(BENCH_NEXT_ACTIVE_LINK, start);
+    /* Move on to the slot after the link, as slot operation does */
+    TSCH_ASN_INC(asn, time_offset > 0 ? time_offset : 1);
+  }
+
+  if(associated) {
+    /* Delete and re-add a link, as a 6P relocation does, then time the
+     * slot boundary that adopts the new view */
+    for(i = 0; i < BENCH_RELOCATIONS; i++) {
+      const struct bench_link *l = &links[random_rand() % count];
+      start = now_ns();
+      tsch_schedule_delete_link(sf, l->link_options, l->link_type, l->addr,
+                                l->timeslot, l->channel_offset);
+      tsch_schedule_add_link(sf, l->link_options, l->link_type, l->addr,
+                             l->timeslot, l->channel_offset);
+      record(BENCH_RELOCATE_LINK, start);
+
+      start = now_ns();
+      slot_boundary(&asn, &time_offset);
+      record(BENCH_ADOPT_VIEW, start);
+      TSCH_ASN_INC(asn, time_offset > 0 ? time_offset : 1);
+    }
+  }
+
+  if(count < length - 1) {
+    start = now_ns();
+    dtsf_find_free_adv_slot(sf, 0);
+    record(BENCH_FREE_ADV_SLOT, start);
+
+    start = now_ns();
+    dtsf_find_free_uplink_slot(sf, BENCH_CHILD_CHANNEL, TSCH_LEDGER_MAX_PENDING, cells, &child_addr);
+    record(BENCH_FREE_UPLINK_ROOT, start);
+    tsch_ledger_clear_pending(&child_addr);
+
+    start = now_ns();
+    dtsf_find_free_adv_link_slot(sf, BENCH_CHILD_CHANNEL, TSCH_LEDGER_MAX_PENDING, cells, &child_addr);
+    record(BENCH_FREE_ADV_LINK_SLOT, start);
+    tsch_ledger_clear_pending(&child_addr);
+
+    /* As a node: Rx cells must feed an uplink to the time source */
+    tsch_is_coordinator = 0;
+    start = now_ns();
+    dtsf_find_free_uplink_slot(sf, BENCH_CHILD_CHANNEL, TSCH_LEDGER_MAX_PENDING, cells, &child_addr);
+    record(BENCH_FREE_UPLINK_NODE, start);
+    tsch_ledger_clear_pending(&child_addr);
+    tsch_is_coordinator = 1;
+  }
+
+  for(i = 0; i < count; i++) {
+    start = now_ns();
+    tsch_schedule_delete_link(sf, links[i].link_options, links[i].link_type, links[i].addr,
+                              links[i].timeslot, links[i].channel_offset);
+    record(BENCH_DELETE_LINK, start);
+  }
+  tsch_is_coordinator = 0;
+  tsch_is_associated = 0;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_schedule_bench_process, ev, data)
+{
+  static unsigned li, ci, associated;
+  unsigned op, round;
+
+  PROCESS_BEGIN();
+
+  random_init(0);
+  memset(&parent_addr, 0, sizeof(parent_addr));
+  parent_addr.u8[LINKADDR_SIZE - 1] = 1;
+  memset(&child_addr, 0, sizeof(child_addr));
+  child_addr.u8[LINKADDR_SIZE - 1] = 2;
+  parent_channel = 1;
+
+  /* TSCH init may have been aborted on the native radio: set up the
+   * schedule and the structures it relies on here */
+  tsch_queue_init();
+  tsch_schedule_init();
+  tsch_ledger_init();
+  tsch_queue_update_time_source(&parent_addr);
+
+  printf("length,links,indexed,associated,op,ops,ops_per_s,mean_ns,max_ns\n");
+  for(li = 0; li < sizeof(lengths) / sizeof(lengths[0]); li++) {
+    for(ci = 0; ci < sizeof(link_counts) / sizeof(link_counts[0]); ci++) {
+      for(associated = 0; associated <= 1; associated++) {
+        uint16_t count = link_counts[ci];
+        if(count >= lengths[li]) {
+          continue;
+        }
+        memset(stats, 0, sizeof(stats));
+        for(round = 0; round < BENCH_ROUNDS; round++) {
+          run_round(lengths[li], count, associated);
+        }
+        for(op = 0; op < BENCH_OP_COUNT; op++) {
+          if(stats[op].ops == 0) {
+            continue;
+          }
+          printf("%u,%u,%u,%u,%s,%llu,%.0f,%llu,%llu\n",
+                 lengths[li], count, lengths[li] <= TSCH_SCHEDULE_INDEX_MAX_LENGTH,
+                 associated, op_names[op], (unsigned long long)stats[op].ops,
+                 stats[op].total_ns ? stats[op].ops * 1e9 / stats[op].total_ns : 0.0,
+                 (unsigned long long)(stats[op].total_ns / stats[op].ops),
+                 (unsigned long long)stats[op].max_ns);
+        }
+        /* Let the rest of the system run between configurations */
+        PROCESS_PAUSE();
+      }
+    }
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
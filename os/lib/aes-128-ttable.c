@@ -0,0 +1,201 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Table-driven AES-128. SubBytes, ShiftRows and MixColumns of a
+ *         round are merged into four lookups per column in 32-bit tables,
+ *         and the round keys are kept as words. The tables take 4 KiB of
+ *         constant data. Select with
+ *         #define AES_128_CONF aes_128_ttable_driver
+ */
+
+#include "lib/aes-128.h"
+#include <string.h>
+
+/* The AES S-box, applied to F */
+#define SBOX(F) \
+  F(0x63) F(0x7c) F(0x77) F(0x7b) F(0xf2) F(0x6b) F(0x6f) F(0xc5) \
+  F(0x30) F(0x01) F(0x67) F(0x2b) F(0xfe) F(0xd7) F(0xab) F(0x76) \
+  F(0xca) F(0x82) F(0xc9) F(0x7d) F(0xfa) F(0x59) F(0x47) F(0xf0) \
+  F(0xad) F(0xd4) F(0xa2) F(0xaf) F(0x9c) F(0xa4) F(0x72) F(0xc0) \
+  F(0xb7) F(0xfd) F(0x93) F(0x26) F(0x36) F(0x3f) F(0xf7) F(0xcc) \
+  F(0x34) F(0xa5) F(0xe5) F(0xf1) F(0x71) F(0xd8) F(0x31) F(0x15) \
+  F(0x04) F(0xc7) F(0x23) F(0xc3) F(0x18) F(0x96) F(0x05) F(0x9a) \
+  F(0x07) F(0x12) F(0x80) F(0xe2) F(0xeb) F(0x27) F(0xb2) F(0x75) \
+  F(0x09) F(0x83) F(0x2c) F(0x1a) F(0x1b) F(0x6e) F(0x5a) F(0xa0) \
+  F(0x52) F(0x3b) F(0xd6) F(0xb3) F(0x29) F(0xe3) F(0x2f) F(0x84) \
+  F(0x53) F(0xd1) F(0x00) F(0xed) F(0x20) F(0xfc) F(0xb1) F(0x5b) \
+  F(0x6a) F(0xcb) F(0xbe) F(0x39) F(0x4a) F(0x4c) F(0x58) F(0xcf) \
+  F(0xd0) F(0xef) F(0xaa) F(0xfb) F(0x43) F(0x4d) F(0x33) F(0x85) \
+  F(0x45) F(0xf9) F(0x02) F(0x7f) F(0x50) F(0x3c) F(0x9f) F(0xa8) \
+  F(0x51) F(0xa3) F(0x40) F(0x8f) F(0x92) F(0x9d) F(0x38) F(0xf5) \
+  F(0xbc) F(0xb6) F(0xda) F(0x21) F(0x10) F(0xff) F(0xf3) F(0xd2) \
+  F(0xcd) F(0x0c) F(0x13) F(0xec) F(0x5f) F(0x97) F(0x44) F(0x17) \
+  F(0xc4) F(0xa7) F(0x7e) F(0x3d) F(0x64) F(0x5d) F(0x19) F(0x73) \
+  F(0x60) F(0x81) F(0x4f) F(0xdc) F(0x22) F(0x2a) F(0x90) F(0x88) \
+  F(0x46) F(0xee) F(0xb8) F(0x14) F(0xde) F(0x5e) F(0x0b) F(0xdb) \
+  F(0xe0) F(0x32) F(0x3a) F(0x0a) F(0x49) F(0x06) F(0x24) F(0x5c) \
+  F(0xc2) F(0xd3) F(0xac) F(0x62) F(0x91) F(0x95) F(0xe4) F(0x79) \
+  F(0xe7) F(0xc8) F(0x37) F(0x6d) F(0x8d) F(0xd5) F(0x4e) F(0xa9) \
+  F(0x6c) F(0x56) F(0xf4) F(0xea) F(0x65) F(0x7a) F(0xae) F(0x08) \
+  F(0xba) F(0x78) F(0x25) F(0x2e) F(0x1c) F(0xa6) F(0xb4) F(0xc6) \
+  F(0xe8) F(0xdd) F(0x74) F(0x1f) F(0x4b) F(0xbd) F(0x8b) F(0x8a) \
+  F(0x70) F(0x3e) F(0xb5) F(0x66) F(0x48) F(0x03) F(0xf6) F(0x0e) \
+  F(0x61) F(0x35) F(0x57) F(0xb9) F(0x86) F(0xc1) F(0x1d) F(0x9e) \
+  F(0xe1) F(0xf8) F(0x98) F(0x11) F(0x69) F(0xd9) F(0x8e) F(0x94) \
+  F(0x9b) F(0x1e) F(0x87) F(0xe9) F(0xce) F(0x55) F(0x28) F(0xdf) \
+  F(0x8c) F(0xa1) F(0x89) F(0x0d) F(0xbf) F(0xe6) F(0x42) F(0x68) \
+  F(0x41) F(0x99) F(0x2d) F(0x0f) F(0xb0) F(0x54) F(0xbb) F(0x16)
+
+/* Multiplication by 2 in GF(2^8) */
+#define XTIME(s) ((((s) << 1) ^ (((s) >> 7) * 0x1b)) & 0xff)
+/* A column of MixColumns applied to (s, 0, 0, 0): (2s, s, s, 3s), with
+ * the first row in the most significant byte */
+#define TE0(s) (((uint32_t)XTIME(s) << 24) | ((uint32_t)(s) << 16) | \
+                ((uint32_t)(s) << 8) | (uint32_t)(XTIME(s) ^ (s))),
+/* The same, rotated for the other rows of the input */
+#define TE1(s) (((uint32_t)(XTIME(s) ^ (s)) << 24) | ((uint32_t)XTIME(s) << 16) | \
+                ((uint32_t)(s) << 8) | (uint32_t)(s)),
+#define TE2(s) (((uint32_t)(s) << 24) | ((uint32_t)(XTIME(s) ^ (s)) << 16) | \
+                ((uint32_t)XTIME(s) << 8) | (uint32_t)(s)),
+#define TE3(s) (((uint32_t)(s) << 24) | ((uint32_t)(s) << 16) | \
+                ((uint32_t)(XTIME(s) ^ (s)) << 8) | (uint32_t)XTIME(s)),
+
+static const uint32_t te0[256] = { SBOX(TE0) };
+static const uint32_t te1[256] = { SBOX(TE1) };
+static const uint32_t te2[256] = { SBOX(TE2) };
+static const uint32_t te3[256] = { SBOX(TE3) };
+
+/* The S-box byte of each table, for the last round and the key schedule */
+#define SUB0(x) (te2[x] & 0xff000000)
+#define SUB1(x) (te3[x] & 0x00ff0000)
+#define SUB2(x) (te0[x] & 0x0000ff00)
+#define SUB3(x) (te1[x] & 0x000000ff)
+
+#define ROUNDS 10
+
+static uint32_t round_keys[4 * (ROUNDS + 1)];
+/* The key round_keys were expanded from: TSCH sets the key of every frame */
+static uint8_t current_key[AES_128_KEY_LENGTH];
+static uint8_t has_key;
+
+/*---------------------------------------------------------------------------*/
+static uint32_t
+load_be32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+      | ((uint32_t)p[2] << 8) | p[3];
+}
+/*---------------------------------------------------------------------------*/
+static void
+store_be32(uint8_t *p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_key(const uint8_t *key)
+{
+  uint32_t *rk;
+  uint32_t rcon;
+  uint8_t i;
+
+  if(has_key && !memcmp(current_key, key, AES_128_KEY_LENGTH)) {
+    return;
+  }
+  memcpy(current_key, key, AES_128_KEY_LENGTH);
+  has_key = 1;
+
+  rk = round_keys;
+  for(i = 0; i < 4; i++) {
+    rk[i] = load_be32(key + 4 * i);
+  }
+  rcon = 0x01;
+  for(i = 0; i < ROUNDS; i++, rk += 4) {
+    rk[4] = rk[0] ^ (rcon << 24)
+        ^ SUB0((rk[3] >> 16) & 0xff) ^ SUB1((rk[3] >> 8) & 0xff)
+        ^ SUB2(rk[3] & 0xff) ^ SUB3(rk[3] >> 24);
+    rk[5] = rk[1] ^ rk[4];
+    rk[6] = rk[2] ^ rk[5];
+    rk[7] = rk[3] ^ rk[6];
+    rcon = XTIME(rcon);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+encrypt(uint8_t *state)
+{
+  const uint32_t *rk;
+  uint32_t s0, s1, s2, s3;
+  uint32_t t0, t1, t2, t3;
+  uint8_t round;
+
+  rk = round_keys;
+  s0 = load_be32(state) ^ rk[0];
+  s1 = load_be32(state + 4) ^ rk[1];
+  s2 = load_be32(state + 8) ^ rk[2];
+  s3 = load_be32(state + 12) ^ rk[3];
+
+  for(round = 1; round < ROUNDS; round++) {
+    rk += 4;
+    t0 = te0[s0 >> 24] ^ te1[(s1 >> 16) & 0xff]
+        ^ te2[(s2 >> 8) & 0xff] ^ te3[s3 & 0xff] ^ rk[0];
+    t1 = te0[s1 >> 24] ^ te1[(s2 >> 16) & 0xff]
+        ^ te2[(s3 >> 8) & 0xff] ^ te3[s0 & 0xff] ^ rk[1];
+    t2 = te0[s2 >> 24] ^ te1[(s3 >> 16) & 0xff]
+        ^ te2[(s0 >> 8) & 0xff] ^ te3[s1 & 0xff] ^ rk[2];
+    t3 = te0[s3 >> 24] ^ te1[(s0 >> 16) & 0xff]
+        ^ te2[(s1 >> 8) & 0xff] ^ te3[s2 & 0xff] ^ rk[3];
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
+  }
+
+  /* last round skips MixColumns */
+  rk += 4;
+  store_be32(state, SUB0(s0 >> 24) ^ SUB1((s1 >> 16) & 0xff)
+             ^ SUB2((s2 >> 8) & 0xff) ^ SUB3(s3 & 0xff) ^ rk[0]);
+  store_be32(state + 4, SUB0(s1 >> 24) ^ SUB1((s2 >> 16) & 0xff)
+             ^ SUB2((s3 >> 8) & 0xff) ^ SUB3(s0 & 0xff) ^ rk[1]);
+  store_be32(state + 8, SUB0(s2 >> 24) ^ SUB1((s3 >> 16) & 0xff)
+             ^ SUB2((s0 >> 8) & 0xff) ^ SUB3(s1 & 0xff) ^ rk[2]);
+  store_be32(state + 12, SUB0(s3 >> 24) ^ SUB1((s0 >> 16) & 0xff)
+             ^ SUB2((s1 >> 8) & 0xff) ^ SUB3(s2 & 0xff) ^ rk[3]);
+}
+/*---------------------------------------------------------------------------*/
+const struct aes_128_driver aes_128_ttable_driver = {
+  set_key,
+  encrypt
+};
+/*---------------------------------------------------------------------------*/
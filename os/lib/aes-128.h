@@ -69,4 +69,10 @@ struct aes_128_driver {
 
 extern const struct aes_128_driver AES_128;
 
+/**
+ * Table-driven software implementation, faster than the default one at
+ * the cost of 4 KiB of tables.
+ */
+extern const struct aes_128_driver aes_128_ttable_driver;
+
 #endif /* AES_128_H_ */
@@ -64,34 +64,26 @@ set_iv(uint8_t *iv,
   iv[15] = counter;
 }
 /*---------------------------------------------------------------------------*/
-/* XORs the block m[pos] ... m[pos + 15] with K_{counter} */
+/* XORs len bytes of src into dst */
 static void
-ctr_step(const uint8_t *nonce,
-    uint16_t pos,
-    uint8_t *m_and_result,
-    uint16_t m_len,
-    uint16_t counter)
+xor_block(uint8_t *dst, const uint8_t *src, uint8_t len)
 {
-  uint8_t a[AES_128_BLOCK_SIZE];
   uint8_t i;
 
-  set_iv(a, CCM_STAR_ENCRYPTION_FLAGS, nonce, counter);
-  AES_128.encrypt(a);
-
-  for(i = 0; (pos + i < m_len) && (i < AES_128_BLOCK_SIZE); i++) {
-    m_and_result[pos + i] ^= a[i];
+  for(i = 0; i < len; i++) {
+    dst[i] ^= src[i];
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Starts the CBC-MAC in x with B_0 and the additional authenticated data */
 static void
-mic(const uint8_t *nonce,
-    const uint8_t *m, uint16_t m_len,
+mic_start(const uint8_t *nonce,
+    uint16_t m_len,
     const uint8_t *a, uint16_t a_len,
-    uint8_t *result,
+    uint8_t *x,
     uint8_t mic_len)
 {
-  uint8_t x[AES_128_BLOCK_SIZE];
-  uint32_t pos; /* 32-bits as can need to exceed m_len to reach end of loop */
+  uint32_t pos; /* 32-bits as can need to exceed a_len to reach end of loop */
   uint8_t i;
 
   set_iv(x, CCM_STAR_AUTH_FLAGS(a_len > 0, mic_len), nonce, m_len);
@@ -108,42 +100,11 @@ mic(const uint8_t *nonce,
 
     pos = 14;
     while(pos < a_len) {
-      for(i = 0; (pos + i < a_len) && (i < AES_128_BLOCK_SIZE); i++) {
-        x[i] ^= a[pos + i];
-      }
-      pos += AES_128_BLOCK_SIZE;
-      AES_128.encrypt(x);
-    }
-  }
-
-  if(m_len) {
-    pos = 0;
-    while(pos < m_len) {
-      for(i = 0; (pos + i < m_len) && (i < AES_128_BLOCK_SIZE); i++) {
-        x[i] ^= m[pos + i];
-      }
+      xor_block(x, a + pos, MIN(a_len - pos, AES_128_BLOCK_SIZE));
       pos += AES_128_BLOCK_SIZE;
       AES_128.encrypt(x);
     }
   }
-
-  ctr_step(nonce, 0, x, AES_128_BLOCK_SIZE, 0);
-
-  memcpy(result, x, mic_len);
-}
-/*---------------------------------------------------------------------------*/
-static void
-ctr(const uint8_t *nonce, uint8_t *m, uint16_t m_len)
-{
-  uint32_t pos; /* 32-bits as can need to exceed m_len to reach end of loop */
-  uint16_t counter;
-
-  pos = 0;
-  counter = 1;
-  while(pos < m_len) {
-    ctr_step(nonce, pos, m, m_len, counter++);
-    pos += AES_128_BLOCK_SIZE;
-  }
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -152,6 +113,9 @@ set_key(const uint8_t *key)
   AES_128.set_key(key);
 }
 /*---------------------------------------------------------------------------*/
+/* Authenticates and encrypts, or decrypts and authenticates, in a single
+ * pass over m: each block is fed to the CBC-MAC as plaintext and XORed
+ * with its CTR key stream block */
 static void
 aead(const uint8_t* nonce,
     uint8_t* m, uint16_t m_len,
@@ -159,25 +123,50 @@ aead(const uint8_t* nonce,
     uint8_t *result, uint8_t mic_len,
     int forward)
 {
+  uint8_t x[AES_128_BLOCK_SIZE];
+  uint8_t ctr_iv[AES_128_BLOCK_SIZE];
+  uint8_t s[AES_128_BLOCK_SIZE];
+  uint32_t pos; /* 32-bits as can need to exceed m_len to reach end of loop */
+  uint16_t counter;
+  uint8_t len;
+
   if(a_len > MAX_A_LEN || !MIC_LEN_VALID(mic_len)) {
     return;
   }
 
-  if(!forward) {
-    /* decrypt */
-    ctr(nonce, m, m_len);
-  }
+  mic_start(nonce, m_len, a, a_len, x, mic_len);
 
-  mic(nonce,
-    m, m_len,
-    a, a_len,
-    result,
-    mic_len);
+  set_iv(ctr_iv, CCM_STAR_ENCRYPTION_FLAGS, nonce, 0);
+  pos = 0;
+  counter = 1;
+  while(pos < m_len) {
+    len = MIN(m_len - pos, AES_128_BLOCK_SIZE);
+    ctr_iv[14] = counter >> 8;
+    ctr_iv[15] = counter;
+    memcpy(s, ctr_iv, AES_128_BLOCK_SIZE);
+    AES_128.encrypt(s);
+
+    if(forward) {
+      /* authenticate, then encrypt */
+      xor_block(x, m + pos, len);
+      xor_block(m + pos, s, len);
+    } else {
+      /* decrypt, then authenticate */
+      xor_block(m + pos, s, len);
+      xor_block(x, m + pos, len);
+    }
+    AES_128.encrypt(x);
 
-  if(forward) {
-    /* encrypt */
-    ctr(nonce, m, m_len);
+    pos += AES_128_BLOCK_SIZE;
+    counter++;
   }
+
+  /* The MIC is the CBC-MAC encrypted with A_0 */
+  ctr_iv[14] = 0;
+  ctr_iv[15] = 0;
+  AES_128.encrypt(ctr_iv);
+  xor_block(x, ctr_iv, mic_len);
+  memcpy(result, x, mic_len);
 }
 /*---------------------------------------------------------------------------*/
 const struct ccm_star_driver ccm_star_driver = {
@@ -0,0 +1,97 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \addtogroup data
+ * @{
+ *
+ * \defgroup probe-hash Linear probing helpers
+ *
+ * Helpers shared by the open-addressing hash tables of the stack (neighbor
+ * table, TSCH neighbor index, TSCH ledger). Each table keeps its own storage
+ * and its own notion of an empty slot; the helpers only compute home buckets
+ * and decide, on deletion, whether an entry may be shifted back into the
+ * hole left behind so that no tombstone is needed.
+ *
+ * Table sizes must be powers of two.
+ * @{
+ */
+/*---------------------------------------------------------------------------*/
+#ifndef PROBE_HASH_H_
+#define PROBE_HASH_H_
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+
+#include <stdbool.h>
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief The slot probed after slot \e i in a table of \e size slots
+ */
+#define PROBE_HASH_NEXT(i, size) (((i) + 1) & ((size) - 1))
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Home bucket of a byte string
+ * \param data The key
+ * \param len The length of the key
+ * \param size The number of slots of the table
+ * \return The home bucket, in [0, size)
+ */
+static inline uint16_t
+probe_hash_bytes(const uint8_t *data, uint8_t len, uint16_t size)
+{
+  uint16_t h = 0;
+  uint8_t i;
+  for(i = 0; i < len; i++) {
+    h = h * 31 + data[i];
+  }
+  return h & (size - 1);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Check if an entry may fill a hole during a backward-shift delete
+ * \param hole The empty slot
+ * \param slot The slot of the entry, probed after \e hole
+ * \param home The home bucket of the entry
+ * \retval true The entry can be moved into \e hole
+ * \retval false The home bucket lies cyclically in ]hole, slot], so moving
+ *         the entry would put it before its home bucket
+ */
+static inline bool
+probe_hash_can_fill(uint16_t hole, uint16_t slot, uint16_t home)
+{
+  return hole <= slot ? (home <= hole || home > slot)
+                      : (home <= hole && home > slot);
+}
+/*---------------------------------------------------------------------------*/
+#endif /* PROBE_HASH_H_ */
+/*---------------------------------------------------------------------------*/
+/**
+ * @}
+ * @}
+ */
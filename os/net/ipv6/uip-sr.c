@@ -58,12 +58,174 @@ static int num_nodes;
 LIST(nodelist);
 MEMB(nodememb, uip_sr_node_t, UIP_SR_LINK_NUM);
 
+#define DEPTH_UNREACHABLE 0xffff
+
+#if UIP_SR_WITH_CACHE
+#if (UIP_SR_HASH_SIZE & (UIP_SR_HASH_SIZE - 1)) != 0
+#error UIP_SR_HASH_SIZE must be power of two
+#endif
+
+/* Index of nodelist by link identifier, chained through hash_next */
+static uip_sr_node_t *node_hash[UIP_SR_HASH_SIZE];
+
+/* The depth and cmpr of a node are valid while its route_version equals
+ * route_version, and only towards route_root. route_version changes
+ * whenever a parent pointer changes or a node is removed. */
+static uint16_t route_version;
+static uip_sr_node_t *route_root;
+
+#define CMPR_UNKNOWN 0xff
+#endif /* UIP_SR_WITH_CACHE */
+
 /*---------------------------------------------------------------------------*/
 int
 uip_sr_num_nodes(void)
 {
   return num_nodes;
 }
+#if UIP_SR_WITH_CACHE
+/*---------------------------------------------------------------------------*/
+static uint16_t
+node_hash_bucket(const unsigned char *link_identifier)
+{
+  uint16_t h = 0;
+  uint8_t i;
+  for(i = 0; i < 8; i++) {
+    h = h * 31 + link_identifier[i];
+  }
+  return h & (UIP_SR_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+node_hash_add(uip_sr_node_t *node)
+{
+  uint16_t i = node_hash_bucket(node->link_identifier);
+  node->hash_next = node_hash[i];
+  node_hash[i] = node;
+}
+/*---------------------------------------------------------------------------*/
+static void
+node_hash_remove(uip_sr_node_t *node)
+{
+  uip_sr_node_t **l = &node_hash[node_hash_bucket(node->link_identifier)];
+  while(*l != NULL) {
+    if(*l == node) {
+      *l = node->hash_next;
+      return;
+    }
+    l = &(*l)->hash_next;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+invalidate_routes(void)
+{
+  if(++route_version == 0) {
+    /* Wrapped around: no node may keep a version that looks current */
+    uip_sr_node_t *l;
+    for(l = list_head(nodelist); l != NULL; l = list_item_next(l)) {
+      l->route_version = 0;
+    }
+    route_version = 1;
+  }
+}
+#endif /* UIP_SR_WITH_CACHE */
+/*---------------------------------------------------------------------------*/
+static void
+set_parent(uip_sr_node_t *node, uip_sr_node_t *parent)
+{
+  if(node->parent != parent) {
+    node->parent = parent;
+#if UIP_SR_WITH_CACHE
+    invalidate_routes();
+#endif /* UIP_SR_WITH_CACHE */
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_node(uip_sr_node_t *node)
+{
+  uip_sr_node_t *l;
+  /* Children lose their route until they advertise a new parent */
+  for(l = list_head(nodelist); l != NULL; l = list_item_next(l)) {
+    if(l->parent == node) {
+      l->parent = NULL;
+    }
+  }
+#if UIP_SR_WITH_CACHE
+  if(route_root == node) {
+    route_root = NULL;
+  }
+  node_hash_remove(node);
+#endif /* UIP_SR_WITH_CACHE */
+  list_remove(nodelist, node);
+  memb_free(&nodememb, node);
+  num_nodes--;
+#if UIP_SR_WITH_CACHE
+  invalidate_routes();
+#endif /* UIP_SR_WITH_CACHE */
+}
+/*---------------------------------------------------------------------------*/
+/* Number of hops from root to node, DEPTH_UNREACHABLE if node's parent chain
+ * does not lead to root. Walks up to the first ancestor whose depth is
+ * cached, and caches the depth of every node on the way. */
+static uint16_t
+node_depth(uip_sr_node_t *node, uip_sr_node_t *root)
+{
+#if UIP_SR_WITH_CACHE
+  uip_sr_node_t *l = node;
+  uint16_t hops = 0;
+  uint16_t depth;
+
+  if(root != route_root) {
+    route_root = root;
+    invalidate_routes();
+  }
+
+  while(l != NULL && l != root && l->route_version != route_version
+        && hops < UIP_SR_LINK_NUM) {
+    l = l->parent;
+    hops++;
+  }
+  if(l == root) {
+    depth = 0;
+  } else if(l != NULL && l->route_version == route_version) {
+    depth = l->depth;
+  } else {
+    /* Chain broken, or a loop */
+    depth = DEPTH_UNREACHABLE;
+  }
+
+  for(l = node; hops > 0; hops--) {
+    l->depth = depth == DEPTH_UNREACHABLE ? DEPTH_UNREACHABLE : depth + hops;
+    l->cmpr = CMPR_UNKNOWN;
+    l->route_version = route_version;
+    l = l->parent;
+  }
+  return node == root ? 0 : node->depth;
+#else /* UIP_SR_WITH_CACHE */
+  uint16_t hops = 0;
+
+  while(node != NULL && node != root && hops < UIP_SR_LINK_NUM) {
+    node = node->parent;
+    hops++;
+  }
+  return node == root ? hops : DEPTH_UNREACHABLE;
+#endif /* UIP_SR_WITH_CACHE */
+}
+/*---------------------------------------------------------------------------*/
+/* Counts the number of bytes in common between two addresses at p1 and p2 */
+static int
+count_matching_bytes(const void *p1, const void *p2, size_t n)
+{
+  int i = 0;
+  for(i = 0; i < n; i++) {
+    if(((uint8_t *)p1)[i] != ((uint8_t *)p2)[i]) {
+      return i;
+    }
+  }
+  return n;
+}
 /*---------------------------------------------------------------------------*/
 static int
 node_matches_address(void *graph, const uip_sr_node_t *node, const uip_ipaddr_t *addr)
@@ -81,9 +243,17 @@ uip_sr_node_t *
 uip_sr_get_node(void *graph, const uip_ipaddr_t *addr)
 {
   uip_sr_node_t *l;
+  if(addr == NULL) {
+    return NULL;
+  }
+#if UIP_SR_WITH_CACHE
+  for(l = node_hash[node_hash_bucket(addr->u8 + 8)]; l != NULL; l = l->hash_next) {
+#else /* UIP_SR_WITH_CACHE */
   for(l = list_head(nodelist); l != NULL; l = list_item_next(l)) {
-    /* Compare prefix and node identifier */
-    if(node_matches_address(graph, l, addr)) {
+#endif /* UIP_SR_WITH_CACHE */
+    /* Compare node identifier, then prefix */
+    if(memcmp(l->link_identifier, addr->u8 + 8, 8) == 0
+       && node_matches_address(graph, l, addr)) {
       return l;
     }
   }
@@ -93,7 +263,6 @@ uip_sr_get_node(void *graph, const uip_ipaddr_t *addr)
 int
 uip_sr_is_addr_reachable(void *graph, const uip_ipaddr_t *addr)
 {
-  int max_depth = UIP_SR_LINK_NUM;
   uip_ipaddr_t root_ipaddr;
   uip_sr_node_t *node;
   uip_sr_node_t *root_node;
@@ -102,11 +271,49 @@ uip_sr_is_addr_reachable(void *graph, const uip_ipaddr_t *addr)
   node = uip_sr_get_node(graph, addr);
   root_node = uip_sr_get_node(graph, &root_ipaddr);
 
-  while(node != NULL && node != root_node && max_depth > 0) {
-    node = node->parent;
-    max_depth--;
+  return node != NULL && root_node != NULL
+         && node_depth(node, root_node) != DEPTH_UNREACHABLE;
+}
+/*---------------------------------------------------------------------------*/
+/* How many bytes in common between all nodes in the path? */
+static uint8_t
+path_cmpr(uip_sr_node_t *dest, uip_sr_node_t *root)
+{
+  uip_ipaddr_t dest_addr;
+  uip_ipaddr_t node_addr;
+  uip_sr_node_t *node;
+  uint8_t c = 15;
+  NETSTACK_ROUTING.get_sr_node_ipaddr(&dest_addr, dest);
+  for(node = dest->parent; node != root; node = node->parent) {
+    NETSTACK_ROUTING.get_sr_node_ipaddr(&node_addr, node);
+    c = MIN(c, count_matching_bytes(&node_addr, &dest_addr, 16));
+  }
+  return c;
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_sr_get_route(uip_sr_node_t *dest, uip_sr_node_t *root, uint8_t *path_len, uint8_t *cmpr)
+{
+  uint16_t depth;
+
+  if(dest == NULL || root == NULL) {
+    return 0;
   }
-  return node != NULL && node == root_node;
+  depth = node_depth(dest, root);
+  if(depth == 0 || depth == DEPTH_UNREACHABLE) {
+    return 0;
+  }
+
+  *path_len = depth - 1;
+#if UIP_SR_WITH_CACHE
+  if(dest->cmpr == CMPR_UNKNOWN) {
+    dest->cmpr = path_cmpr(dest, root);
+  }
+  *cmpr = dest->cmpr;
+#else /* UIP_SR_WITH_CACHE */
+  *cmpr = path_cmpr(dest, root);
+#endif /* UIP_SR_WITH_CACHE */
+  return 1;
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -148,30 +355,34 @@ uip_sr_update_node(void *graph, const uip_ipaddr_t *child, const uip_ipaddr_t *p
       return NULL;
     }
     child_node->parent = NULL;
+    memcpy(child_node->link_identifier, ((const unsigned char *)child) + 8, 8);
     //printf("omid:add a child node\n");
     list_add(nodelist, child_node);
+#if UIP_SR_WITH_CACHE
+    child_node->route_version = 0;
+    node_hash_add(child_node);
+#endif /* UIP_SR_WITH_CACHE */
     num_nodes++;
   }
 
   /* Initialize node */
   child_node->graph = graph;
   child_node->lifetime = lifetime;
-  memcpy(child_node->link_identifier, ((const unsigned char *)child) + 8, 8);
 
   /* Is the node reachable before the update? */
   if(uip_sr_is_addr_reachable(graph, child)) {
     old_parent_node = child_node->parent;
     /* Update node */
-    child_node->parent = parent_node;
+    set_parent(child_node, parent_node);
     /* Has the node become unreachable? May happen if we create a loop. */
     if(!uip_sr_is_addr_reachable(graph, child)) {
       /* The new parent makes the node unreachable, restore old parent.
        * We will take the update next time, with chances we know more of
        * the topology and the loop is gone. */
-      child_node->parent = old_parent_node;
+      set_parent(child_node, old_parent_node);
     }
   } else {
-    child_node->parent = parent_node;
+    set_parent(child_node, parent_node);
   }
 
   LOG_INFO("NS: updating link, child ");
@@ -189,6 +400,11 @@ uip_sr_init(void)
   num_nodes = 0;
   memb_init(&nodememb);
   list_init(nodelist);
+#if UIP_SR_WITH_CACHE
+  memset(node_hash, 0, sizeof(node_hash));
+  route_version = 1;
+  route_root = NULL;
+#endif /* UIP_SR_WITH_CACHE */
 }
 /*---------------------------------------------------------------------------*/
 uip_sr_node_t *
@@ -209,16 +425,10 @@ uip_sr_periodic(unsigned seconds)
   uip_sr_node_t *l;
   uip_sr_node_t *next;
 
-  /* First pass, for all expired nodes, deallocate them iff no child points to them */
+  /* Deallocate expired nodes, detaching their children */
   for(l = list_head(nodelist); l != NULL; l = next) {
     next = list_item_next(l);
     if(l->lifetime == 0) {
-      uip_sr_node_t *l2;
-      for(l2 = list_head(nodelist); l2 != NULL; l2 = list_item_next(l2)) {
-        if(l2->parent == l) {
-          break;
-        }
-      }
       if(LOG_INFO_ENABLED) {
         uip_ipaddr_t node_addr;
         NETSTACK_ROUTING.get_sr_node_ipaddr(&node_addr, l);
@@ -226,10 +436,7 @@ uip_sr_periodic(unsigned seconds)
         LOG_INFO_6ADDR(&node_addr);
         LOG_INFO_("\n");
       }
-      /* No child found, deallocate node */
-      list_remove(nodelist, l);
-      memb_free(&nodememb, l);
-      num_nodes--;
+      remove_node(l);
     } else if(l->lifetime != UIP_SR_INFINITE_LIFETIME) {
       l->lifetime = l->lifetime > seconds ? l->lifetime - seconds : 0;
     }
@@ -247,6 +454,11 @@ uip_sr_free_all(void)
     memb_free(&nodememb, l);
     num_nodes--;
   }
+#if UIP_SR_WITH_CACHE
+  memset(node_hash, 0, sizeof(node_hash));
+  route_root = NULL;
+  invalidate_routes();
+#endif /* UIP_SR_WITH_CACHE */
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -85,6 +85,32 @@
 
 #define UIP_SR_INFINITE_LIFETIME           0xFFFFFFFF
 
+/* Index the nodes by link identifier and cache each node's route from the
+ * root, so that a root serving a large network does not walk the node
+ * list and the path for every downward packet. Costs a pointer and 5
+ * bytes (plus padding) per node, and a pointer per bucket of the index.
+ * Off by default: without it, lookups walk the list as they always did. */
+#ifdef UIP_SR_CONF_WITH_CACHE
+#define UIP_SR_WITH_CACHE UIP_SR_CONF_WITH_CACHE
+#else
+#define UIP_SR_WITH_CACHE 0
+#endif
+
+/* Number of buckets of the index of nodes by link identifier. Must be a
+ * power of two. Default: about one bucket per four nodes, at most 64, so
+ * that chains stay short for the price of a few hundred bytes. */
+#ifdef UIP_SR_CONF_HASH_SIZE
+#define UIP_SR_HASH_SIZE UIP_SR_CONF_HASH_SIZE
+#elif UIP_SR_LINK_NUM <= 32
+#define UIP_SR_HASH_SIZE 8
+#elif UIP_SR_LINK_NUM <= 64
+#define UIP_SR_HASH_SIZE 16
+#elif UIP_SR_LINK_NUM <= 128
+#define UIP_SR_HASH_SIZE 32
+#else
+#define UIP_SR_HASH_SIZE 64
+#endif
+
 /********** Data Structures  **********/
 
 /** \brief A node in a source routing graph, stored at the root and representing
@@ -98,6 +124,15 @@ typedef struct uip_sr_node {
   us with the prefix */
   unsigned char link_identifier[8];
   struct uip_sr_node *parent;
+#if UIP_SR_WITH_CACHE
+  /* Next node in the same bucket of the link identifier index */
+  struct uip_sr_node *hash_next;
+  /* Route from the root, cached until the graph changes: number of hops
+  and SRH compression (see uip_sr_get_route) */
+  uint16_t route_version;
+  uint16_t depth;
+  uint8_t cmpr;
+#endif /* UIP_SR_WITH_CACHE */
 } uip_sr_node_t;
 
 /********** Public functions **********/
@@ -162,6 +197,22 @@ uip_sr_node_t *uip_sr_get_node(void *graph, const uip_ipaddr_t *addr);
 */
 int uip_sr_is_addr_reachable(void *graph, const uip_ipaddr_t *addr);
 
+/**
+ * Gets the source route from the root to a node, as needed to build a RPL
+ * Source Routing Header (RFC 6554). With UIP_SR_WITH_CACHE, cached per node
+ * until the graph changes, so that packets to a known destination do not
+ * walk its path.
+ *
+ * \param dest The destination node
+ * \param root The root node
+ * \param path_len Set to the number of hops between the root's child on the
+ * path and the destination
+ * \param cmpr Set to the number of leading bytes that every hop below the
+ * root shares with the destination address, at most 15 (ComprI and ComprE)
+ * \return 1 if the destination is reachable from the root, 0 otherwise
+*/
+int uip_sr_get_route(uip_sr_node_t *dest, uip_sr_node_t *root, uint8_t *path_len, uint8_t *cmpr);
+
 /**
  * A function called periodically. Used to age the links (decrease lifetime
  * and expire links accordingly)
@@ -176,6 +176,7 @@ handle_trans_timeout(void *ptr)
      // printf("trans timeout resend %d\n",trans->number_of_forwarding);
       ctimer_set(&trans->timer, trans->sf->timeout_interval,
              handle_trans_timeout, trans);
+      sixtop_set_packet_lifetime(trans->sf->timeout_interval);
       sixtop_output((const linkaddr_t *)&trans->peer_addr, mac_callback, trans);
   }
  
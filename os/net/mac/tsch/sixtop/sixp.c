@@ -327,6 +327,7 @@ sixp_output(sixp_pkt_type_t type, sixp_pkt_code_t code, uint8_t sfid,
   sixp_pkt_cmd_t cmd;
   int16_t seqno;
   sixp_pkt_t pkt;
+  const sixtop_sf_t *sf;
     /*   int i=0;
   for(i=0;i<8;i++)
   {
@@ -470,7 +471,10 @@ if(nbr == NULL &&
  // printf("17\n");
   sixp_trans_set_callback(trans, func, arg, arg_len);
   //printf("sixp_output\n");
-   
+
+  if((sf = sixtop_find_sf(sfid)) != NULL) {
+    sixtop_set_packet_lifetime(sf->timeout_interval);
+  }
   sixtop_output(dest_addr, mac_callback, trans);
 
  
@@ -45,6 +45,7 @@
 #include "net/packetbuf.h"
 #include "net/mac/framer/frame802154.h"
 #include "net/mac/framer/frame802154e-ie.h"
+#include "net/mac/tsch/tsch.h"
 
 #include "sixtop.h"
 #include "sixtop-conf.h"
@@ -137,6 +138,18 @@ sixtop_find_sf(uint8_t sfid)
 }
 /*---------------------------------------------------------------------------*/
 void
+sixtop_set_packet_lifetime(clock_time_t lifetime)
+{
+#if TSCH_QUEUE_WITH_DEADLINES
+  uint32_t slots = TSCH_CLOCK_TO_SLOTS((uint32_t)lifetime,
+                                       tsch_timing[tsch_ts_timeslot_length]);
+  /* 0 would mean no deadline */
+  packetbuf_set_attr(PACKETBUF_ATTR_TSCH_LIFETIME,
+                     slots == 0 ? 1 : (slots > 0xffff ? 0xffff : slots));
+#endif /* TSCH_QUEUE_WITH_DEADLINES */
+}
+/*---------------------------------------------------------------------------*/
+void
 sixtop_output(const linkaddr_t *dest_addr, mac_callback_t callback, void *arg)
 {
  // printf("sixtop_output\n");
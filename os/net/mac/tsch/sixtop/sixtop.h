@@ -111,6 +111,15 @@ int sixtop_add_sf(const sixtop_sf_t *sf);
  */
 const sixtop_sf_t *sixtop_find_sf(uint8_t sfid);
 
+/**
+ * \brief Bound the time the 6P packet in packetbuf may wait in the TSCH
+ * queue. Past it, the peer has given up on the transaction and the packet is
+ * dropped instead of taking a cell.
+ * \param lifetime The lifetime in clock ticks, usually the timeout interval
+ *        of the SF
+ */
+void sixtop_set_packet_lifetime(clock_time_t lifetime);
+
 /**
  * \brief Output a 6P packet which is supposestored in packetbuf
  * \param dest_addr Destination address of the outgoing packet
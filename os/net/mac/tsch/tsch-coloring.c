@@ -0,0 +1,176 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         GT-TSCH channel allocation for children, seen as an online graph
+ *         coloring. Every child that asks for a channel is a vertex; it is in
+ *         conflict with its siblings (two hops apart through us) and with the
+ *         neighbors whose EB-announced channel its children would overhear.
+ *         Each new vertex gets the least conflicting channel.
+ */
+
+/**
+ * \addtogroup tsch
+ * @{
+*/
+
+#include "contiki.h"
+#include "net/nbr-table.h"
+#include "net/mac/tsch/tsch.h"
+#include "lib/random.h"
+#include <string.h>
+
+/* Log configuration */
+#include "sys/log.h"
+#define LOG_MODULE "TSCH Coloring"
+#define LOG_LEVEL LOG_LEVEL_MAC
+
+/* Conflict weight of a channel already handed to one of our children,
+ * against one heard from a neighbor's EB */
+#define SIBLING_WEIGHT 2
+#define HEARD_WEIGHT 1
+
+struct coloring_nbr {
+  uint8_t channel; /* Channel offset last announced in the neighbor's EBs */
+};
+
+static void coloring_nbr_removed(void *item);
+
+NBR_TABLE(struct coloring_nbr, coloring_nbrs);
+
+/* Number of neighbors announcing each channel offset, kept in sync with
+ * coloring_nbrs so that selection needs no table walk */
+static uint8_t heard_count[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+
+/*---------------------------------------------------------------------------*/
+static void
+heard_update(uint8_t old_channel, uint8_t new_channel)
+{
+  if(old_channel != 0 && old_channel < TSCH_HOPPING_SEQUENCE_MAX_LEN
+     && heard_count[old_channel] > 0) {
+    heard_count[old_channel]--;
+  }
+  if(new_channel != 0 && new_channel < TSCH_HOPPING_SEQUENCE_MAX_LEN) {
+    heard_count[new_channel]++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+coloring_nbr_removed(void *item)
+{
+  heard_update(((struct coloring_nbr *)item)->channel, 0);
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_coloring_init(void)
+{
+  struct coloring_nbr *n;
+  if(nbr_table_is_registered(coloring_nbrs) == 0) {
+    nbr_table_register(coloring_nbrs, (nbr_table_callback *)coloring_nbr_removed);
+  } else {
+    while((n = nbr_table_head(coloring_nbrs)) != NULL) {
+      nbr_table_remove(coloring_nbrs, n);
+    }
+  }
+  memset(heard_count, 0, sizeof(heard_count));
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_coloring_heard(const linkaddr_t *addr, uint8_t channel)
+{
+  struct coloring_nbr *n = nbr_table_get_from_lladdr(coloring_nbrs, addr);
+  if(n == NULL) {
+    if(channel == 0) {
+      return;
+    }
+    n = nbr_table_add_lladdr(coloring_nbrs, addr, NBR_TABLE_REASON_MAC, NULL);
+    if(n == NULL) {
+      return;
+    }
+    n->channel = 0;
+  }
+  if(n->channel != channel) {
+    LOG_DBG("channel %u -> %u for ", n->channel, channel);
+    LOG_DBG_LLADDR(addr);
+    LOG_DBG_("\n");
+    heard_update(n->channel, channel);
+    n->channel = channel;
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+tsch_coloring_heard_count(uint8_t channel)
+{
+  return channel < TSCH_HOPPING_SEQUENCE_MAX_LEN ? heard_count[channel] : 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_coloring_select(void)
+{
+  uint8_t len = tsch_hopping_sequence_length.val;
+  uint8_t start;
+  uint8_t i;
+  int best = -1;
+  uint16_t best_cost = 0xffff;
+
+  if(len == 0) {
+    return -1;
+  }
+  /* Start from a random channel so that ties spread over the network */
+  start = random_rand() % len;
+  for(i = 0; i < len; i++) {
+    uint8_t channel = (start + i) % len;
+    uint16_t cost;
+    if(channel == default_channel || channel == parent_channel
+       || channel == children_channel) {
+      continue;
+    }
+    /* Both counts are kept per channel, so that a selection costs one
+     * pass over the hopping sequence, whatever the number of neighbors */
+    cost = SIBLING_WEIGHT * tsch_ledger_channel_users(channel)
+           + HEARD_WEIGHT * tsch_coloring_heard_count(channel);
+    if(cost < best_cost) {
+      best = channel;
+      best_cost = cost;
+      if(cost == 0) {
+        break;
+      }
+    }
+  }
+
+  if(best < 0) {
+    LOG_ERR("! no channel offset left for children\n");
+  } else if(best_cost > 0) {
+    LOG_WARN("channel offset %d shared, conflict cost %u\n", best, best_cost);
+  }
+  return best;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,73 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \addtogroup tsch
+ * @{
+ * \file
+ *	GT-TSCH two-hop aware channel offset allocation for children
+*/
+
+#ifndef __TSCH_COLORING_H__
+#define __TSCH_COLORING_H__
+
+/********** Includes **********/
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+/********** Functions *********/
+
+/**
+ * \brief Initialize the conflict graph, dropping all neighbors. Call at TSCH init.
+ */
+void tsch_coloring_init(void);
+/**
+ * \brief Record the channel offset a neighbor announced in its EB, i.e. the
+ * channel its own children transmit on
+ * \param addr The link-layer address of the neighbor
+ * \param channel The announced channel offset, 0 if none
+ */
+void tsch_coloring_heard(const linkaddr_t *addr, uint8_t channel);
+/**
+ * \brief Number of neighbors heard announcing a channel offset
+ */
+uint8_t tsch_coloring_heard_count(uint8_t channel);
+/**
+ * \brief Pick the channel offset for a child's own children: the one that
+ * conflicts least with our siblings' channels and with the channels heard
+ * from neighbors, never the default, parent or own children channel.
+ * Runs in O(length of the hopping sequence), reading the per-channel
+ * counters of the ledger and of the conflict graph.
+ * \return The channel offset, -1 if none can be used
+ */
+int tsch_coloring_select(void);
+
+#endif /* __TSCH_COLORING_H__ */
+/** @} */
@@ -300,6 +300,24 @@
 #endif
 #endif
 
+/* The maximum number of outgoing control packets (6P, RPL) towards each
+ * neighbor. These have their own queue, served before data packets.
+ * Must be power of two to enable atomic ringbuf operations. */
+#ifdef TSCH_QUEUE_CONF_NUM_CONTROL_PER_NEIGHBOR
+#define TSCH_QUEUE_NUM_CONTROL_PER_NEIGHBOR TSCH_QUEUE_CONF_NUM_CONTROL_PER_NEIGHBOR
+#else
+#define TSCH_QUEUE_NUM_CONTROL_PER_NEIGHBOR 4
+#endif
+
+/* Support per-packet deadlines, set through PACKETBUF_ATTR_TSCH_LIFETIME
+ * (in timeslots). Packets are dropped from the queue once their deadline
+ * has passed instead of taking a cell. */
+#ifdef TSCH_QUEUE_CONF_WITH_DEADLINES
+#define TSCH_QUEUE_WITH_DEADLINES TSCH_QUEUE_CONF_WITH_DEADLINES
+#else
+#define TSCH_QUEUE_WITH_DEADLINES 1
+#endif
+
 /* The number of neighbor queues. There are two queues allocated at all times:
  * one for EBs, one for broadcasts. Other queues are for unicast to neighbors */
 #ifdef TSCH_QUEUE_CONF_MAX_NEIGHBOR_QUEUES
@@ -308,6 +326,28 @@
 #define TSCH_QUEUE_MAX_NEIGHBOR_QUEUES ((NBR_TABLE_CONF_MAX_NEIGHBORS) + 2)
 #endif
 
+/* Size of the hash table indexing neighbor queues by address. Must be a
+ * power of two, and larger than TSCH_QUEUE_MAX_NEIGHBOR_QUEUES so that
+ * probing always ends on an empty bucket. Default: at least twice the
+ * number of queues. */
+#ifdef TSCH_QUEUE_CONF_NBR_HASH_SIZE
+#define TSCH_QUEUE_NBR_HASH_SIZE TSCH_QUEUE_CONF_NBR_HASH_SIZE
+#elif TSCH_QUEUE_MAX_NEIGHBOR_QUEUES <= 8
+#define TSCH_QUEUE_NBR_HASH_SIZE 16
+#elif TSCH_QUEUE_MAX_NEIGHBOR_QUEUES <= 16
+#define TSCH_QUEUE_NBR_HASH_SIZE 32
+#elif TSCH_QUEUE_MAX_NEIGHBOR_QUEUES <= 32
+#define TSCH_QUEUE_NBR_HASH_SIZE 64
+#elif TSCH_QUEUE_MAX_NEIGHBOR_QUEUES <= 64
+#define TSCH_QUEUE_NBR_HASH_SIZE 128
+#elif TSCH_QUEUE_MAX_NEIGHBOR_QUEUES <= 128
+#define TSCH_QUEUE_NBR_HASH_SIZE 256
+#elif TSCH_QUEUE_MAX_NEIGHBOR_QUEUES <= 256
+#define TSCH_QUEUE_NBR_HASH_SIZE 512
+#else
+#define TSCH_QUEUE_NBR_HASH_SIZE 1024
+#endif
+
 /******** Configuration: scheduling  *******/
 
 /* Initializes TSCH with a 6TiSCH minimal schedule */
@@ -347,6 +387,95 @@
 #define TSCH_SCHEDULE_MAX_LINKS 32
 #endif
 
+/* Max number of removed links waiting to be freed, on top of
+ * TSCH_SCHEDULE_MAX_LINKS. A removed link stays allocated until slot
+ * operation moves to a schedule without it, at the next slot boundary, so
+ * a delete followed by an add (e.g. a 6P relocation) needs both for a
+ * while */
+#ifdef TSCH_SCHEDULE_CONF_MAX_RETIRED_LINKS
+#define TSCH_SCHEDULE_MAX_RETIRED_LINKS TSCH_SCHEDULE_CONF_MAX_RETIRED_LINKS
+#else
+#define TSCH_SCHEDULE_MAX_RETIRED_LINKS 8
+#endif
+
+/* GT-TSCH slotframes. With TSCH_SCHEDULE_CONF_GT_MULTI_SLOTFRAME set, EB and
+ * shared broadcast cells, 6P control cells and data cells live in three
+ * slotframes. Otherwise all of them share slotframe 0. Slotframes still
+ * share the ASN: a cell of one meets, at some ASN, every timeslot of another
+ * equal to it modulo the gcd of their lengths, and only one of the two
+ * links runs there. The allocators skip these timeslots. Each length must divide
+ * the longer ones (checked at build time), e.g. 7, 7 and 21. */
+#ifdef TSCH_SCHEDULE_CONF_GT_MULTI_SLOTFRAME
+#define TSCH_SCHEDULE_GT_MULTI_SLOTFRAME TSCH_SCHEDULE_CONF_GT_MULTI_SLOTFRAME
+#else
+#define TSCH_SCHEDULE_GT_MULTI_SLOTFRAME 0
+#endif
+
+#if TSCH_SCHEDULE_GT_MULTI_SLOTFRAME
+#define TSCH_SCHEDULE_GT_SHARED_HANDLE 0
+#define TSCH_SCHEDULE_GT_CONTROL_HANDLE 1
+#define TSCH_SCHEDULE_GT_DATA_HANDLE 2
+
+#ifdef TSCH_SCHEDULE_CONF_GT_SHARED_LENGTH
+#define TSCH_SCHEDULE_GT_SHARED_LENGTH TSCH_SCHEDULE_CONF_GT_SHARED_LENGTH
+#else
+#define TSCH_SCHEDULE_GT_SHARED_LENGTH TSCH_SCHEDULE_DEFAULT_LENGTH
+#endif
+
+#ifdef TSCH_SCHEDULE_CONF_GT_CONTROL_LENGTH
+#define TSCH_SCHEDULE_GT_CONTROL_LENGTH TSCH_SCHEDULE_CONF_GT_CONTROL_LENGTH
+#else
+#define TSCH_SCHEDULE_GT_CONTROL_LENGTH TSCH_SCHEDULE_DEFAULT_LENGTH
+#endif
+
+#ifdef TSCH_SCHEDULE_CONF_GT_DATA_LENGTH
+#define TSCH_SCHEDULE_GT_DATA_LENGTH TSCH_SCHEDULE_CONF_GT_DATA_LENGTH
+#else
+#define TSCH_SCHEDULE_GT_DATA_LENGTH TSCH_SCHEDULE_DEFAULT_LENGTH
+#endif
+#else /* TSCH_SCHEDULE_GT_MULTI_SLOTFRAME */
+#define TSCH_SCHEDULE_GT_SHARED_HANDLE 0
+#define TSCH_SCHEDULE_GT_CONTROL_HANDLE 0
+#define TSCH_SCHEDULE_GT_DATA_HANDLE 0
+#define TSCH_SCHEDULE_GT_SHARED_LENGTH TSCH_SCHEDULE_DEFAULT_LENGTH
+#define TSCH_SCHEDULE_GT_CONTROL_LENGTH TSCH_SCHEDULE_DEFAULT_LENGTH
+#define TSCH_SCHEDULE_GT_DATA_LENGTH TSCH_SCHEDULE_DEFAULT_LENGTH
+#endif /* TSCH_SCHEDULE_GT_MULTI_SLOTFRAME */
+
+/* GT-TSCH: one advertising cell every TSCH_SCHEDULE_GT_ADV_STRIDE timeslots
+ * of the shared slotframe */
+#ifdef TSCH_SCHEDULE_CONF_GT_ADV_STRIDE
+#define TSCH_SCHEDULE_GT_ADV_STRIDE TSCH_SCHEDULE_CONF_GT_ADV_STRIDE
+#else
+#define TSCH_SCHEDULE_GT_ADV_STRIDE 5
+#endif
+
+/* GT-TSCH pipeline mode: every Rx cell granted to a child must feed one of
+ * our uplinks right after it (or right after the advertising cell that
+ * follows it), so that a packet climbs the DODAG in consecutive timeslots.
+ * Cells are held while offered. The scheduling function refuses them at
+ * install time if they would break the chain: the schedule API itself
+ * takes any link. */
+#ifdef TSCH_SCHEDULE_CONF_GT_PIPELINE
+#define TSCH_SCHEDULE_GT_PIPELINE TSCH_SCHEDULE_CONF_GT_PIPELINE
+#else
+#define TSCH_SCHEDULE_GT_PIPELINE 1
+#endif
+
+/* Max slotframe length covered by the per-slotframe timeslot index (occupancy
+ * bitmap and timeslot-to-link table). Lookups in longer slotframes fall back
+ * to walking the link list. */
+#ifdef TSCH_SCHEDULE_CONF_INDEX_MAX_LENGTH
+#define TSCH_SCHEDULE_INDEX_MAX_LENGTH TSCH_SCHEDULE_CONF_INDEX_MAX_LENGTH
+#else
+/* Cover the longest of the GT-TSCH slotframes */
+#define TSCH_SCHEDULE_INDEX_MAX_LENGTH \
+  (TSCH_SCHEDULE_GT_DATA_LENGTH > TSCH_SCHEDULE_DEFAULT_LENGTH ? TSCH_SCHEDULE_GT_DATA_LENGTH : TSCH_SCHEDULE_DEFAULT_LENGTH)
+#endif
+
+/* Number of 32-bit words in the timeslot occupancy bitmap */
+#define TSCH_SCHEDULE_INDEX_WORDS ((TSCH_SCHEDULE_INDEX_MAX_LENGTH + 31) / 32)
+
 /* To include Sixtop Implementation */
 #ifdef TSCH_CONF_WITH_SIXTOP
 #define TSCH_WITH_SIXTOP TSCH_CONF_WITH_SIXTOP
@@ -439,6 +568,22 @@ by default, useful in case of duplicate seqno */
 #define TSCH_DEFAULT_TIMESLOT_TIMING tsch_timeslot_timing_us_10000
 #endif
 
+/* Timeslot timing calibration, with TSCH_STATS_CONF_SLOT_TIMING: how much
+ * longer than measured, in percent, a template must leave for each phase
+ * of slot operation to be deemed safe */
+#ifdef TSCH_CONF_TIMING_CALIBRATION_MARGIN
+#define TSCH_TIMING_CALIBRATION_MARGIN TSCH_CONF_TIMING_CALIBRATION_MARGIN
+#else
+#define TSCH_TIMING_CALIBRATION_MARGIN 25
+#endif
+
+/* Timeslot timing calibration: number of active slots to measure first */
+#ifdef TSCH_CONF_TIMING_CALIBRATION_MIN_SLOTS
+#define TSCH_TIMING_CALIBRATION_MIN_SLOTS TSCH_CONF_TIMING_CALIBRATION_MIN_SLOTS
+#else
+#define TSCH_TIMING_CALIBRATION_MIN_SLOTS 100
+#endif
+
 /* Configurable Rx guard time is micro-seconds */
 #ifndef TSCH_CONF_RX_WAIT
 #define TSCH_CONF_RX_WAIT 2200
@@ -0,0 +1,427 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         GT-TSCH per-neighbor cell ledger. Keeps, for each child, the cells
+ *         granted to it, the cells offered and pending 6P confirmation, the
+ *         cells still owed to it, and the channel offset it was assigned.
+ */
+
+/**
+ * \addtogroup tsch
+ * @{
+*/
+
+#include "contiki.h"
+#include "lib/probe-hash.h"
+#include "net/nbr-table.h"
+#include "net/mac/tsch/tsch.h"
+#include <string.h>
+
+/* Log configuration */
+#include "sys/log.h"
+#define LOG_MODULE "TSCH Ledger"
+#define LOG_LEVEL LOG_LEVEL_MAC
+
+NBR_TABLE(struct tsch_ledger_entry, ledger);
+
+/* Sum of the owed field over all entries */
+static uint16_t owed_total;
+/* Number of entries per channel offset, channel offset 0 standing for none */
+static uint8_t channel_users[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+
+/* Index of the pending fields of all entries by cell: open addressing with
+ * linear probing. A cell offered to several children is stored once, with
+ * the number of children it is pending for; an empty slot has count 0. */
+struct pending_cell {
+  uint16_t timeslot;
+  uint16_t channel_offset;
+  uint8_t count;
+};
+static struct pending_cell pending_hash[TSCH_LEDGER_PENDING_HASH_SIZE];
+/* Sum of the pending_count field over all entries */
+static uint8_t pending_total;
+
+#define PENDING_HASH_NEXT(i) PROBE_HASH_NEXT(i, TSCH_LEDGER_PENDING_HASH_SIZE)
+
+/*---------------------------------------------------------------------------*/
+/* Home bucket of a cell */
+static uint16_t
+pending_hash_bucket(uint16_t timeslot, uint16_t channel_offset)
+{
+  return (timeslot * 31 + channel_offset) & (TSCH_LEDGER_PENDING_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Slot of a cell in the index: the slot holding it, else the empty slot
+ * that ends its probe sequence */
+static uint16_t
+pending_hash_find(uint16_t timeslot, uint16_t channel_offset)
+{
+  uint16_t i = pending_hash_bucket(timeslot, channel_offset);
+  while(pending_hash[i].count != 0
+        && (pending_hash[i].timeslot != timeslot
+            || pending_hash[i].channel_offset != channel_offset)) {
+    i = PENDING_HASH_NEXT(i);
+  }
+  return i;
+}
+/*---------------------------------------------------------------------------*/
+static int
+pending_hash_add(uint16_t timeslot, uint16_t channel_offset)
+{
+  uint16_t i;
+  if(pending_total >= TSCH_LEDGER_MAX_PENDING_TOTAL) {
+    return 0;
+  }
+  i = pending_hash_find(timeslot, channel_offset);
+  pending_hash[i].timeslot = timeslot;
+  pending_hash[i].channel_offset = channel_offset;
+  pending_hash[i].count++;
+  pending_total++;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Removes a cell, shifting back the slots that probed past it once no child
+ * has it pending anymore, so that no tombstone is needed */
+static void
+pending_hash_remove(uint16_t timeslot, uint16_t channel_offset)
+{
+  uint16_t i = pending_hash_find(timeslot, channel_offset);
+  uint16_t j;
+  if(pending_hash[i].count == 0) {
+    LOG_ERR("! pending cell %u %u missing from index\n", timeslot, channel_offset);
+    return;
+  }
+  pending_total--;
+  if(--pending_hash[i].count > 0) {
+    return;
+  }
+  for(j = PENDING_HASH_NEXT(i); pending_hash[j].count != 0; j = PENDING_HASH_NEXT(j)) {
+    uint16_t k = pending_hash_bucket(pending_hash[j].timeslot,
+                                     pending_hash[j].channel_offset);
+    if(probe_hash_can_fill(i, j, k)) {
+      pending_hash[i] = pending_hash[j];
+      pending_hash[j].count = 0;
+      i = j;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+channel_users_update(uint8_t old_channel, uint8_t new_channel)
+{
+  if(old_channel != 0 && old_channel < TSCH_HOPPING_SEQUENCE_MAX_LEN
+     && channel_users[old_channel] > 0) {
+    channel_users[old_channel]--;
+  }
+  if(new_channel != 0 && new_channel < TSCH_HOPPING_SEQUENCE_MAX_LEN) {
+    channel_users[new_channel]++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Drops the cells pending for an entry from the index */
+static void
+clear_entry_pending(struct tsch_ledger_entry *e)
+{
+  uint8_t i;
+  for(i = 0; i < e->pending_count; i++) {
+    pending_hash_remove(e->pending[i].timeslot_offset, e->pending[i].channel_offset);
+  }
+  e->pending_count = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Called by the neighbor table when an entry is removed, typically on
+ * tsch_ledger_init: takes its contribution out of the aggregates */
+static void
+ledger_entry_removed(void *item)
+{
+  struct tsch_ledger_entry *e = item;
+  owed_total = e->owed < owed_total ? owed_total - e->owed : 0;
+  channel_users_update(e->channel, 0);
+  clear_entry_pending(e);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Checks the invariants of an entry after an update, repairing it if needed,
+ * and locks the entry in the neighbor table for as long as it holds state */
+static void
+check_entry(struct tsch_ledger_entry *e)
+{
+  if(e->reserved > e->granted) {
+    LOG_ERR("! %u reserved cells for %u granted, for ", e->reserved, e->granted);
+    LOG_ERR_LLADDR(tsch_ledger_get_addr(e));
+    LOG_ERR_("\n");
+    e->reserved = e->granted;
+  }
+  if(e->pending_count > TSCH_LEDGER_MAX_PENDING) {
+    LOG_ERR("! %u pending cells\n", e->pending_count);
+    e->pending_count = TSCH_LEDGER_MAX_PENDING;
+  }
+  if(e->owed > owed_total) {
+    LOG_ERR("! %u cells owed above total %u\n", e->owed, owed_total);
+  }
+
+  if(e->granted == 0 && e->owed == 0 && e->pending_count == 0 && e->channel == 0) {
+    nbr_table_unlock(ledger, e);
+  } else {
+    nbr_table_lock(ledger, e);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_ledger_init(void)
+{
+  struct tsch_ledger_entry *e;
+  if(nbr_table_is_registered(ledger) == 0) {
+    nbr_table_register(ledger, (nbr_table_callback *)ledger_entry_removed);
+  } else {
+    while((e = nbr_table_head(ledger)) != NULL) {
+      nbr_table_remove(ledger, e);
+    }
+  }
+  owed_total = 0;
+  memset(channel_users, 0, sizeof(channel_users));
+  memset(pending_hash, 0, sizeof(pending_hash));
+  pending_total = 0;
+}
+/*---------------------------------------------------------------------------*/
+struct tsch_ledger_entry *
+tsch_ledger_get(const linkaddr_t *addr)
+{
+  if(addr == NULL) {
+    return NULL;
+  }
+  return nbr_table_get_from_lladdr(ledger, addr);
+}
+/*---------------------------------------------------------------------------*/
+struct tsch_ledger_entry *
+tsch_ledger_get_or_add(const linkaddr_t *addr)
+{
+  struct tsch_ledger_entry *e = tsch_ledger_get(addr);
+  if(e == NULL && addr != NULL) {
+    e = nbr_table_add_lladdr(ledger, addr, NBR_TABLE_REASON_SIXTOP, NULL);
+    if(e != NULL) {
+      memset(e, 0, sizeof(struct tsch_ledger_entry));
+    } else {
+      LOG_ERR("! no room in ledger for ");
+      LOG_ERR_LLADDR(addr);
+      LOG_ERR_("\n");
+    }
+  }
+  return e;
+}
+/*---------------------------------------------------------------------------*/
+const linkaddr_t *
+tsch_ledger_get_addr(const struct tsch_ledger_entry *e)
+{
+  return nbr_table_get_lladdr(ledger, e);
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_ledger_add_granted(const linkaddr_t *addr, uint8_t reserved)
+{
+  struct tsch_ledger_entry *e = tsch_ledger_get_or_add(addr);
+  if(e == NULL) {
+    return 0;
+  }
+  e->granted++;
+  if(reserved) {
+    e->reserved++;
+  }
+  check_entry(e);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_ledger_remove_granted(const linkaddr_t *addr, uint8_t reserved)
+{
+  struct tsch_ledger_entry *e = tsch_ledger_get(addr);
+  if(e == NULL || e->granted == 0) {
+    LOG_ERR("! removing a cell never granted to ");
+    LOG_ERR_LLADDR(addr);
+    LOG_ERR_("\n");
+    return 0;
+  }
+  e->granted--;
+  if(reserved && e->reserved > 0) {
+    e->reserved--;
+  }
+  check_entry(e);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+tsch_ledger_add_owed(const linkaddr_t *addr, uint8_t count)
+{
+  struct tsch_ledger_entry *e = tsch_ledger_get_or_add(addr);
+  if(e == NULL) {
+    return 0;
+  }
+  if(count > 0xff - e->owed) {
+    LOG_WARN("debt of %u cells saturated, dropping %u for ", e->owed,
+             count - (0xff - e->owed));
+    LOG_WARN_LLADDR(addr);
+    LOG_WARN_("\n");
+    count = 0xff - e->owed;
+  }
+  e->owed += count;
+  owed_total += count;
+  check_entry(e);
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+tsch_ledger_remove_owed(const linkaddr_t *addr, uint8_t count)
+{
+  struct tsch_ledger_entry *e = tsch_ledger_get(addr);
+  if(e == NULL) {
+    return 0;
+  }
+  if(count > e->owed) {
+    count = e->owed;
+  }
+  e->owed -= count;
+  owed_total -= count;
+  check_entry(e);
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+tsch_ledger_owed_total(void)
+{
+  return owed_total;
+}
+/*---------------------------------------------------------------------------*/
+struct tsch_ledger_entry *
+tsch_ledger_first_owed(void)
+{
+  if(owed_total == 0) {
+    return NULL;
+  }
+  return tsch_ledger_next_owed(NULL);
+}
+/*---------------------------------------------------------------------------*/
+struct tsch_ledger_entry *
+tsch_ledger_next_owed(struct tsch_ledger_entry *e)
+{
+  e = e == NULL ? nbr_table_head(ledger) : nbr_table_next(ledger, e);
+  for(; e != NULL; e = nbr_table_next(ledger, e)) {
+    if(e->owed > 0) {
+      return e;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_ledger_add_pending(const linkaddr_t *addr, uint16_t timeslot, uint16_t channel_offset)
+{
+  struct tsch_ledger_entry *e = tsch_ledger_get_or_add(addr);
+  if(e == NULL || e->pending_count >= TSCH_LEDGER_MAX_PENDING
+     || !pending_hash_add(timeslot, channel_offset)) {
+    return 0;
+  }
+  e->pending[e->pending_count].timeslot_offset = timeslot;
+  e->pending[e->pending_count].channel_offset = channel_offset;
+  e->pending_count++;
+  check_entry(e);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_ledger_remove_pending(const linkaddr_t *addr, uint16_t timeslot, uint16_t channel_offset)
+{
+  struct tsch_ledger_entry *e = tsch_ledger_get(addr);
+  uint8_t i;
+  if(e == NULL) {
+    return 0;
+  }
+  for(i = 0; i < e->pending_count; i++) {
+    if(e->pending[i].timeslot_offset == timeslot
+       && e->pending[i].channel_offset == channel_offset) {
+      pending_hash_remove(timeslot, channel_offset);
+      /* Order does not matter: move the last cell into the hole */
+      e->pending[i] = e->pending[--e->pending_count];
+      check_entry(e);
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_ledger_clear_pending(const linkaddr_t *addr)
+{
+  struct tsch_ledger_entry *e = tsch_ledger_get(addr);
+  if(e != NULL) {
+    clear_entry_pending(e);
+    check_entry(e);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_ledger_is_pending(uint16_t timeslot, uint16_t channel_offset)
+{
+  return pending_hash[pending_hash_find(timeslot, channel_offset)].count != 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_ledger_set_channel(const linkaddr_t *addr, uint8_t channel)
+{
+  struct tsch_ledger_entry *e = tsch_ledger_get_or_add(addr);
+  if(e == NULL) {
+    return 0;
+  }
+  channel_users_update(e->channel, channel);
+  e->channel = channel;
+  check_entry(e);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+tsch_ledger_get_channel(const linkaddr_t *addr)
+{
+  struct tsch_ledger_entry *e = tsch_ledger_get(addr);
+  return e != NULL ? e->channel : 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_ledger_channel_in_use(uint8_t channel)
+{
+  return tsch_ledger_channel_users(channel) > 0;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+tsch_ledger_channel_users(uint8_t channel)
+{
+  return channel < TSCH_HOPPING_SEQUENCE_MAX_LEN ? channel_users[channel] : 0;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
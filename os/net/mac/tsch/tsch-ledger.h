@@ -0,0 +1,206 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \addtogroup tsch
+ * @{
+ * \file
+ *	GT-TSCH per-neighbor cell ledger
+*/
+
+#ifndef __TSCH_LEDGER_H__
+#define __TSCH_LEDGER_H__
+
+/********** Includes **********/
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+#include "net/mac/tsch/tsch-conf.h"
+
+/********** Configuration *********/
+
+/* Max number of cells offered to a single child and not yet confirmed */
+#ifdef TSCH_LEDGER_CONF_MAX_PENDING
+#define TSCH_LEDGER_MAX_PENDING TSCH_LEDGER_CONF_MAX_PENDING
+#else
+#define TSCH_LEDGER_MAX_PENDING 4
+#endif
+
+/* Max number of cells pending 6P confirmation over all children */
+#ifdef TSCH_LEDGER_CONF_MAX_PENDING_TOTAL
+#define TSCH_LEDGER_MAX_PENDING_TOTAL TSCH_LEDGER_CONF_MAX_PENDING_TOTAL
+#else
+#define TSCH_LEDGER_MAX_PENDING_TOTAL (4 * TSCH_LEDGER_MAX_PENDING)
+#endif
+
+/* Size of the index of pending cells. Must be a power of two, larger than
+ * TSCH_LEDGER_MAX_PENDING_TOTAL so that probe sequences stay short */
+#ifdef TSCH_LEDGER_CONF_PENDING_HASH_SIZE
+#define TSCH_LEDGER_PENDING_HASH_SIZE TSCH_LEDGER_CONF_PENDING_HASH_SIZE
+#elif TSCH_LEDGER_MAX_PENDING_TOTAL <= 8
+#define TSCH_LEDGER_PENDING_HASH_SIZE 16
+#elif TSCH_LEDGER_MAX_PENDING_TOTAL <= 16
+#define TSCH_LEDGER_PENDING_HASH_SIZE 32
+#elif TSCH_LEDGER_MAX_PENDING_TOTAL <= 32
+#define TSCH_LEDGER_PENDING_HASH_SIZE 64
+#elif TSCH_LEDGER_MAX_PENDING_TOTAL <= 64
+#define TSCH_LEDGER_PENDING_HASH_SIZE 128
+#else
+#define TSCH_LEDGER_PENDING_HASH_SIZE 256
+#endif
+
+#if (TSCH_LEDGER_PENDING_HASH_SIZE & (TSCH_LEDGER_PENDING_HASH_SIZE - 1)) != 0
+#error TSCH_LEDGER_PENDING_HASH_SIZE must be a power of two
+#endif
+#if TSCH_LEDGER_PENDING_HASH_SIZE <= TSCH_LEDGER_MAX_PENDING_TOTAL
+#error TSCH_LEDGER_PENDING_HASH_SIZE must be larger than TSCH_LEDGER_MAX_PENDING_TOTAL
+#endif
+
+/********** Data types **********/
+
+/** \brief GT-TSCH bookkeeping for one child, stored in a neighbor table
+ * and therefore sized by NBR_TABLE_MAX_NEIGHBORS */
+struct tsch_ledger_entry {
+  uint8_t granted; /* Rx cells installed for the child's uplink traffic */
+  uint8_t reserved; /* Of those, how many consumed one of our free uplink cells */
+  uint8_t owed; /* Cells the child asked for that we could not grant yet */
+  uint8_t channel; /* Channel offset assigned to the child for its own children, 0 if none */
+  uint8_t pending_count; /* Number of valid entries in pending */
+  sf_simple_cell_t pending[TSCH_LEDGER_MAX_PENDING]; /* Cells offered to the child, awaiting 6P confirmation */
+};
+
+/********** Functions *********/
+
+/**
+ * \brief Initialize the ledger, dropping all entries. Call at TSCH init.
+ */
+void tsch_ledger_init(void);
+/**
+ * \brief Get the ledger entry of a neighbor
+ * \param addr The link-layer address of the neighbor
+ * \return The entry, NULL if the neighbor has none
+ */
+struct tsch_ledger_entry *tsch_ledger_get(const linkaddr_t *addr);
+/**
+ * \brief Get the ledger entry of a neighbor, creating an empty one if needed
+ * \param addr The link-layer address of the neighbor
+ * \return The entry, NULL if the neighbor table is full
+ */
+struct tsch_ledger_entry *tsch_ledger_get_or_add(const linkaddr_t *addr);
+/**
+ * \brief Get the link-layer address of a ledger entry
+ */
+const linkaddr_t *tsch_ledger_get_addr(const struct tsch_ledger_entry *e);
+/**
+ * \brief Account for an Rx cell installed for a child
+ * \param addr The child's link-layer address
+ * \param reserved 1 if the cell consumed one of our free uplink cells
+ * \return 1 if success, 0 if failure
+ */
+int tsch_ledger_add_granted(const linkaddr_t *addr, uint8_t reserved);
+/**
+ * \brief Account for an Rx cell removed from a child
+ * \param addr The child's link-layer address
+ * \param reserved 1 if the cell had consumed one of our free uplink cells
+ * \return 1 if success, 0 if failure
+ */
+int tsch_ledger_remove_granted(const linkaddr_t *addr, uint8_t reserved);
+/**
+ * \brief Record cells we owe to a child. The debt of a child saturates
+ * at 255 cells.
+ * \param addr The child's link-layer address
+ * \param count The number of cells to add to the debt
+ * \return The number of cells actually added to the debt, 0 if failure
+ */
+uint8_t tsch_ledger_add_owed(const linkaddr_t *addr, uint8_t count);
+/**
+ * \brief Pay back cells owed to a child
+ * \param addr The child's link-layer address
+ * \param count The number of cells paid back
+ * \return The number of cells actually deducted from the debt
+ */
+uint8_t tsch_ledger_remove_owed(const linkaddr_t *addr, uint8_t count);
+/**
+ * \brief Total number of cells owed to all children, in O(1)
+ */
+uint16_t tsch_ledger_owed_total(void);
+/**
+ * \brief Find a child we owe cells to
+ * \return The first entry with a non-zero debt, NULL if none
+ */
+struct tsch_ledger_entry *tsch_ledger_first_owed(void);
+/**
+ * \brief Find the next child we owe cells to
+ * \param e The entry to continue from
+ * \return The next entry with a non-zero debt, NULL if none
+ */
+struct tsch_ledger_entry *tsch_ledger_next_owed(struct tsch_ledger_entry *e);
+/**
+ * \brief Record a cell offered to a child, pending 6P confirmation
+ * \return 1 if success, 0 if failure (no entry available, or too many
+ * cells pending for the child or in total)
+ */
+int tsch_ledger_add_pending(const linkaddr_t *addr, uint16_t timeslot, uint16_t channel_offset);
+/**
+ * \brief Drop a pending cell once the 6P transaction completed
+ * \return 1 if the cell was pending, 0 otherwise
+ */
+int tsch_ledger_remove_pending(const linkaddr_t *addr, uint16_t timeslot, uint16_t channel_offset);
+/**
+ * \brief Drop all cells pending for a child, e.g. after a failed transaction
+ */
+void tsch_ledger_clear_pending(const linkaddr_t *addr);
+/**
+ * \brief Is a cell pending for any child? In O(1)
+ * \return 1 if the cell is pending, 0 otherwise
+ */
+int tsch_ledger_is_pending(uint16_t timeslot, uint16_t channel_offset);
+/**
+ * \brief Set the channel offset assigned to a child
+ * \return 1 if success, 0 if failure
+ */
+int tsch_ledger_set_channel(const linkaddr_t *addr, uint8_t channel);
+/**
+ * \brief Get the channel offset assigned to a child
+ * \return The channel offset, 0 if none
+ */
+uint8_t tsch_ledger_get_channel(const linkaddr_t *addr);
+/**
+ * \brief Is a channel offset already assigned to any child? In O(1)
+ * \return 1 if yes, 0 otherwise (always 0 for channel offset 0, which
+ * stands for no assignment)
+ */
+int tsch_ledger_channel_in_use(uint8_t channel);
+/**
+ * \brief Number of children a channel offset is assigned to, in O(1)
+ */
+uint8_t tsch_ledger_channel_users(uint8_t channel);
+
+#endif /* __TSCH_LEDGER_H__ */
+/** @} */
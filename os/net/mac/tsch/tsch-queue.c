@@ -50,8 +50,10 @@
 #include "contiki.h"
 #include "lib/list.h"
 #include "lib/memb.h"
+#include "lib/probe-hash.h"
 #include "lib/random.h"
 #include "net/queuebuf.h"
+#include "net/ipv6/uip-icmp6.h"
 #include "net/mac/tsch/tsch.h"
 #include <string.h>
 
@@ -60,10 +62,21 @@
 #define LOG_MODULE "TSCH Queue"
 #define LOG_LEVEL LOG_LEVEL_MAC
 int drops;
+int control_drops;
+int stale_drops;
 /* Check if TSCH_QUEUE_NUM_PER_NEIGHBOR is power of two */
 #if (TSCH_QUEUE_NUM_PER_NEIGHBOR & (TSCH_QUEUE_NUM_PER_NEIGHBOR - 1)) != 0
 #error TSCH_QUEUE_NUM_PER_NEIGHBOR must be power of two
 #endif
+#if (TSCH_QUEUE_NUM_CONTROL_PER_NEIGHBOR & (TSCH_QUEUE_NUM_CONTROL_PER_NEIGHBOR - 1)) != 0
+#error TSCH_QUEUE_NUM_CONTROL_PER_NEIGHBOR must be power of two
+#endif
+#if (TSCH_QUEUE_NBR_HASH_SIZE & (TSCH_QUEUE_NBR_HASH_SIZE - 1)) != 0
+#error TSCH_QUEUE_NBR_HASH_SIZE must be power of two
+#endif
+#if TSCH_QUEUE_NBR_HASH_SIZE <= TSCH_QUEUE_MAX_NEIGHBOR_QUEUES
+#error TSCH_QUEUE_NBR_HASH_SIZE must be larger than TSCH_QUEUE_MAX_NEIGHBOR_QUEUES
+#endif
 
 /* We have as many packets are there are queuebuf in the system */
 MEMB(packet_memb, struct tsch_packet, QUEUEBUF_NUM);
@@ -74,6 +87,55 @@ LIST(neighbor_list);
 struct tsch_neighbor *n_broadcast;
 struct tsch_neighbor *n_eb;
 
+/* Index of neighbor_list by address: open addressing with linear probing.
+ * Updated with the lock held, like neighbor_list, so that lookups from
+ * slot operation see a consistent table. */
+static struct tsch_neighbor *nbr_hash[TSCH_QUEUE_NBR_HASH_SIZE];
+
+#define NBR_HASH_NEXT(i) PROBE_HASH_NEXT(i, TSCH_QUEUE_NBR_HASH_SIZE)
+
+/*---------------------------------------------------------------------------*/
+/* Home bucket of an address */
+static uint16_t
+nbr_hash_bucket(const linkaddr_t *addr)
+{
+  return probe_hash_bytes(addr->u8, LINKADDR_SIZE, TSCH_QUEUE_NBR_HASH_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+nbr_hash_add(struct tsch_neighbor *n)
+{
+  uint16_t i = nbr_hash_bucket(&n->addr);
+  while(nbr_hash[i] != NULL) {
+    i = NBR_HASH_NEXT(i);
+  }
+  nbr_hash[i] = n;
+}
+/*---------------------------------------------------------------------------*/
+/* Removes a neighbor, shifting back the entries that probed past it so that
+ * no tombstone is needed */
+static void
+nbr_hash_remove(struct tsch_neighbor *n)
+{
+  uint16_t i = nbr_hash_bucket(&n->addr);
+  uint16_t j;
+  while(nbr_hash[i] != n) {
+    if(nbr_hash[i] == NULL) {
+      return;
+    }
+    i = NBR_HASH_NEXT(i);
+  }
+  nbr_hash[i] = NULL;
+  for(j = NBR_HASH_NEXT(i); nbr_hash[j] != NULL; j = NBR_HASH_NEXT(j)) {
+    uint16_t k = nbr_hash_bucket(&nbr_hash[j]->addr);
+    if(probe_hash_can_fill(i, j, k)) {
+      nbr_hash[i] = nbr_hash[j];
+      nbr_hash[j] = NULL;
+      i = j;
+    }
+  }
+}
+
 /*---------------------------------------------------------------------------*/
 /* Add a TSCH neighbor */
 struct tsch_neighbor *
@@ -90,12 +152,14 @@ tsch_queue_add_nbr(const linkaddr_t *addr)
         /* Initialize neighbor entry */
         memset(n, 0, sizeof(struct tsch_neighbor));
         ringbufindex_init(&n->tx_ringbuf, TSCH_QUEUE_NUM_PER_NEIGHBOR);
+        ringbufindex_init(&n->tx_control_ringbuf, TSCH_QUEUE_NUM_CONTROL_PER_NEIGHBOR);
         linkaddr_copy(&n->addr, addr);
         n->is_broadcast = linkaddr_cmp(addr, &tsch_eb_address)
           || linkaddr_cmp(addr, &tsch_broadcast_address);
         tsch_queue_backoff_reset(n);
         /* Add neighbor to the list */
         list_add(neighbor_list, n);
+        nbr_hash_add(n);
       }
       tsch_release_lock();
     }
@@ -108,16 +172,25 @@ struct tsch_neighbor *
 tsch_queue_get_nbr(const linkaddr_t *addr)
 {
   if(!tsch_is_locked()) {
-    struct tsch_neighbor *n = list_head(neighbor_list);
-    while(n != NULL) {
-      if(linkaddr_cmp(&n->addr, addr)) {
-        return n;
+    uint16_t i;
+    for(i = nbr_hash_bucket(addr); nbr_hash[i] != NULL; i = NBR_HASH_NEXT(i)) {
+      if(linkaddr_cmp(&nbr_hash[i]->addr, addr)) {
+        return nbr_hash[i];
       }
-      n = list_item_next(n);
     }
   }
   return NULL;
 }
+/*---------------------------------------------------------------------------*/
+/* Get the TSCH neighbor a link transmits to */
+struct tsch_neighbor *
+tsch_queue_get_nbr_for_link(struct tsch_link *link)
+{
+  if(link->nbr == NULL) {
+    link->nbr = tsch_queue_get_nbr(&link->addr);
+  }
+  return link->nbr;
+}
 
 
 ///DTSF////////////////////////////////////////////////////////////////////////
@@ -230,6 +303,9 @@ tsch_queue_remove_nbr(struct tsch_neighbor *n)
 
       /* Remove neighbor from list */
       list_remove(neighbor_list, n);
+      nbr_hash_remove(n);
+      /* No link may keep pointing to the freed queue */
+      tsch_schedule_forget_nbr(n);
 
       tsch_release_lock();
 
@@ -242,6 +318,33 @@ tsch_queue_remove_nbr(struct tsch_neighbor *n)
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Ringbuf of a neighbor queue for a class */
+static struct ringbufindex *
+class_ringbuf(struct tsch_neighbor *n, uint8_t queue_class)
+{
+  return queue_class == TSCH_QUEUE_CLASS_CONTROL ? &n->tx_control_ringbuf : &n->tx_ringbuf;
+}
+/*---------------------------------------------------------------------------*/
+/* Array of a neighbor queue for a class */
+static struct tsch_packet **
+class_array(struct tsch_neighbor *n, uint8_t queue_class)
+{
+  return queue_class == TSCH_QUEUE_CLASS_CONTROL ? n->tx_control_array : n->tx_array;
+}
+/*---------------------------------------------------------------------------*/
+/* Class of the packet in packetbuf: 6P frames (the only ones carrying
+ * MAC metadata) and RPL messages are control, all others are data */
+static uint8_t
+packetbuf_queue_class(void)
+{
+  if(packetbuf_attr(PACKETBUF_ATTR_MAC_METADATA)
+     || (packetbuf_attr(PACKETBUF_ATTR_NETWORK_ID) == UIP_PROTO_ICMP6
+         && (packetbuf_attr(PACKETBUF_ATTR_CHANNEL) >> 8) == ICMP6_RPL)) {
+    return TSCH_QUEUE_CLASS_CONTROL;
+  }
+  return TSCH_QUEUE_CLASS_DATA;
+}
+/*---------------------------------------------------------------------------*/
 /* Add packet to neighbor queue. Use same lockfree implementation as ringbuf.c (put is atomic) */
 struct tsch_packet *
 tsch_queue_add_packet(const linkaddr_t *addr, uint8_t max_transmissions,
@@ -250,6 +353,7 @@ tsch_queue_add_packet(const linkaddr_t *addr, uint8_t max_transmissions,
   struct tsch_neighbor *n = NULL;
   int16_t put_index = -1;
   struct tsch_packet *p = NULL;
+  uint8_t queue_class = packetbuf_queue_class();
 
 #ifdef TSCH_CALLBACK_PACKET_READY
   /* The scheduler provides a callback which sets the timeslot and other attributes */
@@ -265,7 +369,13 @@ tsch_queue_add_packet(const linkaddr_t *addr, uint8_t max_transmissions,
         n = tsch_queue_add_nbr(addr);
         if(n != NULL) 
         {
-            put_index = ringbufindex_peek_put(&n->tx_ringbuf);
+            put_index = ringbufindex_peek_put(class_ringbuf(n, queue_class));
+#if TSCH_QUEUE_WITH_DEADLINES
+            if(put_index == -1 && tsch_queue_purge_stale_packets() > 0) {
+              /* Expired packets may have left room in the ring */
+              put_index = ringbufindex_peek_put(class_ringbuf(n, queue_class));
+            }
+#endif /* TSCH_QUEUE_WITH_DEADLINES */
             if(put_index != -1) 
             {
                 p = memb_alloc(&packet_memb);
@@ -280,9 +390,17 @@ tsch_queue_add_packet(const linkaddr_t *addr, uint8_t max_transmissions,
                         p->ret = MAC_TX_DEFERRED;
                         p->transmissions = 0;
                         p->max_transmissions = max_transmissions;
+                        p->queue_class = queue_class;
+#if TSCH_QUEUE_WITH_DEADLINES
+                        p->has_deadline = packetbuf_attr(PACKETBUF_ATTR_TSCH_LIFETIME) != 0;
+                        if(p->has_deadline) {
+                          p->deadline = tsch_current_asn;
+                          TSCH_ASN_INC(p->deadline, packetbuf_attr(PACKETBUF_ATTR_TSCH_LIFETIME));
+                        }
+#endif /* TSCH_QUEUE_WITH_DEADLINES */
                         /* Add to ringbuf (actual add committed through atomic operation) */
-                        n->tx_array[put_index] = p;
-                        ringbufindex_put(&n->tx_ringbuf);
+                        class_array(n, queue_class)[put_index] = p;
+                        ringbufindex_put(class_ringbuf(n, queue_class));
                         LOG_DBG("packet is added put_index %u, packet %p\n",put_index, p);
                         return p;
                     } 
@@ -295,7 +413,17 @@ tsch_queue_add_packet(const linkaddr_t *addr, uint8_t max_transmissions,
         }
   }
   LOG_ERR("! add packet failed: %u %p %d %p %p\n", tsch_is_locked(), n, put_index, p, p ? p->qb : NULL);
+#if TSCH_QUEUE_WITH_DEADLINES
+  if(put_index != -1) {
+    /* Out of packets or queuebufs: those held by expired packets are
+     * released once tsch_tx_process_pending has run, for the next ones */
+    tsch_queue_purge_stale_packets();
+  }
+#endif /* TSCH_QUEUE_WITH_DEADLINES */
   drops++;
+  if(queue_class == TSCH_QUEUE_CLASS_CONTROL) {
+    control_drops++;
+  }
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
@@ -314,29 +442,140 @@ tsch_queue_packet_count(const linkaddr_t *addr)
   if(!tsch_is_locked()) {
     n = tsch_queue_add_nbr(addr);
     if(n != NULL) {
-      return ringbufindex_elements(&n->tx_ringbuf);
+      return tsch_queue_nbr_packet_count(n);
     }
   }
   return -1;
 }
 /*---------------------------------------------------------------------------*/
+/* Returns the number of packets in a neighbor queue, all classes included */
+int
+tsch_queue_nbr_packet_count(const struct tsch_neighbor *n)
+{
+  return ringbufindex_elements(&n->tx_ringbuf)
+    + ringbufindex_elements(&n->tx_control_ringbuf);
+}
+/*---------------------------------------------------------------------------*/
+/* Remove first packet of a class from a neighbor queue */
+static struct tsch_packet *
+remove_packet_of_class(struct tsch_neighbor *n, uint8_t queue_class)
+{
+  /* Get and remove packet from ringbuf (remove committed through an atomic operation */
+  int16_t get_index = ringbufindex_get(class_ringbuf(n, queue_class));
+  if(get_index != -1) {
+    return class_array(n, queue_class)[get_index];
+  } else {
+    return NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Head packet of the highest-priority non-empty class of a neighbor queue */
+static struct tsch_packet *
+peek_packet(const struct tsch_neighbor *n)
+{
+  int16_t get_index = ringbufindex_peek_get(&n->tx_control_ringbuf);
+  if(get_index != -1) {
+    return n->tx_control_array[get_index];
+  }
+  get_index = ringbufindex_peek_get(&n->tx_ringbuf);
+  if(get_index != -1) {
+    return n->tx_array[get_index];
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
 /* Remove first packet from a neighbor queue */
 struct tsch_packet *
 tsch_queue_remove_packet_from_queue(struct tsch_neighbor *n)
 {
   if(!tsch_is_locked()) {
     if(n != NULL) {
-      /* Get and remove packet from ringbuf (remove committed through an atomic operation */
-      int16_t get_index = ringbufindex_get(&n->tx_ringbuf);
-      if(get_index != -1) {
-        return n->tx_array[get_index];
-      } else {
-        return NULL;
+      struct tsch_packet *p = peek_packet(n);
+      if(p != NULL) {
+        return remove_packet_of_class(n, p->queue_class);
       }
     }
   }
   return NULL;
 }
+#if TSCH_QUEUE_WITH_DEADLINES
+/*---------------------------------------------------------------------------*/
+/* Has the deadline of a packet passed? */
+static int
+packet_is_stale(const struct tsch_packet *p)
+{
+  return p->has_deadline
+    && (int32_t)TSCH_ASN_DIFF(tsch_current_asn, p->deadline) > 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Remove the head packet of a neighbor queue if its deadline has passed */
+struct tsch_packet *
+tsch_queue_remove_stale_packet(struct tsch_neighbor *n)
+{
+  if(!tsch_is_locked() && n != NULL) {
+    struct tsch_packet *p = peek_packet(n);
+    if(p != NULL && packet_is_stale(p)) {
+      drops++;
+      stale_drops++;
+      return remove_packet_of_class(n, p->queue_class);
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Remove the packets of a class ring whose deadline has passed, wherever they
+ * sit in the ring. Every packet is taken out and the fresh ones put back,
+ * which keeps their order. The stale ones are handed over to
+ * tsch_tx_process_pending as failed transmissions, while there is room in
+ * dequeued_ringbuf. Returns the number of packets removed. To be called with
+ * the lock held, as it both gets from and puts to the ring. */
+static int
+purge_stale_packets_of_class(struct tsch_neighbor *n, uint8_t queue_class)
+{
+  struct ringbufindex *r = class_ringbuf(n, queue_class);
+  struct tsch_packet **array = class_array(n, queue_class);
+  int count = ringbufindex_elements(r);
+  int removed = 0;
+
+  while(count-- > 0) {
+    struct tsch_packet *p = array[ringbufindex_get(r)];
+    if(packet_is_stale(p)
+       && ringbufindex_elements(&dequeued_ringbuf) < ringbufindex_size(&dequeued_ringbuf) - 2) {
+      drops++;
+      stale_drops++;
+      p->ret = MAC_TX_ERR;
+      dequeued_array[ringbufindex_peek_put(&dequeued_ringbuf)] = p;
+      ringbufindex_put(&dequeued_ringbuf);
+      removed++;
+    } else {
+      array[ringbufindex_peek_put(r)] = p;
+      ringbufindex_put(r);
+    }
+  }
+  return removed;
+}
+/*---------------------------------------------------------------------------*/
+/* Remove the packets whose deadline has passed from all neighbor queues */
+int
+tsch_queue_purge_stale_packets(void)
+{
+  int removed = 0;
+  if(tsch_get_lock()) {
+    struct tsch_neighbor *n = list_head(neighbor_list);
+    while(n != NULL) {
+      removed += purge_stale_packets_of_class(n, TSCH_QUEUE_CLASS_CONTROL);
+      removed += purge_stale_packets_of_class(n, TSCH_QUEUE_CLASS_DATA);
+      n = list_item_next(n);
+    }
+    tsch_release_lock();
+  }
+  if(removed > 0) {
+    LOG_INFO("purged %d stale packets\n", removed);
+    process_poll(&tsch_pending_events_process);
+  }
+  return removed;
+}
+#endif /* TSCH_QUEUE_WITH_DEADLINES */
 /*---------------------------------------------------------------------------*/
 /* Free a packet */
 void
@@ -358,8 +597,9 @@ tsch_queue_packet_sent(struct tsch_neighbor *n, struct tsch_packet *p,
   int is_unicast = !n->is_broadcast;
 
   if(mac_tx_status == MAC_TX_OK) {
-    /* Successful transmission */
-    tsch_queue_remove_packet_from_queue(n);
+    /* Successful transmission. Remove from the packet's own class: a
+     * control packet may have been queued ahead of it during the slot */
+    remove_packet_of_class(n, p->queue_class);
     in_queue = 0;
 
     /* Update CSMA state in the unicast case */
@@ -375,8 +615,11 @@ tsch_queue_packet_sent(struct tsch_neighbor *n, struct tsch_packet *p,
     if(p->transmissions >= p->max_transmissions) {
       /* Drop packet */
       drops=drops+1;
+      if(p->queue_class == TSCH_QUEUE_CLASS_CONTROL) {
+        control_drops++;
+      }
     //  printf("drop1\n");
-      tsch_queue_remove_packet_from_queue(n);
+      remove_packet_of_class(n, p->queue_class);
       in_queue = 0;
     }
     /* Update CSMA state in the unicast case */
@@ -435,7 +678,8 @@ tsch_queue_free_unused_neighbors(void)
 int
 tsch_queue_is_empty(const struct tsch_neighbor *n)
 {
-  return !tsch_is_locked() && n != NULL && ringbufindex_empty(&n->tx_ringbuf);
+  return !tsch_is_locked() && n != NULL && ringbufindex_empty(&n->tx_ringbuf)
+    && ringbufindex_empty(&n->tx_control_ringbuf);
 }
 /*---------------------------------------------------------------------------*/
 /* Returns the first packet from a neighbor queue */
@@ -445,13 +689,14 @@ tsch_queue_get_packet_for_nbr(const struct tsch_neighbor *n, struct tsch_link *l
   if(!tsch_is_locked()) {
     int is_shared_link = link != NULL && link->link_options & LINK_OPTION_SHARED;
     if(n != NULL) {
-      int16_t get_index = ringbufindex_peek_get(&n->tx_ringbuf);
-      if(get_index != -1 &&
+      /* Control packets are served first */
+      struct tsch_packet *p = peek_packet(n);
+      if(p != NULL &&
           !(is_shared_link && !tsch_queue_backoff_expired(n))) {    /* If this is a shared link,
                                                                     make sure the backoff has expired */
 #if TSCH_WITH_LINK_SELECTOR
-        int packet_attr_slotframe = queuebuf_attr(n->tx_array[get_index]->qb, PACKETBUF_ATTR_TSCH_SLOTFRAME);
-        int packet_attr_timeslot = queuebuf_attr(n->tx_array[get_index]->qb, PACKETBUF_ATTR_TSCH_TIMESLOT);
+        int packet_attr_slotframe = queuebuf_attr(p->qb, PACKETBUF_ATTR_TSCH_SLOTFRAME);
+        int packet_attr_timeslot = queuebuf_attr(p->qb, PACKETBUF_ATTR_TSCH_TIMESLOT);
         if(packet_attr_slotframe != 0xffff && packet_attr_slotframe != link->slotframe_handle) {
           return NULL;
         }
@@ -459,7 +704,7 @@ tsch_queue_get_packet_for_nbr(const struct tsch_neighbor *n, struct tsch_link *l
           return NULL;
         }
 #endif
-        return n->tx_array[get_index];
+        return p;
       }
     }
   }
@@ -554,6 +799,7 @@ void
 tsch_queue_init(void)
 {
   list_init(neighbor_list);
+  memset(nbr_hash, 0, sizeof(nbr_hash));
   memb_init(&neighbor_memb);
   memb_init(&packet_memb);
   drops=0;
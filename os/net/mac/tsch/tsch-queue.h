@@ -61,12 +61,22 @@ extern struct tsch_neighbor *n_eb;
  */
 struct tsch_neighbor *tsch_queue_add_nbr(const linkaddr_t *addr);
 extern int drops;
+/* Of drops, how many were control packets, and how many data past their deadline */
+extern int control_drops;
+extern int stale_drops;
 /**
  * \brief Get a TSCH neighbor
  * \param addr The link-layer address of the neighbor we are looking for
  * \return A pointer to the neighbor queue, NULL if not found
  */
 struct tsch_neighbor *tsch_queue_get_nbr(const linkaddr_t *addr);
+/**
+ * \brief Get the TSCH neighbor queue a link transmits to, looked up once
+ * and then cached in the link
+ * \param link The link
+ * \return The neighbor queue of the link's address, NULL if none
+ */
+struct tsch_neighbor *tsch_queue_get_nbr_for_link(struct tsch_link *link);
 /**
  * \brief Get the TSCH time source (we currently assume there is only one)
  * \return The neighbor queue associated to the time source
@@ -98,6 +108,12 @@ int tsch_queue_global_packet_count(void);
  * \return The number of packets in the neighbor's queue
  */
 int tsch_queue_packet_count(const linkaddr_t *addr);
+/**
+ * \brief Returns the number of packets in a neighbor queue, all classes included
+ * \param n The neighbor queue
+ * \return The number of packets in the neighbor's queue
+ */
+int tsch_queue_nbr_packet_count(const struct tsch_neighbor *n);
 /**
  * \brief Remove first packet from a neighbor queue. The packet is stored in a separate
  * dequeued packet list, for later processing.
@@ -105,6 +121,21 @@ int tsch_queue_packet_count(const linkaddr_t *addr);
  * \return The packet that was removed if any, NULL otherwise
  */
 struct tsch_packet *tsch_queue_remove_packet_from_queue(struct tsch_neighbor *n);
+#if TSCH_QUEUE_WITH_DEADLINES
+/**
+ * \brief Remove the head packet from a neighbor queue if its deadline has passed
+ * \param n The neighbor queue
+ * \return The packet if it was removed, else NULL
+ */
+struct tsch_packet *tsch_queue_remove_stale_packet(struct tsch_neighbor *n);
+/**
+ * \brief Remove the packets whose deadline has passed from all neighbor queues,
+ * not only from their head. Their packet_sent callback is called from
+ * tsch_pending_events_process, with MAC_TX_ERR. Takes the lock.
+ * \return The number of packets removed
+ */
+int tsch_queue_purge_stale_packets(void);
+#endif /* TSCH_QUEUE_WITH_DEADLINES */
 /**
  * \brief Free a packet
  * \param p The packet to be freed
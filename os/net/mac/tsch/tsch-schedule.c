@@ -61,13 +61,411 @@
 #define LOG_MODULE "TSCH Sched"
 #define LOG_LEVEL LOG_LEVEL_MAC
 
-/* Pre-allocated space for links */
-MEMB(link_memb, struct tsch_link, TSCH_SCHEDULE_MAX_LINKS);
+/* Sanity checks on the GT-TSCH slotframe geometry. The Rx/Tx pairs can
+ * step over one advertising cell, not two in a row, and the shared
+ * slotframe needs room for the shared cell next to its advertising cells. */
+#if TSCH_SCHEDULE_GT_ADV_STRIDE < 2
+#error TSCH_SCHEDULE_GT_ADV_STRIDE must be at least 2
+#endif
+#if TSCH_SCHEDULE_GT_SHARED_LENGTH < 2
+#error TSCH_SCHEDULE_GT_SHARED_LENGTH must be at least 2
+#endif
+#if TSCH_SCHEDULE_GT_CONTROL_LENGTH < 1 || TSCH_SCHEDULE_GT_DATA_LENGTH < 1
+#error GT-TSCH slotframe lengths must be at least 1
+#endif
+#if !TSCH_SCHEDULE_GT_MULTI_SLOTFRAME && TSCH_SCHEDULE_GT_DATA_LENGTH != TSCH_SCHEDULE_GT_SHARED_LENGTH
+#error GT-TSCH with a single slotframe needs equal shared and data lengths
+#endif
+/* With separate slotframes, a cell shadows the timeslots of another
+ * slotframe equal to it modulo the gcd of their lengths. With coprime
+ * lengths, that is all of them: require each length to divide the longer
+ * ones, so that only the timeslots aligned with other cells are lost. */
+#define GT_LENGTHS_NEST(a, b) ((a) % (b) == 0 || (b) % (a) == 0)
+#if TSCH_SCHEDULE_GT_MULTI_SLOTFRAME \
+    && !(GT_LENGTHS_NEST(TSCH_SCHEDULE_GT_SHARED_LENGTH, TSCH_SCHEDULE_GT_CONTROL_LENGTH) \
+         && GT_LENGTHS_NEST(TSCH_SCHEDULE_GT_SHARED_LENGTH, TSCH_SCHEDULE_GT_DATA_LENGTH) \
+         && GT_LENGTHS_NEST(TSCH_SCHEDULE_GT_CONTROL_LENGTH, TSCH_SCHEDULE_GT_DATA_LENGTH))
+#error GT-TSCH slotframe lengths must divide one another
+#endif
+
+const struct tsch_gt_config tsch_gt_config = {
+  TSCH_SCHEDULE_GT_SHARED_LENGTH,
+  TSCH_SCHEDULE_GT_CONTROL_LENGTH,
+  TSCH_SCHEDULE_GT_DATA_LENGTH,
+  TSCH_SCHEDULE_GT_ADV_STRIDE,
+  (TSCH_SCHEDULE_GT_SHARED_LENGTH + TSCH_SCHEDULE_GT_ADV_STRIDE - 1) / TSCH_SCHEDULE_GT_ADV_STRIDE,
+};
+
+/* Pre-allocated space for links: TSCH_SCHEDULE_MAX_LINKS in the schedule,
+ * plus TSCH_SCHEDULE_MAX_RETIRED_LINKS removed ones that slot operation may
+ * still hold (see schedule_reclaim). Removing more links than that and
+ * adding as many back before the next slot boundary finds the pool short:
+ * the add fails, and succeeds again once slot operation has moved on. */
+MEMB(link_memb, struct tsch_link, TSCH_SCHEDULE_MAX_LINKS + TSCH_SCHEDULE_MAX_RETIRED_LINKS);
+/* Number of links in the schedule, retired ones left out */
+static uint16_t installed_links;
 /* Pre-allocated space for slotframes */
 MEMB(slotframe_memb, struct tsch_slotframe, TSCH_SCHEDULE_MAX_SLOTFRAMES);
 /* List of slotframes (each slotframe holds its own list of links) */
 LIST(slotframe_list);
 
+/* Compiled view of the schedule, the only part of it slot operation reads:
+ * the links of each slotframe sorted by timeslot. Double-buffered so that
+ * link changes need no TSCH lock. Writers, in process context, build the
+ * view slot operation is not using and publish it with a single pointer
+ * store; tsch_schedule_get_next_active_link adopts it at the next slot
+ * boundary. Removed links are retired, and freed only once slot operation
+ * can no longer hold them: views are numbered by generation, and a link
+ * retired while generation G was the last one built is freed once slot
+ * operation adopted generation G + 1 or later, and is not running it. */
+struct schedule_view_sf {
+  struct tsch_slotframe *sf;
+  uint16_t offset; /* First link of the slotframe in links */
+  uint16_t count; /* Number of links of the slotframe */
+  uint16_t cursor; /* Next link to come, maintained by slot operation */
+};
+struct schedule_view {
+  struct tsch_link *links[TSCH_SCHEDULE_MAX_LINKS];
+  struct schedule_view_sf sfs[TSCH_SCHEDULE_MAX_SLOTFRAMES];
+  uint8_t sf_count;
+  uint16_t generation;
+};
+static struct schedule_view schedule_views[2];
+/* Generation of the last view built */
+static uint16_t built_generation;
+/* Generation of active_view. Only changed along with active_view */
+static volatile uint16_t adopted_generation;
+/* The view slot operation runs on. Only changed by the adopting reader,
+ * or by writers while slot operation is stopped */
+static struct schedule_view *volatile active_view = &schedule_views[0];
+/* A view published since, not adopted yet. NULL if none */
+static struct schedule_view *volatile published_view;
+/* Links removed from the schedule, not freed yet */
+LIST(retired_links);
+/* Depth of the batches in progress. The view is published once, when the
+ * outermost batch ends, instead of after every link */
+static uint8_t schedule_batch_depth;
+
+/* Is the slotframe short enough to be covered by its timeslot index? */
+#define SLOTFRAME_IS_INDEXED(sf) ((sf)->size.val <= TSCH_SCHEDULE_INDEX_MAX_LENGTH)
+
+/*---------------------------------------------------------------------------*/
+/* Records a link in the timeslot index of its slotframe */
+static void
+index_add_link(struct tsch_slotframe *slotframe, struct tsch_link *l)
+{
+  if(SLOTFRAME_IS_INDEXED(slotframe)) {
+    slotframe->timeslot_links[l->timeslot] = l;
+    slotframe->occupied[l->timeslot / 32] |= (uint32_t)1 << (l->timeslot % 32);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Clears a link from the timeslot index of its slotframe */
+static void
+index_remove_link(struct tsch_slotframe *slotframe, struct tsch_link *l)
+{
+  if(SLOTFRAME_IS_INDEXED(slotframe)
+     && slotframe->timeslot_links[l->timeslot] == l) {
+    slotframe->timeslot_links[l->timeslot] = NULL;
+    slotframe->occupied[l->timeslot / 32] &= ~((uint32_t)1 << (l->timeslot % 32));
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the index of the least significant bit set in a non-zero word */
+static uint8_t
+first_bit_set(uint32_t word)
+{
+#ifdef __GNUC__
+  return __builtin_ctzl((unsigned long)word);
+#else
+  uint8_t i = 0;
+  while(!(word & 1)) {
+    word >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+/* Builds a view of the schedule: for each slotframe, its links sorted by
+ * timeslot. Links sharing a timeslot keep their list order. */
+static void
+schedule_view_build(struct schedule_view *v)
+{
+  uint16_t count = 0;
+  struct tsch_slotframe *sf = list_head(slotframe_list);
+  v->sf_count = 0;
+  while(sf != NULL) {
+    struct schedule_view_sf *vsf = &v->sfs[v->sf_count++];
+    vsf->sf = sf;
+    vsf->offset = count;
+    if(SLOTFRAME_IS_INDEXED(sf)) {
+      /* The occupancy bitmap already lists the links in timeslot order */
+      uint16_t w;
+      for(w = 0; w < TSCH_SCHEDULE_INDEX_WORDS; w++) {
+        uint32_t bits = sf->occupied[w];
+        while(bits != 0) {
+          v->links[count++] = sf->timeslot_links[w * 32 + first_bit_set(bits)];
+          bits &= bits - 1;
+        }
+      }
+    } else {
+      /* Insertion sort; stable, and run only after a schedule change */
+      struct tsch_link *l = list_head(sf->links_list);
+      while(l != NULL) {
+        uint16_t i = count;
+        while(i > vsf->offset && v->links[i - 1]->timeslot > l->timeslot) {
+          v->links[i] = v->links[i - 1];
+          i--;
+        }
+        v->links[i] = l;
+        count++;
+        l = list_item_next(l);
+      }
+    }
+    vsf->count = count - vsf->offset;
+    vsf->cursor = 0;
+    sf = list_item_next(sf);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Frees the retired links slot operation is done with: those left out of
+ * the view it adopted, except the links it is about to run or running */
+static void
+schedule_reclaim(void)
+{
+  struct tsch_link *l;
+  struct tsch_link *next;
+  uint16_t adopted;
+  if(schedule_batch_depth > 0) {
+    /* Links retired in the batch are still in the view slot operation runs
+     * on, as the view without them is only published when the batch ends */
+    return;
+  }
+  adopted = adopted_generation;
+  for(l = list_head(retired_links); l != NULL; l = next) {
+    next = list_item_next(l);
+    if((int16_t)(adopted - l->retired_generation) >= 0
+       && l != current_link && l != backup_link) {
+      list_remove(retired_links, l);
+      memb_free(&link_memb, l);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Publishes the schedule to slot operation. Call from process context
+ * after every schedule change. Slot operation interrupts us but never the
+ * other way around, so single pointer stores are enough. */
+static void
+schedule_publish(void)
+{
+  struct schedule_view *back;
+  if(schedule_batch_depth > 0) {
+    return;
+  }
+  /* Withdraw any view not adopted yet: from here on, slot operation keeps
+   * running on active_view, and the other buffer is ours */
+  published_view = NULL;
+  back = active_view == &schedule_views[0] ? &schedule_views[1] : &schedule_views[0];
+  schedule_view_build(back);
+  back->generation = ++built_generation;
+  if(tsch_is_associated) {
+    published_view = back;
+  } else {
+    /* No slot operation running, nothing to wait for */
+    active_view = back;
+    adopted_generation = back->generation;
+  }
+  schedule_reclaim();
+}
+/*---------------------------------------------------------------------------*/
+/* Takes a link out of the schedule. It stays allocated, as slot operation
+ * may still run it from its current view, until schedule_reclaim frees it */
+static void
+schedule_retire_link(struct tsch_slotframe *slotframe, struct tsch_link *l)
+{
+  TSCH_TRACE_LINK(tsch_trace_remove_link, l);
+  index_remove_link(slotframe, l);
+  list_remove(slotframe->links_list, l);
+  l->retired_generation = built_generation + 1;
+  list_add(retired_links, l);
+  installed_links--;
+  schedule_publish();
+}
+#if TSCH_SCHEDULE_GT_MULTI_SLOTFRAME
+/*---------------------------------------------------------------------------*/
+static uint16_t
+gcd(uint16_t a, uint16_t b)
+{
+  while(b != 0) {
+    uint16_t r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+/*---------------------------------------------------------------------------*/
+/* GT-TSCH: does a link of another slotframe shadow the timeslot? Timeslot t
+ * of a slotframe of length a and timeslot s of one of length b meet at some
+ * ASN iff t and s are equal modulo gcd(a, b). Slot operation then runs one
+ * of the two links only, so no cell is allocated at such timeslots. */
+static int
+dtsf_is_shadowed_timeslot(struct tsch_slotframe *slotframe, uint16_t timeslot)
+{
+  struct tsch_slotframe *sf;
+  struct tsch_link *l;
+  for(sf = list_head(slotframe_list); sf != NULL; sf = list_item_next(sf)) {
+    if(sf != slotframe) {
+      uint16_t g = gcd(slotframe->size.val, sf->size.val);
+      for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+        if(l->timeslot % g == timeslot % g) {
+          return 1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+#else /* TSCH_SCHEDULE_GT_MULTI_SLOTFRAME */
+#define dtsf_is_shadowed_timeslot(slotframe, timeslot) 0
+#endif /* TSCH_SCHEDULE_GT_MULTI_SLOTFRAME */
+/*---------------------------------------------------------------------------*/
+/* GT-TSCH: does the timeslot hold an advertising cell? The pipelined
+ * Rx/Tx pairs have to step over those. Where advertising cells live in their
+ * own slotframe, the timeslots of the data slotframe they shadow are
+ * stepped over the same way. */
+static int
+dtsf_is_adv_timeslot(struct tsch_slotframe *slotframe, uint16_t timeslot)
+{
+  struct tsch_link *l = tsch_schedule_get_link_by_just_timeslot(slotframe, timeslot);
+  return (l != NULL && l->link_type == LINK_TYPE_ADVERTISING)
+         || dtsf_is_shadowed_timeslot(slotframe, timeslot);
+}
+/*---------------------------------------------------------------------------*/
+/* GT-TSCH: tsch_schedule_find_free_timeslot, shadowed timeslots skipped */
+static int
+dtsf_find_free_timeslot(struct tsch_slotframe *slotframe, uint16_t timeslot)
+{
+  int free_timeslot = tsch_schedule_find_free_timeslot(slotframe, timeslot);
+  while(free_timeslot >= 0 && dtsf_is_shadowed_timeslot(slotframe, free_timeslot)) {
+    free_timeslot = tsch_schedule_find_free_timeslot(slotframe, free_timeslot + 1);
+  }
+  return free_timeslot;
+}
+/*---------------------------------------------------------------------------*/
+/* GT-TSCH timeslot masks over an indexed slotframe, bit n for timeslot n.
+ * They let the cell searches test a whole word of timeslots at a time
+ * instead of looking up links one timeslot after the other. */
+typedef uint32_t dtsf_mask_t[TSCH_SCHEDULE_INDEX_WORDS];
+
+/* Link filter used to build masks */
+struct dtsf_link_match {
+  const linkaddr_t *addr;
+  uint16_t channel_offset;
+};
+/*---------------------------------------------------------------------------*/
+/* Sets the timeslots of the links for which filter returns true */
+static void
+dtsf_mask_links(struct tsch_slotframe *slotframe, dtsf_mask_t mask,
+                int (*filter)(const struct tsch_link *, const struct dtsf_link_match *),
+                const struct dtsf_link_match *match)
+{
+  struct tsch_link *l;
+  memset(mask, 0, sizeof(dtsf_mask_t));
+  for(l = list_head(slotframe->links_list); l != NULL; l = list_item_next(l)) {
+    if(filter(l, match)) {
+      mask[l->timeslot / 32] |= (uint32_t)1 << (l->timeslot % 32);
+    }
+  }
+}
+#if TSCH_SCHEDULE_GT_MULTI_SLOTFRAME
+/*---------------------------------------------------------------------------*/
+/* Sets the timeslots shadowed by the links of other slotframes, as tested
+ * by dtsf_is_shadowed_timeslot */
+static void
+dtsf_mask_shadowed(struct tsch_slotframe *slotframe, dtsf_mask_t mask)
+{
+  struct tsch_slotframe *sf;
+  struct tsch_link *l;
+  uint16_t t;
+  memset(mask, 0, sizeof(dtsf_mask_t));
+  for(sf = list_head(slotframe_list); sf != NULL; sf = list_item_next(sf)) {
+    if(sf != slotframe) {
+      uint16_t g = gcd(slotframe->size.val, sf->size.val);
+      for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+        for(t = l->timeslot % g; t < slotframe->size.val; t += g) {
+          mask[t / 32] |= (uint32_t)1 << (t % 32);
+        }
+      }
+    }
+  }
+}
+#endif /* TSCH_SCHEDULE_GT_MULTI_SLOTFRAME */
+/*---------------------------------------------------------------------------*/
+/* Shifts a mask by 1 or 2 timeslots: dst bit n is src bit n + shift */
+static void
+dtsf_mask_shift(dtsf_mask_t dst, const dtsf_mask_t src, int shift)
+{
+  int w;
+  for(w = 0; w < TSCH_SCHEDULE_INDEX_WORDS; w++) {
+    if(shift > 0) {
+      dst[w] = src[w] >> shift;
+      if(w + 1 < TSCH_SCHEDULE_INDEX_WORDS) {
+        dst[w] |= src[w + 1] << (32 - shift);
+      }
+    } else {
+      dst[w] = src[w] << -shift;
+      if(w > 0) {
+        dst[w] |= src[w - 1] >> (32 + shift);
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the first timeslot set in a mask at or after a given one, and
+ * before limit, -1 if none */
+static int
+dtsf_mask_next(const dtsf_mask_t mask, uint16_t timeslot, uint16_t limit)
+{
+  uint16_t w;
+  for(w = timeslot / 32; w < TSCH_SCHEDULE_INDEX_WORDS && w * 32 < limit; w++) {
+    uint32_t bits = mask[w];
+    if(w == timeslot / 32) {
+      bits &= ~(uint32_t)0 << (timeslot % 32);
+    }
+    if(bits != 0) {
+      uint16_t found = w * 32 + first_bit_set(bits);
+      return found < limit ? found : -1;
+    }
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+dtsf_link_is_adv(const struct tsch_link *l, const struct dtsf_link_match *match)
+{
+  return l->link_type == LINK_TYPE_ADVERTISING;
+}
+/*---------------------------------------------------------------------------*/
+/* Any link to the given neighbor on the given channel offset */
+static int
+dtsf_link_is_to(const struct tsch_link *l, const struct dtsf_link_match *match)
+{
+  return l->channel_offset == match->channel_offset
+         && linkaddr_cmp(&l->addr, match->addr);
+}
+/*---------------------------------------------------------------------------*/
+/* A dedicated uplink to the given neighbor not yet paired with an Rx cell,
+ * as tested by dtsf_check_TX_timeslot */
+static int
+dtsf_link_is_spare_tx(const struct tsch_link *l, const struct dtsf_link_match *match)
+{
+  return l->link_type == LINK_TYPE_NORMAL
+         && l->link_options == LINK_OPTION_TX
+         && l->reserved != 1
+         && dtsf_link_is_to(l, match);
+}
+/*---------------------------------------------------------------------------*/
 /* Adds and returns a slotframe (NULL if failure) */
 struct tsch_slotframe *
 tsch_schedule_add_slotframe(uint16_t handle, uint16_t size)
@@ -89,13 +487,16 @@ tsch_schedule_add_slotframe(uint16_t handle, uint16_t size)
       sf->handle = handle;
       TSCH_ASN_DIVISOR_INIT(sf->size, size);
       LIST_STRUCT_INIT(sf, links_list);
+      memset(sf->occupied, 0, sizeof(sf->occupied));
+      memset(sf->timeslot_links, 0, sizeof(sf->timeslot_links));
       /* Add the slotframe to the global list */
       list_add(slotframe_list, sf);
+      schedule_publish();
     }
-    LOG_INFO("add_slotframe %u %u\n",
-           handle, size);
     tsch_release_lock();
- // printf("omid: add a slotframe\n");
+    if(sf != NULL) {
+      TSCH_TRACE_SLOTFRAME(tsch_trace_add_slotframe, sf);
+    }
     return sf;
   }
   return NULL;
@@ -127,10 +528,11 @@ tsch_schedule_remove_slotframe(struct tsch_slotframe *slotframe)
 
     /* Now that the slotframe has no links, remove it. */
     if(tsch_get_lock()) {
-      LOG_INFO("remove slotframe %u %u\n", slotframe->handle, slotframe->size.val);
-      memb_free(&slotframe_memb, slotframe);
+      TSCH_TRACE_SLOTFRAME(tsch_trace_remove_slotframe, slotframe);
       list_remove(slotframe_list, slotframe);
-      printf("omid: remove a slotframe\n");
+      /* Slot operation adopts the new view before reading any slotframe */
+      schedule_publish();
+      memb_free(&slotframe_memb, slotframe);
       tsch_release_lock();
       return 1;
     }
@@ -175,8 +577,8 @@ tsch_schedule_get_link_by_handle(uint16_t handle)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
-static const char *
-print_link_options(uint16_t link_options)
+const char *
+tsch_schedule_print_link_options(uint16_t link_options)
 {
   static char buffer[20];
   unsigned length;
@@ -199,8 +601,8 @@ print_link_options(uint16_t link_options)
   return buffer;
 }
 /*---------------------------------------------------------------------------*/
-static const char *
-print_link_type(uint16_t link_type)
+const char *
+tsch_schedule_print_link_type(uint16_t link_type)
 {
   switch(link_type) {
   case LINK_TYPE_NORMAL:
@@ -227,17 +629,12 @@ int dtsf_check_TX_timeslot(struct tsch_slotframe *slotframe, uint16_t timeslot_o
     }
       
      // const linkaddr_t* test=rpl_neighbor_get_lladdr(curr_instance.dag.preferred_parent);
-        struct tsch_neighbor* time_source= tsch_queue_get_time_source();
-        const linkaddr_t* test= &time_source->addr;
+        struct tsch_neighbor* ts= tsch_queue_get_time_source();
 
-      
-      
-  //assert(test != NULL);
-  if(test==NULL)
+  if(ts==NULL)
   {
       return 0;
   }
-  struct tsch_neighbor *ts = tsch_queue_get_nbr(test);
     if(link->link_type!=LINK_TYPE_NORMAL  ||  link->link_options!=LINK_OPTION_TX || linkaddr_cmp(&link->addr,&ts->addr)==0 ||  link->reserved==1 )
     {
         if(link->link_type!=LINK_TYPE_NORMAL)
@@ -297,58 +694,100 @@ int dtsf_check_RX_timeslot(struct tsch_slotframe *slotframe, uint16_t timeslot_o
 }
 
 
+/*---------------------------------------------------------------------------*/
+int
+dtsf_chain_next_tx(struct tsch_slotframe *slotframe, uint16_t timeslot)
+{
+  if(dtsf_check_TX_timeslot(slotframe, timeslot + 1, parent_channel) == 1) {
+    return timeslot + 1;
+  }
+  if(dtsf_is_adv_timeslot(slotframe, timeslot + 1)
+     && dtsf_check_TX_timeslot(slotframe, timeslot + 2, parent_channel) == 1) {
+    return timeslot + 2;
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+int
+dtsf_chain_prev_rx(struct tsch_slotframe *slotframe, uint16_t timeslot, uint16_t channel_offset)
+{
+  if(timeslot >= 1 && dtsf_check_RX_timeslot(slotframe, timeslot - 1, channel_offset) == 1) {
+    return timeslot - 1;
+  }
+  if(timeslot >= 2 && dtsf_is_adv_timeslot(slotframe, timeslot - 1)
+     && dtsf_check_RX_timeslot(slotframe, timeslot - 2, channel_offset) == 1) {
+    return timeslot - 2;
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+/* Offers an uplink cell to a child. In pipeline mode the cell is held in
+ * the ledger until the child confirms it, so that no other search hands
+ * out the same cell, and with it the same uplink to our parent.
+ * Returns 1 if offered, 0 if already offered to someone, -1 if the ledger
+ * has no room left to hold it */
+static int
+dtsf_offer_uplink_cell(uint16_t timeslot, uint16_t channel_offset, const linkaddr_t *peer_addr)
+{
+#if TSCH_SCHEDULE_GT_PIPELINE
+  if(tsch_ledger_is_pending(timeslot, channel_offset)) {
+    return 0;
+  }
+  return tsch_ledger_add_pending(peer_addr, timeslot, channel_offset) ? 1 : -1;
+#else
+  return 1;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+/* Validates a new link before it is added. Returns 1 if valid, 0 otherwise */
+static int
+add_link_is_valid(struct tsch_slotframe *slotframe, uint8_t link_options,
+                  enum link_type link_type, uint16_t timeslot)
+{
+  /* Validation of specified timeslot */
+  if(timeslot > (slotframe->size.val - 1)) {
+    LOG_ERR("! add_link invalid timeslot: %u\n", timeslot);
+    return 0;
+  }
+  /* We currently support only one link per timeslot in a given slotframe. */
+  if(tsch_schedule_get_link_by_just_timeslot(slotframe, timeslot) != NULL) {
+    LOG_ERR("! add_link ts=%u already in use\n", timeslot);
+    return 0;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 struct tsch_link *
 tsch_schedule_add_link(struct tsch_slotframe *slotframe,
                        uint8_t link_options, enum link_type link_type, const linkaddr_t *address,
                        uint16_t timeslot, uint16_t channel_offset)
 	{
-					// printf("test13\n");
 				  struct tsch_link *l = NULL;
 				  if(slotframe != NULL)
 					{
-						 // printf("test3\n");
-
-					/* We currently support only one link per timeslot in a given slotframe. */
-
-					/* Validation of specified timeslot and channel_offset */
-								if(timeslot > (slotframe->size.val - 1)) 
+								if(!add_link_is_valid(slotframe, link_options, link_type, timeslot))
 								{
-												printf("! add_link invalid timeslot: %u\n", timeslot);
-												// printf("test22\n");
 												return NULL;
 								}
-    
-								if( tsch_schedule_get_link_by_just_timeslot(slotframe, timeslot) != NULL )
-								{
-											printf("ERRORRRRRRRRRRRRRRRRRRRR   %d\n",timeslot);
-											return NULL;
-								}
-							  //  printf("test2\n");
 
 								/* Start with removing the link currently installed at this timeslot (needed
 								 * to keep neighbor state in sync with link options etc.) */
 							tsch_schedule_remove_link_by_timeslot(slotframe, timeslot, channel_offset);
-							if(!tsch_get_lock())
-							{
-										printf("! add_link memb_alloc couldn't take lock\n");
-							} 
-							else 
-							{
-                              //  	printf("test111\n");
-                                	//printf("test111\n");
-										l = memb_alloc(&link_memb);
+							/* No TSCH lock needed: slot operation only sees the link once the
+							 * view holding it is published */
+							schedule_reclaim();
+										l = installed_links < TSCH_SCHEDULE_MAX_LINKS ? memb_alloc(&link_memb) : NULL;
 										if(l == NULL) 
 										{
-													printf("! add_link memb_alloc failed\n");
-													tsch_release_lock();
+													LOG_ERR("! add_link memb_alloc failed\n");
 										} 
 									  else
 									  {
-                                            	//printf("test110\n");
 												static int current_link_handle = 0;
 												struct tsch_neighbor *n;
 											/* Add the link to the slotframe */
 												list_add(slotframe->links_list, l);
+												installed_links++;
 											/* Initialize link */
 												l->handle = current_link_handle++;
 												l->link_options = link_options;
@@ -358,19 +797,17 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
 												l->slotframe_handle = slotframe->handle;
 												l->timeslot = timeslot;
 												l->channel_offset = channel_offset;
+												index_add_link(slotframe, l);
 												l->data = NULL;
+												l->reserved = 0;
+												l->nbr = NULL;
 												if(address == NULL) 
 												{
 														address = &linkaddr_null;
 												}
 												linkaddr_copy(&l->addr, address);
-												printf("add a link : type=%s sf=%u opt=%s  ts=%u ch=%d\n",print_link_type(link_type), slotframe->handle,print_link_options(link_options), timeslot, channel_offset);
-												LOG_INFO("add_link sf=%u opt=%s type=%s ts=%u ch=%u addr=", slotframe->handle,
-												print_link_options(link_options), print_link_type(link_type), timeslot, channel_offset);
-												LOG_INFO_LLADDR(address);
-												LOG_INFO_("\n");
-												/* Release the lock before we update the neighbor (will take the lock) */
-												tsch_release_lock();
+												TSCH_TRACE_LINK(tsch_trace_add_link, l);
+												schedule_publish();
 												//  tsch_schedule_print();
 												if(l->link_options==LINK_OPTION_TX && l->link_type==LINK_TYPE_NORMAL)
 												{
@@ -411,7 +848,7 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
 									
 																if(!tsch_is_coordinator)
 																{
-																			if(dtsf_check_TX_timeslot(slotframe, timeslot+1, parent_channel) == 1)
+																			if(dtsf_chain_next_tx(slotframe, timeslot) >= 0)
 																			{
 																					if( l->reserved==0)
 																					{
@@ -422,22 +859,7 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
 																			}
 																			else
 																			{
-																						if(    ((timeslot+1)%5)==0 &&  dtsf_check_TX_timeslot(slotframe, timeslot+2, parent_channel) == 1)
-																						{
-																								if( l->reserved==0)
-																								{
-																										l->reserved=1;
-																										free_uplink_timeslots= free_uplink_timeslots - 1;
-																								}
-																								
-																								
-																						}
-																						else
-																						{
-																							printf("error in setting the reserved bit  channel=%d   timeslot=%d\n",(int)parent_channel,(int)timeslot+1);
-
-																						}
-																		  // tsch_schedule_print();
+																					LOG_ERR("! no uplink to reserve for Rx cell at timeslot %u\n", timeslot);
 																			}
 											
 																}
@@ -447,6 +869,7 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
 																		l->reserved=1;
 																		free_uplink_timeslots= free_uplink_timeslots - 1;
 																}
+																tsch_ledger_add_granted(address, l->reserved);
 										
 												}
 									
@@ -457,6 +880,7 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
 								   
 														if(n != NULL) 
 														{
+																	l->nbr = n;
 																	n->tx_links_count++;
 																	if(!(l->link_options & LINK_OPTION_SHARED))
 																	 {
@@ -467,7 +891,6 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
 									
 									
 							}
-					}
 			}
   return l;
 }
@@ -479,21 +902,20 @@ tsch_schedule_delete_link(struct tsch_slotframe *slotframe,
                        uint8_t link_options, enum link_type link_type, const linkaddr_t *address,
                        uint16_t timeslot, uint16_t channel_offset)
 {
-   // printf("test1\n");
   struct tsch_link *l = NULL;
   if(slotframe != NULL) 
   {
 
     if(timeslot > (slotframe->size.val - 1)) 
     {
-      printf("! delete_link invalid timeslot: %u\n", timeslot);
+      LOG_ERR("! delete_link invalid timeslot: %u\n", timeslot);
       
       return -1;
     }
 
 
 
-        if(l->link_options==LINK_OPTION_TX && l->link_type==LINK_TYPE_NORMAL)
+        if(link_options==LINK_OPTION_TX && link_type==LINK_TYPE_NORMAL)
         {
                   l=tsch_schedule_get_link_by_timeslot(slotframe, timeslot, channel_offset);
            
@@ -507,7 +929,7 @@ tsch_schedule_delete_link(struct tsch_slotframe *slotframe,
                                    }
                                   else
                                   {
-                                      printf("error in free_uplink_timeslots\n");
+                                      LOG_ERR("! no free uplink cell to account for\n");
                                   }
                                    
                                }
@@ -521,7 +943,7 @@ tsch_schedule_delete_link(struct tsch_slotframe *slotframe,
                    }
                    else
                    {
-                       printf("cannot find uplink for deleting\n");
+                       LOG_ERR("! cannot find uplink for deleting\n");
                    }
         
            
@@ -533,7 +955,7 @@ tsch_schedule_delete_link(struct tsch_slotframe *slotframe,
         
         
 
-        if(l->link_options==LINK_OPTION_RX && l->link_type==LINK_TYPE_NORMAL)
+        if(link_options==LINK_OPTION_RX && link_type==LINK_TYPE_NORMAL)
         {
               struct tsch_neighbor *n = tsch_queue_get_nbr(address);
              if(n != NULL) 
@@ -543,29 +965,25 @@ tsch_schedule_delete_link(struct tsch_slotframe *slotframe,
                         n->rx_links_count = n->rx_links_count -1;
                        // rx_links_count
                         
-                    printf("link count=%d\n", n->rx_links_count);
+                    LOG_DBG("link count=%d\n", n->rx_links_count);
                     }
                     else
                     {
-                        printf("error in decreasing the link count\n");
+                        LOG_ERR("! Rx link count already 0\n");
                     }
                     
              }
         
             if(!tsch_is_coordinator)
             {
-                             l=tsch_schedule_get_link_by_timeslot(slotframe, timeslot+1, parent_channel);
-                             if(l!=NULL)
+                             /* Give back the uplink cell tsch_schedule_add_link
+                              * reserved for this Rx cell, found along the same
+                              * chain, which skips an advertising timeslot */
+                             l=tsch_schedule_get_link_by_timeslot(slotframe, timeslot, channel_offset);
+                             if(l!=NULL && l->reserved==1
+                                && dtsf_chain_next_tx(slotframe, timeslot) >= 0)
                              {
-                                 if( l->reserved==1)
-                                 {
-                                     l->reserved=0;
-                                     
                                         free_uplink_timeslots = free_uplink_timeslots + 1;
-                                        
-                                     
-                                 }
-                                 
                              }
                 
             }
@@ -577,7 +995,6 @@ tsch_schedule_delete_link(struct tsch_slotframe *slotframe,
             if(tsch_is_coordinator)
             {
                 free_uplink_timeslots = free_uplink_timeslots + 1;
-                l->reserved = 0;
             }
           
           
@@ -592,30 +1009,25 @@ tsch_schedule_delete_link(struct tsch_slotframe *slotframe,
     
         
     l=tsch_schedule_get_link_by_just_timeslot(slotframe, timeslot);  
-        
+    if(l == NULL)
+    {
+      return -1;
+    }
 
-    if(tsch_get_lock()) 
     {
-          uint8_t link_options;
           linkaddr_t addr;
+          uint8_t reserved;
 
           /* Save link option and addr in local variables as we need them
            * after freeing the link */
           link_options = l->link_options;
+          link_type = l->link_type;
+          reserved = l->reserved;
           linkaddr_copy(&addr, &l->addr);
 
-          /* The link to be removed is scheduled as next, set it to NULL
-           * to abort the next link operation */
-          if(l == current_link) 
-          {
-            current_link = NULL;
-          }
-
-          list_remove(slotframe->links_list, l);
-          memb_free(&link_memb, l);
-          tsch_release_lock();  
+          schedule_retire_link(slotframe, l);
        
-          if(l->link_options & LINK_OPTION_TX) 
+          if(link_options & LINK_OPTION_TX) 
           {
             struct tsch_neighbor *n = tsch_queue_get_nbr(&addr);
             if(n != NULL) 
@@ -628,13 +1040,13 @@ tsch_schedule_delete_link(struct tsch_slotframe *slotframe,
             }
           }
 
+          if(link_options == LINK_OPTION_RX && link_type == LINK_TYPE_NORMAL)
+          {
+            tsch_ledger_remove_granted(&addr, reserved);
+          }
+
           return 1;
     } 
-    else 
-    {
-      LOG_ERR("! remove_link memb_alloc couldn't take lock\n");
-      return -1;
-    }
     
   }
   return -1;
@@ -645,32 +1057,18 @@ int
 tsch_schedule_remove_link(struct tsch_slotframe *slotframe, struct tsch_link *l)
 {
   if(slotframe != NULL && l != NULL && l->slotframe_handle == slotframe->handle) {
-    if(tsch_get_lock()) {
+    {
       uint8_t link_options;
       linkaddr_t addr;
 
       /* Save link option and addr in local variables as we need them
-       * after freeing the link */
+       * after retiring the link */
       link_options = l->link_options;
       linkaddr_copy(&addr, &l->addr);
 
-      /* The link to be removed is scheduled as next, set it to NULL
-       * to abort the next link operation */
-      if(l == current_link) {
-        current_link = NULL;
-      }
-      LOG_INFO("remove_link sf=%u opt=%s type=%s ts=%u ch=%u addr=",
-               slotframe->handle,
-               print_link_options(l->link_options),
-               print_link_type(l->link_type), l->timeslot, l->channel_offset);
-      LOG_INFO_LLADDR(&l->addr);
-      LOG_INFO_("\n");
-
-      list_remove(slotframe->links_list, l);
-      memb_free(&link_memb, l);
-
-      /* Release the lock before we update the neighbor (will take the lock) */
-      tsch_release_lock();
+      /* If slot operation already picked the link, it runs it one last
+       * time: the change takes effect from the next slot boundary */
+      schedule_retire_link(slotframe, l);
 
       /* This was a tx link to this neighbor, update counters */
       if(link_options & LINK_OPTION_TX) {
@@ -687,13 +1085,110 @@ tsch_schedule_remove_link(struct tsch_slotframe *slotframe, struct tsch_link *l)
       
       
       return 1;
-    } else {
-      LOG_ERR("! remove_link memb_alloc couldn't take lock\n");
     }
   }
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+int
+tsch_schedule_add_links(struct tsch_slotframe *slotframe,
+                        uint8_t link_options, enum link_type link_type, const linkaddr_t *address,
+                        const sf_simple_cell_t *cells, uint16_t count, uint8_t *installed)
+{
+  uint16_t i, j;
+  uint16_t valid = 0;
+
+  if(slotframe == NULL || count > TSCH_SCHEDULE_MAX_LINKS) {
+    return -1;
+  }
+
+  /* Validate the whole list first, the cells of the batch included */
+  for(i = 0; i < count; i++) {
+    uint8_t ok = add_link_is_valid(slotframe, link_options, link_type, cells[i].timeslot_offset);
+    for(j = 0; ok && j < i; j++) {
+      if(cells[j].timeslot_offset == cells[i].timeslot_offset) {
+        LOG_ERR("! add_links ts=%u twice in a batch\n", cells[i].timeslot_offset);
+        ok = 0;
+      }
+    }
+    if(installed != NULL) {
+      /* Until the batch is applied, flags the cells that passed validation */
+      installed[i] = ok;
+    }
+    valid += ok;
+  }
+  if(valid < count) {
+    return -1;
+  }
+
+  /* Reserve the links up front: all or nothing */
+  schedule_reclaim();
+  if(installed_links + count > TSCH_SCHEDULE_MAX_LINKS
+     || memb_numfree(&link_memb) < count) {
+    if(installed_links + count > TSCH_SCHEDULE_MAX_LINKS) {
+      LOG_ERR("! add_links %u links, only %u free\n", count,
+              TSCH_SCHEDULE_MAX_LINKS - installed_links);
+    } else {
+      LOG_ERR("! add_links %u links, %u removed links not freed yet\n", count,
+              list_length(retired_links));
+    }
+    if(installed != NULL) {
+      memset(installed, 0, count);
+    }
+    return -1;
+  }
+
+  schedule_batch_depth++;
+  for(i = 0; i < count; i++) {
+    if(tsch_schedule_add_link(slotframe, link_options, link_type, address,
+                              cells[i].timeslot_offset, cells[i].channel_offset) == NULL) {
+      /* Cannot happen: validated, and the memory is there */
+      LOG_ERR("! add_links ts=%u failed after validation\n", cells[i].timeslot_offset);
+      if(installed != NULL) {
+        installed[i] = 0;
+      }
+      valid--;
+    }
+  }
+  schedule_batch_depth--;
+  schedule_publish();
+
+  return valid;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_schedule_delete_links(struct tsch_slotframe *slotframe,
+                           uint8_t link_options, enum link_type link_type, const linkaddr_t *address,
+                           const sf_simple_cell_t *cells, uint16_t count, uint8_t *deleted)
+{
+  uint16_t i;
+  int done = 0;
+
+  if(slotframe == NULL) {
+    return -1;
+  }
+
+  schedule_batch_depth++;
+  for(i = 0; i < count; i++) {
+    struct tsch_link *l = tsch_schedule_get_link_by_timeslot(slotframe,
+        cells[i].timeslot_offset, cells[i].channel_offset);
+    uint8_t ok = 0;
+    /* Only delete what is installed, for that neighbor */
+    if(l != NULL && linkaddr_cmp(&l->addr, address)) {
+      ok = tsch_schedule_delete_link(slotframe, link_options, link_type, address,
+                                     cells[i].timeslot_offset, cells[i].channel_offset) == 1;
+    }
+    if(deleted != NULL) {
+      deleted[i] = ok;
+    }
+    done += ok;
+  }
+  schedule_batch_depth--;
+  schedule_publish();
+
+  return done;
+}
+/*---------------------------------------------------------------------------*/
 /* Removes a link from slotframe and timeslot. Return a 1 if success, 0 if failure */
 int
 tsch_schedule_remove_link_by_timeslot(struct tsch_slotframe *slotframe,
@@ -716,7 +1211,11 @@ tsch_schedule_get_link_by_just_timeslot(struct tsch_slotframe *slotframe,
    
   if(!tsch_is_locked()) {
     if(slotframe != NULL) {
-      struct tsch_link *l = list_head(slotframe->links_list);
+      struct tsch_link *l;
+      if(SLOTFRAME_IS_INDEXED(slotframe)) {
+        return timeslot < slotframe->size.val ? slotframe->timeslot_links[timeslot] : NULL;
+      }
+      l = list_head(slotframe->links_list);
       /* Loop over all items. Assume there is max one link per timeslot */
       while(l != NULL) {
         if(l->timeslot == timeslot) {
@@ -730,28 +1229,52 @@ tsch_schedule_get_link_by_just_timeslot(struct tsch_slotframe *slotframe,
   
   return NULL;
 }
+/*---------------------------------------------------------------------------*/
+/* Returns the first timeslot at or after a given one with no link installed,
+ * -1 if there is none */
+int
+tsch_schedule_find_free_timeslot(struct tsch_slotframe *slotframe, uint16_t timeslot)
+{
+  if(slotframe == NULL || timeslot >= slotframe->size.val) {
+    return -1;
+  }
+
+  if(SLOTFRAME_IS_INDEXED(slotframe)) {
+    uint16_t w;
+    /* Skip fully occupied words, 32 timeslots at a time */
+    for(w = timeslot / 32; w < TSCH_SCHEDULE_INDEX_WORDS; w++) {
+      uint32_t free_bits = ~slotframe->occupied[w];
+      if(w == timeslot / 32) {
+        free_bits &= ~(uint32_t)0 << (timeslot % 32);
+      }
+      if(free_bits != 0) {
+        uint16_t free_timeslot = w * 32 + first_bit_set(free_bits);
+        return free_timeslot < slotframe->size.val ? free_timeslot : -1;
+      }
+    }
+    return -1;
+  }
+
+  while(timeslot < slotframe->size.val) {
+    if(tsch_schedule_get_link_by_just_timeslot(slotframe, timeslot) == NULL) {
+      return timeslot;
+    }
+    timeslot++;
+  }
+  return -1;
+}
 
 
 
 int dtsf_find_free_adv_slot(struct tsch_slotframe *slotframe, uint16_t channel_offset)
 {
     //printf("looking for free slot in channel %d\n",channel_offset); 
-    uint16_t time_offset=0;
-    while(time_offset < TSCH_SCHEDULE_DEFAULT_LENGTH)
+    int time_offset = dtsf_find_free_timeslot(slotframe, 0);
+    if(time_offset >= 0 && time_offset < slotframe->size.val)
     {
-        if(tsch_schedule_get_link_by_just_timeslot(slotframe, time_offset) == NULL)
-        {
-             if(tsch_schedule_get_link_by_timeslot(slotframe, time_offset, channel_offset) == NULL)
-                     {
-                       //  printf("find it timeslot=%d channel=%d\n",time_offset,channel_offset);
-                         return time_offset;
-                     }
-            
-        }
-        time_offset++;
-        
+        return time_offset;
     }
-    printf("Error, cannot find free timeslot\n");
+    LOG_ERR("! cannot find free timeslot\n");
     return -1;
     
 }
@@ -790,13 +1313,13 @@ int dtsf_check_consequent_RX_timeslot(struct tsch_slotframe *slotframe, uint16_t
     }
     
     /////GT-TSCH/////////////////////////
-    if(  (timeslot_offset-1)%5  != 0)
+    if(!dtsf_is_adv_timeslot(slotframe, timeslot_offset-1))
     {
         check3=1;
     }
     else
     {
-        if( linkaddr_cmp(&link3->addr,peer_addr)<1)
+        if(link3 == NULL || linkaddr_cmp(&link3->addr,peer_addr)<1)
         {
             check3=1;
         }
@@ -819,15 +1342,18 @@ int dtsf_find_last_uplinks( const linkaddr_t *peer_addr, uint16_t number_of_link
     uint16_t time_offset=0;
     uint16_t allocated=0;
     struct tsch_slotframe *slotframe;
-    slotframe = tsch_schedule_get_slotframe_by_handle(0);
-    time_offset=TSCH_SCHEDULE_CONF_DEFAULT_LENGTH-1;
+    slotframe = tsch_schedule_get_slotframe_by_handle(TSCH_SCHEDULE_GT_DATA_HANDLE);
+    if(slotframe == NULL)
+    {
+        return 0;
+    }
+    time_offset=slotframe->size.val-1;
     uint16_t channel_offset=children_channel;
     while(time_offset > 0 && allocated<number_of_links)
     {
-        if(tsch_schedule_get_link_by_just_timeslot(slotframe, time_offset) != NULL)
+        struct tsch_link* link= tsch_schedule_get_link_by_just_timeslot(slotframe, time_offset); 
+        if(link != NULL)
         {
-            struct tsch_link* link= tsch_schedule_get_link_by_just_timeslot(slotframe, time_offset); 
-            
              if(linkaddr_cmp(&link->addr,peer_addr))
              {
                   
@@ -842,8 +1368,108 @@ int dtsf_find_last_uplinks( const linkaddr_t *peer_addr, uint16_t number_of_link
     return allocated;
 }
 
+/* dtsf_find_free_uplink_slot for indexed slotframes, on timeslot masks */
+static int
+dtsf_find_free_uplink_slot_masked(struct tsch_slotframe *slotframe, uint16_t channel_offset, uint16_t number, sf_simple_cell_t *cell_list, const linkaddr_t *peer_addr)
+{
+  dtsf_mask_t candidates, adv, links, shifted, stepped;
+  struct dtsf_link_match match;
+  uint16_t allocated = 0;
+  uint16_t w;
+  int timeslot;
+
+  /* Free timeslots, timeslot 0 excluded */
+  for(w = 0; w < TSCH_SCHEDULE_INDEX_WORDS; w++) {
+    candidates[w] = ~slotframe->occupied[w];
+  }
+  candidates[0] &= ~(uint32_t)1;
+  dtsf_mask_links(slotframe, adv, dtsf_link_is_adv, NULL);
+#if TSCH_SCHEDULE_GT_MULTI_SLOTFRAME
+  /* Shadowed timeslots are no candidates, and are stepped over as adv
+   * cells are */
+  dtsf_mask_shadowed(slotframe, links);
+  for(w = 0; w < TSCH_SCHEDULE_INDEX_WORDS; w++) {
+    candidates[w] &= ~links[w];
+    adv[w] |= links[w];
+  }
+#endif /* TSCH_SCHEDULE_GT_MULTI_SLOTFRAME */
+
+  if(tsch_is_coordinator) {
+    /* No two Rx cells of the peer back to back, even around an adv cell */
+    match.addr = peer_addr;
+    match.channel_offset = channel_offset;
+    dtsf_mask_links(slotframe, links, dtsf_link_is_to, &match);
+    dtsf_mask_shift(shifted, links, 1);
+    dtsf_mask_shift(stepped, links, -1);
+    for(w = 0; w < TSCH_SCHEDULE_INDEX_WORDS; w++) {
+      candidates[w] &= ~(shifted[w] | stepped[w]);
+    }
+    dtsf_mask_shift(shifted, links, -2);
+    dtsf_mask_shift(stepped, adv, -1);
+    for(w = 0; w < TSCH_SCHEDULE_INDEX_WORDS; w++) {
+      candidates[w] &= ~(shifted[w] & stepped[w]);
+    }
+
+    /* Cells handed out in this call are not installed yet: keep them apart */
+    timeslot = 0;
+    while(allocated < number
+          && (timeslot = dtsf_mask_next(candidates, timeslot, slotframe->size.val)) >= 0) {
+      int offer = dtsf_offer_uplink_cell(timeslot, channel_offset, peer_addr);
+      if(offer < 0) {
+        break;
+      }
+      if(offer > 0) {
+        cell_list[allocated].channel_offset = channel_offset;
+        cell_list[allocated].timeslot_offset = timeslot;
+        allocated++;
+        timeslot++;
+      }
+      timeslot++;
+    }
+  } else {
+    struct tsch_neighbor *time_source = tsch_queue_get_time_source();
+    if(time_source == NULL) {
+      return 0;
+    }
+    /* The Rx cell must feed a spare uplink to the parent right after it,
+     * or two timeslots after it when stepping over an adv cell */
+    match.addr = &time_source->addr;
+    match.channel_offset = parent_channel;
+    dtsf_mask_links(slotframe, links, dtsf_link_is_spare_tx, &match);
+    dtsf_mask_shift(shifted, links, 1);
+    dtsf_mask_shift(stepped, links, 2);
+    dtsf_mask_shift(links, adv, 1);
+    for(w = 0; w < TSCH_SCHEDULE_INDEX_WORDS; w++) {
+      candidates[w] &= shifted[w] | (stepped[w] & links[w]);
+    }
+
+    /* Each uplink is claimed by at most one free timeslot */
+    timeslot = 0;
+    while(allocated < number
+          && (timeslot = dtsf_mask_next(candidates, timeslot, slotframe->size.val)) >= 0) {
+      int offer = dtsf_offer_uplink_cell(timeslot, channel_offset, peer_addr);
+      if(offer < 0) {
+        break;
+      }
+      if(offer > 0) {
+        cell_list[allocated].channel_offset = channel_offset;
+        cell_list[allocated].timeslot_offset = timeslot;
+        allocated++;
+      }
+      timeslot++;
+    }
+  }
+
+  return allocated;
+}
+
 int dtsf_find_free_uplink_slot(struct tsch_slotframe *slotframe, uint16_t channel_offset, uint16_t number, sf_simple_cell_t* cell_list, const linkaddr_t *peer_addr)
 {
+    if(SLOTFRAME_IS_INDEXED(slotframe))
+    {
+        return dtsf_find_free_uplink_slot_masked(slotframe, channel_offset, number, cell_list, peer_addr);
+    }
+
     //printf("looking for free uplink slot in channel=%d number=%d\n",channel_offset,number); 
     
     uint16_t time_offset=1;
@@ -852,71 +1478,53 @@ int dtsf_find_free_uplink_slot(struct tsch_slotframe *slotframe, uint16_t channe
    // uint16_t limit= (free_uplink_timeslots/maximum_number_of_children);
       uint16_t limit= 0;
 
-    //if(limit>4)
-   // {
-      //  limit=4;
-    //}
- //uint16_t limit= number + 3;
-// limit=0;
-  //  printf("number=%d   limit=%d  free_uplink=%d  maximum_number=%d\n",(int)number,(int)limit,(int)free_uplink_timeslots,(int)maximum_number_of_children);
-    while(time_offset < TSCH_SCHEDULE_CONF_DEFAULT_LENGTH && allocated < number+limit)
+    while(allocated < number+limit)
     {
-        if(tsch_schedule_get_link_by_just_timeslot(slotframe, time_offset) == NULL)
+        /* Jump straight to the next timeslot with no link installed, and
+         * not shadowed by another slotframe */
+        int free_timeslot = dtsf_find_free_timeslot(slotframe, time_offset);
+        if(free_timeslot < 0 || free_timeslot >= slotframe->size.val)
         {
-             if(tsch_schedule_get_link_by_timeslot(slotframe, time_offset, channel_offset) == NULL)
-             {
-                   if(tsch_is_coordinator)
-                   {
-                        if(dtsf_check_consequent_RX_timeslot(slotframe, time_offset, channel_offset, peer_addr)==1)
-                        {
-                           // if(find_in_cell_list_reserved(time_offset,channel_offset)==0)
-                           // {
-                           // printf("find downlink slot in coordinator  channel=%d  time=%d\n",channel_offset,time_offset);
-                                cell_list[allocated].channel_offset=channel_offset;
-                                cell_list[allocated].timeslot_offset=time_offset;
-                              //  add_to_cell_list_reserved(time_offset,channel_offset);
-                                allocated++;
-                                time_offset++;
-                           // }
-                        }
-                        
-                   }
-                   else
-                   {
-                        // printf("finding channel=%d  time=%d\n",parent_channel,time_offset+1);
-							   if(dtsf_check_TX_timeslot(slotframe, time_offset+1, parent_channel) == 1)
-							   {
-								  // if(find_in_cell_list_reserved(time_offset,channel_offset)==0)
-								  //  {
-								  // printf("find downlink slot in non coordinator  channel=%d  time=%d\n",channel_offset,time_offset);
-										cell_list[allocated].channel_offset=channel_offset;
-										cell_list[allocated].timeslot_offset=time_offset;
-									   //add_to_cell_list_reserved(time_offset,channel_offset);
-										allocated++;
-										time_offset++;
-								   // }
-								
-							   }
-							   else{
-											if( ((time_offset+1)%5) == 0  &&  dtsf_check_TX_timeslot(slotframe, time_offset+2, parent_channel) == 1)
-											{
-												cell_list[allocated].channel_offset=channel_offset;
-												cell_list[allocated].timeslot_offset=time_offset;
-									   //add_to_cell_list_reserved(time_offset,channel_offset);
-												allocated++;
-												time_offset++;
-												time_offset++;
-											}
-										}
-						
-							   
-					   
-					   
-                   }
-                 
-                         
-             }
-            
+            break;
+        }
+        time_offset = free_timeslot;
+
+        if(tsch_is_coordinator)
+        {
+            if(dtsf_check_consequent_RX_timeslot(slotframe, time_offset, channel_offset, peer_addr)==1)
+            {
+                int offer = dtsf_offer_uplink_cell(time_offset, channel_offset, peer_addr);
+                if(offer < 0)
+                {
+                    break;
+                }
+                if(offer > 0)
+                {
+                    cell_list[allocated].channel_offset=channel_offset;
+                    cell_list[allocated].timeslot_offset=time_offset;
+                    allocated++;
+                    time_offset++;
+                }
+            }
+        }
+        else
+        {
+            int tx_timeslot = dtsf_chain_next_tx(slotframe, time_offset);
+            if(tx_timeslot >= 0)
+            {
+                int offer = dtsf_offer_uplink_cell(time_offset, channel_offset, peer_addr);
+                if(offer < 0)
+                {
+                    break;
+                }
+                if(offer > 0)
+                {
+                    cell_list[allocated].channel_offset=channel_offset;
+                    cell_list[allocated].timeslot_offset=time_offset;
+                    allocated++;
+                    time_offset = tx_timeslot;
+                }
+            }
         }
         time_offset++;
     }
@@ -929,28 +1537,29 @@ int dtsf_find_free_uplink_slot(struct tsch_slotframe *slotframe, uint16_t channe
 int dtsf_find_free_adv_link_slot(struct tsch_slotframe *slotframe, uint16_t channel_offset, uint16_t number, sf_simple_cell_t* cell_list, const linkaddr_t *peer_addr)
 {
    // printf("looking for free adv link slot in channel=%d number=%d\n",channel_offset,number); 
-   
 
     uint16_t time_offset=0;
     uint16_t allocated=0;
         
-    while(time_offset < TSCH_SCHEDULE_CONF_DEFAULT_LENGTH && allocated < number)
+    while(allocated < number)
     {
-        if(tsch_schedule_get_link_by_just_timeslot(slotframe, time_offset) == NULL)
+        /* Jump straight to the next timeslot with no link installed, and
+         * not shadowed by another slotframe */
+        int free_timeslot = dtsf_find_free_timeslot(slotframe, time_offset);
+        if(free_timeslot < 0 || free_timeslot >= slotframe->size.val)
         {
-             if(tsch_schedule_get_link_by_timeslot(slotframe, time_offset, channel_offset) == NULL)
-             {
-                   if(find_in_cell_list_reserved(time_offset,channel_offset)==0)
-                   {
-                           // printf("find adv slot in  channel=%d  time=%d\n",channel_offset,time_offset);
-                            cell_list[allocated].channel_offset=channel_offset;
-                            cell_list[allocated].timeslot_offset=time_offset;
-                            add_to_cell_list_reserved(time_offset,channel_offset);
-                            allocated++;
-                            
-                   }
-             }
-            
+            break;
+        }
+        time_offset = free_timeslot;
+
+        /* Skip cells already offered to a child, and only hand out the
+         * cell if the ledger could record it as pending for this peer */
+        if(tsch_ledger_is_pending(time_offset,channel_offset)==0
+           && tsch_ledger_add_pending(peer_addr,time_offset,channel_offset))
+        {
+            cell_list[allocated].channel_offset=channel_offset;
+            cell_list[allocated].timeslot_offset=time_offset;
+            allocated++;
         }
         time_offset++;
     }
@@ -974,7 +1583,12 @@ tsch_schedule_get_link_by_timeslot(struct tsch_slotframe *slotframe,
 {
   if(!tsch_is_locked()) {
     if(slotframe != NULL) {
-      struct tsch_link *l = list_head(slotframe->links_list);
+      struct tsch_link *l;
+      if(SLOTFRAME_IS_INDEXED(slotframe)) {
+        l = tsch_schedule_get_link_by_just_timeslot(slotframe, timeslot);
+        return (l != NULL && l->channel_offset == channel_offset) ? l : NULL;
+      }
+      l = list_head(slotframe->links_list);
       /* Loop over all items. Assume there is max one link per timeslot */
       while(l != NULL) {
         if(l->timeslot == timeslot && l->channel_offset == channel_offset) {
@@ -985,10 +1599,9 @@ tsch_schedule_get_link_by_timeslot(struct tsch_slotframe *slotframe,
       return l;
     }
   }
-  else
+  else if(slotframe != NULL)
   {
-        printf("tsch is locked\n");
-
+        tsch_trace_add(tsch_trace_locked_lookup, slotframe->handle, timeslot, channel_offset, 0, 0, NULL);
   }
   return NULL;
 }
@@ -1006,10 +1619,10 @@ default_tsch_link_comparator(struct tsch_link *a, struct tsch_link *b)
 
   /* Two Tx links at the same slotframe; return the one with most packets to send */
   if(!linkaddr_cmp(&a->addr, &b->addr)) {
-    struct tsch_neighbor *an = tsch_queue_get_nbr(&a->addr);
-    struct tsch_neighbor *bn = tsch_queue_get_nbr(&b->addr);
-    int a_packet_count = an ? ringbufindex_elements(&an->tx_ringbuf) : 0;
-    int b_packet_count = bn ? ringbufindex_elements(&bn->tx_ringbuf) : 0;
+    struct tsch_neighbor *an = tsch_queue_get_nbr_for_link(a);
+    struct tsch_neighbor *bn = tsch_queue_get_nbr_for_link(b);
+    int a_packet_count = an ? tsch_queue_nbr_packet_count(an) : 0;
+    int b_packet_count = bn ? tsch_queue_nbr_packet_count(bn) : 0;
     /* Compare the number of packets in the queue */
     return a_packet_count >= b_packet_count ? a : b;
   }
@@ -1030,14 +1643,48 @@ tsch_schedule_get_next_active_link(struct tsch_asn_t *asn, uint16_t *time_offset
   turns out useless when the time comes. For instance, for a Tx-only link, if there is
   no outgoing packet in queue. In that case, run the backup link instead. The backup link
   must have Rx flag set. */
+  struct schedule_view *v;
+  if(published_view != NULL) {
+    /* A slot boundary: adopt the view published since the last one */
+    active_view = published_view;
+    adopted_generation = active_view->generation;
+    published_view = NULL;
+  }
+  v = active_view;
   if(!tsch_is_locked()) {
-    struct tsch_slotframe *sf = list_head(slotframe_list);
+    uint8_t sf_index;
     /* For each slotframe, look for the earliest occurring link */
-    while(sf != NULL) {
+    for(sf_index = 0; sf_index < v->sf_count; sf_index++) {
+      struct schedule_view_sf *vsf = &v->sfs[sf_index];
+      struct tsch_slotframe *sf = vsf->sf;
+      struct tsch_link **view = &v->links[vsf->offset];
       /* Get timeslot from ASN, given the slotframe length */
       uint16_t timeslot = TSCH_ASN_MOD(*asn, sf->size);
-      struct tsch_link *l = list_head(sf->links_list);
-      while(l != NULL) {
+      uint16_t next = vsf->cursor;
+      uint16_t i;
+
+      if(vsf->count == 0) {
+        continue;
+      }
+
+      /* The cursor points at the first link strictly after the timeslot it was
+       * last used for. The ASN only moves forward: restart from the top of the
+       * view when it wrapped around the slotframe, then catch up. */
+      if(next > 0 && view[next - 1]->timeslot > timeslot) {
+        next = 0;
+      }
+      while(next < vsf->count && view[next]->timeslot <= timeslot) {
+        next++;
+      }
+      vsf->cursor = next;
+      if(next == vsf->count) {
+        /* No link left in this iteration, the next one is in the next iteration */
+        next = 0;
+      }
+
+      /* Only the links at the nearest timeslot can be selected */
+      for(i = next; i < vsf->count && view[i]->timeslot == view[next]->timeslot; i++) {
+        struct tsch_link *l = view[i];
         uint16_t time_to_timeslot =
           l->timeslot > timeslot ?
           l->timeslot - timeslot :
@@ -1084,10 +1731,7 @@ tsch_schedule_get_next_active_link(struct tsch_asn_t *asn, uint16_t *time_offset
             curr_best = new_best;
           }
         }
-
-        l = list_item_next(l);
       }
-      sf = list_item_next(sf);
     }
     if(time_offset != NULL) {
       *time_offset = time_to_curr_best;
@@ -1107,6 +1751,14 @@ tsch_schedule_init(void)
     memb_init(&link_memb);
     memb_init(&slotframe_memb);
     list_init(slotframe_list);
+    list_init(retired_links);
+    installed_links = 0;
+    schedule_views[0].sf_count = 0;
+    schedule_views[0].generation = 0;
+    built_generation = 0;
+    active_view = &schedule_views[0];
+    adopted_generation = 0;
+    published_view = NULL;
     tsch_release_lock();
     return 1;
   } else {
@@ -1118,14 +1770,19 @@ tsch_schedule_init(void)
 void
 tsch_schedule_create_minimal(void)
 {
-    printf("omid: minimal schedule created\n");
+    LOG_INFO("minimal schedule created\n");
   
   /* First, empty current schedule */
   tsch_schedule_remove_all_slotframes();
   struct tsch_slotframe *sf_min;
   
-         sf_min = tsch_schedule_add_slotframe(0, TSCH_SCHEDULE_DEFAULT_LENGTH);
+         sf_min = tsch_schedule_add_slotframe(TSCH_SCHEDULE_GT_SHARED_HANDLE, tsch_gt_config.shared_length);
                 //tsch_schedule_add_slotframe(0, TSCH_SCHEDULE_DEFAULT_LENGTH);
+#if TSCH_SCHEDULE_GT_MULTI_SLOTFRAME
+  /* 6P control and data cells get their own slotframes, empty for now */
+  tsch_schedule_add_slotframe(TSCH_SCHEDULE_GT_CONTROL_HANDLE, tsch_gt_config.control_length);
+  tsch_schedule_add_slotframe(TSCH_SCHEDULE_GT_DATA_HANDLE, tsch_gt_config.data_length);
+#endif
 
   /* Build 6TiSCH minimal schedule.
    * We pick a slotframe length of TSCH_SCHEDULE_DEFAULT_LENGTH */
@@ -1137,9 +1794,8 @@ tsch_schedule_create_minimal(void)
    * but is required according to 802.15.4e if also used for EB transmission.
    * 
    * Timeslot: 0, channel offset: 0. */
-   int n=7;
    int i=0;
-   for(i=0;i<TSCH_SCHEDULE_CONF_DEFAULT_LENGTH;i=i+5)
+   for(i=0;i<tsch_gt_config.shared_length;i=i+tsch_gt_config.adv_stride)
    {
            tsch_schedule_add_link(sf_min, (LINK_OPTION_RX | LINK_OPTION_TX | LINK_OPTION_SHARED), LINK_TYPE_ADVERTISING, &tsch_broadcast_address,i, default_channel);
 		 
@@ -1150,8 +1806,20 @@ tsch_schedule_create_minimal(void)
  if(tsch_is_coordinator)
    {
  
-       
-       free_uplink_timeslots=free_uplink_timeslots - n;
+#if TSCH_SCHEDULE_GT_MULTI_SLOTFRAME
+       /* Data timeslots shadowed by the advertising cells are never used */
+       struct tsch_slotframe *sf_data = tsch_schedule_get_slotframe_by_handle(TSCH_SCHEDULE_GT_DATA_HANDLE);
+       for(i = 0; sf_data != NULL && i < sf_data->size.val; i++)
+       {
+           if(dtsf_is_shadowed_timeslot(sf_data, i))
+           {
+               free_uplink_timeslots=free_uplink_timeslots - 1;
+           }
+       }
+#else
+       /* Advertising cells are taken from the data cells */
+       free_uplink_timeslots=free_uplink_timeslots - tsch_gt_config.adv_cells;
+#endif
        find_shared_timeslot_children();
                                           
    }     
@@ -1160,6 +1828,25 @@ tsch_schedule_create_minimal(void)
           
 
  
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_schedule_forget_nbr(const struct tsch_neighbor *n)
+{
+  struct tsch_slotframe *sf;
+  struct tsch_link *l;
+  for(sf = list_head(slotframe_list); sf != NULL; sf = list_item_next(sf)) {
+    for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+      if(l->nbr == n) {
+        l->nbr = NULL;
+      }
+    }
+  }
+  for(l = list_head(retired_links); l != NULL; l = list_item_next(l)) {
+    if(l->nbr == n) {
+      l->nbr = NULL;
+    }
+  }
 }
 /*---------------------------------------------------------------------------*/
 struct tsch_slotframe *
@@ -66,6 +66,17 @@ typedef struct {
   uint16_t timeslot_offset;
   uint16_t channel_offset;
 } sf_simple_cell_t;
+
+/** \brief GT-TSCH slotframe geometry, set at compile time through the
+ * TSCH_SCHEDULE_CONF_GT_* settings and checked in tsch-schedule.c */
+struct tsch_gt_config {
+  uint16_t shared_length; /* Length of the EB/shared slotframe */
+  uint16_t control_length; /* Length of the 6P control slotframe */
+  uint16_t data_length; /* Length of the data slotframe */
+  uint16_t adv_stride; /* One advertising cell every adv_stride timeslots */
+  uint16_t adv_cells; /* Number of advertising cells in the shared slotframe */
+};
+extern const struct tsch_gt_config tsch_gt_config;
 /**
  * \brief Creates and adds a new slotframe
  * \param handle the slotframe handle
@@ -115,6 +126,32 @@ int dtsf_find_last_uplinks(const linkaddr_t *peer_addr, uint16_t number, sf_simp
 int dtsf_find_free_adv_link_slot(struct tsch_slotframe *slotframe, uint16_t channel_offset, uint16_t number, sf_simple_cell_t* cell_list, const linkaddr_t *peer_addr);
 struct tsch_link* tsch_schedule_get_link_by_just_timeslot(struct tsch_slotframe *slotframe, uint16_t timeslot);
 
+/**
+ * \brief GT-TSCH uplink chain: finds the spare uplink to our parent fed by an
+ * Rx cell, right after it or right after the advertising cell that follows it
+ * \param slotframe The data slotframe
+ * \param timeslot The timeslot of the Rx cell
+ * \return The timeslot of the uplink, -1 if the Rx cell would feed none
+ */
+int dtsf_chain_next_tx(struct tsch_slotframe *slotframe, uint16_t timeslot);
+/**
+ * \brief GT-TSCH uplink chain: finds the Rx cell feeding an uplink
+ * \param slotframe The data slotframe
+ * \param timeslot The timeslot of the uplink
+ * \param channel_offset The channel offset of our children
+ * \return The timeslot of the Rx cell, -1 if none
+ */
+int dtsf_chain_prev_rx(struct tsch_slotframe *slotframe, uint16_t timeslot, uint16_t channel_offset);
+
+/**
+ * \brief Looks within a slotframe for the first timeslot with no link installed.
+ * Uses the slotframe's occupancy bitmap, 32 timeslots per word, when available.
+ * \param slotframe The desired slotframe
+ * \param timeslot The timeslot to start looking from
+ * \return The first free timeslot at or after the given one, -1 if none
+ */
+int tsch_schedule_find_free_timeslot(struct tsch_slotframe *slotframe, uint16_t timeslot);
+
 ///////////////////////////////////////////////////////////////////
 
 
@@ -122,7 +159,30 @@ struct tsch_link* tsch_schedule_get_link_by_just_timeslot(struct tsch_slotframe
 struct tsch_link *tsch_schedule_add_link(struct tsch_slotframe *slotframe,
                                          uint8_t link_options, enum link_type link_type, const linkaddr_t *address,
                                          uint16_t timeslot, uint16_t channel_offset);
-                                         
+
+/**
+ * \brief Adds a batch of links to a slotframe, e.g. the cells of a 6P
+ * response, all or nothing. The whole list is validated first, and the
+ * links reserved from the link pool up front: if any cell is refused by
+ * validation, or if memory runs out, none is installed. The schedule is
+ * published once. Links deleted just before stay allocated until the next
+ * slot boundary: past TSCH_SCHEDULE_MAX_RETIRED_LINKS of them, memory runs
+ * out until then.
+ * \param slotframe The slotframe that will contain the new links
+ * \param link_options The link options, as a bitfield (LINK_OPTION_* flags)
+ * \param link_type The link type (advertising, normal)
+ * \param address The link address of the intended destination
+ * \param cells The cells to install
+ * \param count The number of cells, at most TSCH_SCHEDULE_MAX_LINKS
+ * \param installed Optional, count entries set to 1 for the cells
+ * installed. If validation refused the batch, set to 1 for the cells that
+ * passed it, so that the caller can retry with those only. If memory ran
+ * out, all 0.
+ * \return The number of links installed, -1 if the batch was not applied
+ */
+int tsch_schedule_add_links(struct tsch_slotframe *slotframe,
+                            uint8_t link_options, enum link_type link_type, const linkaddr_t *address,
+                            const sf_simple_cell_t *cells, uint16_t count, uint8_t *installed);
                 
 /**
 * \brief Looks for a link from a handle
@@ -139,6 +199,22 @@ int tsch_schedule_delete_link(struct tsch_slotframe *slotframe,
                                          
                                          
                                          
+/**
+ * \brief Deletes a batch of links from a slotframe, publishing the schedule
+ * once. Cells with no link installed for the address are skipped.
+ * \param slotframe The slotframe holding the links
+ * \param link_options The link options, as a bitfield (LINK_OPTION_* flags)
+ * \param link_type The link type (advertising, normal)
+ * \param address The link address of the links
+ * \param cells The cells to delete
+ * \param count The number of cells
+ * \param deleted Optional, count entries set to 1 for the cells deleted
+ * \return The number of links deleted, -1 if failure
+ */
+int tsch_schedule_delete_links(struct tsch_slotframe *slotframe,
+                               uint8_t link_options, enum link_type link_type, const linkaddr_t *address,
+                               const sf_simple_cell_t *cells, uint16_t count, uint8_t *deleted);
+
 struct tsch_link *tsch_schedule_get_link_by_handle(uint16_t handle);
 
 /**
@@ -179,6 +255,26 @@ int tsch_schedule_remove_link_by_timeslot(struct tsch_slotframe *slotframe,
 struct tsch_link * tsch_schedule_get_next_active_link(struct tsch_asn_t *asn, uint16_t *time_offset,
     struct tsch_link **backup_link);
 
+/**
+ * \brief Clears a neighbor queue from the links caching it, before the
+ * queue is freed. Call with the TSCH lock held.
+ * \param n The neighbor queue
+ */
+void tsch_schedule_forget_nbr(const struct tsch_neighbor *n);
+
+/**
+ * \brief Formats link options for printout, e.g. "Tx|Sh"
+ * \param link_options The link options, as a bitfield (LINK_OPTION_* flags)
+ * \return A static buffer, overwritten by the next call
+ */
+const char *tsch_schedule_print_link_options(uint16_t link_options);
+/**
+ * \brief Formats a link type for printout
+ * \param link_type The link type
+ * \return A constant string
+ */
+const char *tsch_schedule_print_link_type(uint16_t link_type);
+
 /**
  * \brief Access the first item in the list of slotframes
  * \return The first slotframe in the schedule if any, NULL otherwise
@@ -126,6 +126,11 @@ struct tsch_packet *dequeued_array[TSCH_DEQUEUED_ARRAY_SIZE];
  * Will be processed layer by tsch_rx_process_pending */
 struct ringbufindex input_ringbuf;
 struct input_packet input_array[TSCH_MAX_INCOMING_PACKETS];
+/* Frame storage of input_array. tsch_rx_process_pending hands frames over
+ * to packetbuf by exchanging buffers with it, so a given entry of
+ * input_array does not keep the same storage. TSCH_PACKET_MAX_LEN is
+ * PACKETBUF_SIZE, and the buffers are aligned as packetbuf. */
+static uint32_t input_frames[TSCH_MAX_INCOMING_PACKETS][(TSCH_PACKET_MAX_LEN + 3) / 4];
 
 /* Updates and reads of the next two variables must be atomic (i.e. both together) */
 /* Last time we received Sync-IE (ACK or data packet from a time source) */
@@ -158,10 +163,15 @@ struct tsch_link *current_link = NULL;
 /* A backup link with Rx flag, overlapping with current_link.
  * If the current link is Tx-only and the Tx queue
  * is empty while executing the link, fallback to the backup link. */
-static struct tsch_link *backup_link = NULL;
+struct tsch_link *backup_link = NULL;
 static struct tsch_packet *current_packet = NULL;
 static struct tsch_neighbor *current_neighbor = NULL;
 
+#if TSCH_STATS_SLOT_TIMING
+/* Start time of the slot operation phase being profiled */
+static rtimer_clock_t timing_start;
+#endif /* TSCH_STATS_SLOT_TIMING */
+
 /* Indicates whether an extra link is needed to handle the current burst */
 static int burst_link_scheduled = 0;
 /* Counts the length of the current burst */
@@ -320,6 +330,24 @@ tsch_schedule_slot_operation(struct rtimer *tm, rtimer_clock_t ref_time, rtimer_
     } \
   } while(0);
 /*---------------------------------------------------------------------------*/
+#if TSCH_QUEUE_WITH_DEADLINES
+/* Hands the packets of a neighbor queue whose deadline has passed over to
+ * tsch_tx_process_pending, as failed transmissions, so that they do not take
+ * the cell. Leaves room in dequeued_ringbuf for the packet sent in this slot. */
+static void
+drop_stale_packets(struct tsch_neighbor *n)
+{
+  struct tsch_packet *p;
+  while(ringbufindex_elements(&dequeued_ringbuf) < ringbufindex_size(&dequeued_ringbuf) - 2
+        && (p = tsch_queue_remove_stale_packet(n)) != NULL) {
+    p->ret = MAC_TX_ERR;
+    dequeued_array[ringbufindex_peek_put(&dequeued_ringbuf)] = p;
+    ringbufindex_put(&dequeued_ringbuf);
+    process_poll(&tsch_pending_events_process);
+  }
+}
+#endif /* TSCH_QUEUE_WITH_DEADLINES */
+/*---------------------------------------------------------------------------*/
 /* Get EB, broadcast or unicast packet to be sent, and target neighbor. */
 static struct tsch_packet *
 get_packet_and_neighbor_for_link(struct tsch_link *link, struct tsch_neighbor **target_neighbor)
@@ -339,7 +367,11 @@ get_packet_and_neighbor_for_link(struct tsch_link *link, struct tsch_neighbor **
       /* NORMAL link or no EB to send, pick a data packet */
       if(p == NULL) {
         /* Get neighbor queue associated to the link and get packet from it */
-        n = tsch_queue_get_nbr(&link->addr);
+        n = tsch_queue_get_nbr_for_link(link);
+#if TSCH_QUEUE_WITH_DEADLINES
+        drop_stale_packets(n);
+#endif /* TSCH_QUEUE_WITH_DEADLINES */
+        /* Control packets come first */
         p = tsch_queue_get_packet_for_nbr(n, link);
         /* if it is a broadcast slot and there were no broadcast packets, pick any unicast packet */
         if(p == NULL && n == n_broadcast) {
@@ -474,6 +506,7 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
 
   /* First check if we have space to store a newly dequeued packet (in case of
    * successful Tx or Drop) */
+  TSCH_STATS_TIMING_START(timing_start);
   dequeued_index = ringbufindex_peek_put(&dequeued_ringbuf);
   if(dequeued_index != -1) {
     if(current_packet == NULL || current_packet->qb == NULL) {
@@ -537,6 +570,7 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
       /* prepare packet to send: copy to radio buffer */
       if(packet_ready && NETSTACK_RADIO.prepare(packet, packet_len) == 0) { /* 0 means success */
         static rtimer_clock_t tx_duration;
+        TSCH_STATS_TIMING_END(tsch_stats_timing_tx_prepare, timing_start);
 
 #if TSCH_CCA_ENABLED
         cca_status = 1;
@@ -559,7 +593,9 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
           TSCH_SCHEDULE_AND_YIELD(pt, t, current_slot_start, tsch_timing[tsch_ts_tx_offset] - RADIO_DELAY_BEFORE_TX, "TxBeforeTx");
           TSCH_DEBUG_TX_EVENT();
           /* send packet already in radio tx buffer */
+          TSCH_STATS_TIMING_START(timing_start);
           mac_tx_status = NETSTACK_RADIO.transmit(packet_len);
+          TSCH_STATS_TIMING_END(tsch_stats_timing_tx, timing_start);
           tx_count++;
           /* Save tx timestamp */
           tx_start_time = current_slot_start + tsch_timing[tsch_ts_tx_offset];
@@ -603,6 +639,7 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
                                  ack_start_time, tsch_timing[tsch_ts_max_ack]);
               TSCH_DEBUG_TX_EVENT();
               tsch_radio_off(TSCH_RADIO_CMD_OFF_WITHIN_TIMESLOT);
+              TSCH_STATS_TIMING_START(timing_start);
 
 #if TSCH_HW_FRAME_FILTERING
               /* Leaving promiscuous mode */
@@ -638,6 +675,7 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
                 }
 #endif /* LLSEC802154_ENABLED */
               }
+              TSCH_STATS_TIMING_END(tsch_stats_timing_tx_ack, timing_start);
 
               if(ack_len != 0) {
                 if(is_time_source) {
@@ -805,6 +843,7 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
         radio_value_t radio_last_rssi;
         radio_value_t radio_last_lqi;
 
+        TSCH_STATS_TIMING_START(timing_start);
         /* Read packet */
         current_input->len = NETSTACK_RADIO.read((void *)current_input->payload, TSCH_PACKET_MAX_LEN);
         NETSTACK_RADIO.get_value(RADIO_PARAM_LAST_RSSI, &radio_last_rssi);
@@ -905,6 +944,7 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
 
                 /* Copy to radio buffer */
                 NETSTACK_RADIO.prepare((const void *)ack_buf, ack_len);
+                TSCH_STATS_TIMING_END(tsch_stats_timing_rx_ack, timing_start);
 
                 /* Wait for time to ACK and transmit ACK */
                 TSCH_SCHEDULE_AND_YIELD(pt, t, rx_start_time,
@@ -1011,6 +1051,7 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
       is_drift_correction_used = 0;
       /* Get a packet ready to be sent */
      
+      TSCH_STATS_TIMING_START(timing_start);
       current_packet = get_packet_and_neighbor_for_link(current_link, &current_neighbor);
       /* There is no packet to send, and this link does not have Rx flag. Instead of doing
        * nothing, switch to the backup link (has Rx flag) if any. */
@@ -1018,6 +1059,7 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
         current_link = backup_link;
         current_packet = get_packet_and_neighbor_for_link(current_link, &current_neighbor);
       }
+      TSCH_STATS_TIMING_END(tsch_stats_timing_packet_fetch, timing_start);
       is_active_slot = current_packet != NULL || (current_link->link_options & LINK_OPTION_RX);
       if(is_active_slot) {
         /* If we are in a burst, we stick to current channel instead of
@@ -1051,6 +1093,8 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
           static struct pt slot_rx_pt;
           PT_SPAWN(&slot_operation_pt, &slot_rx_pt, tsch_rx_slot(&slot_rx_pt, t));
         }
+        /* How much of the timeslot the slot used */
+        tsch_stats_timing_add(tsch_stats_timing_slot, RTIMER_NOW() - current_slot_start);
       } else {
         /* Make sure to end the burst in cast, for some reason, we were
          * in a burst but now without any more packet to send. */
@@ -1103,7 +1147,9 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
           tsch_current_burst_count++;
         } else {
           /* Get next active link */
+          TSCH_STATS_TIMING_START(timing_start);
           current_link = tsch_schedule_get_next_active_link(&tsch_current_asn, &timeslot_diff, &backup_link);
+          TSCH_STATS_TIMING_END(tsch_stats_timing_next_link, timing_start);
           if(current_link == NULL) {
             /* There is no next link. Fall back to default
              * behavior: wake up at the next slot. */
@@ -1135,6 +1181,16 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
   PT_END(&slot_operation_pt);
 }
 /*---------------------------------------------------------------------------*/
+void
+tsch_slot_operation_init(void)
+{
+  int i;
+  ringbufindex_init(&input_ringbuf, TSCH_MAX_INCOMING_PACKETS);
+  for(i = 0; i < TSCH_MAX_INCOMING_PACKETS; i++) {
+    input_array[i].payload = (uint8_t *)input_frames[i];
+  }
+}
+/*---------------------------------------------------------------------------*/
 /* Set global time before starting slot operation,
  * with a rtimer time and an ASN */
 void
@@ -91,6 +91,10 @@ int tsch_get_lock(void);
  * Releases the TSCH lock.
  */
 void tsch_release_lock(void);
+/**
+ * Initialize the input packet ring: give each entry its frame storage
+ */
+void tsch_slot_operation_init(void);
 /**
  * Set global time before starting slot operation, with a rtimer time and an ASN
  *
@@ -38,6 +38,7 @@
 #include "net/mac/tsch/tsch.h"
 #include "net/netstack.h"
 #include "dev/radio.h"
+#include <string.h>
 
 /* Log configuration */
 #include "sys/log.h"
@@ -234,3 +235,74 @@ periodic(void *ptr)
 /*---------------------------------------------------------------------------*/
 #endif /* TSCH_STATS_ON */
 /*---------------------------------------------------------------------------*/
+#if TSCH_STATS_SLOT_TIMING
+/*---------------------------------------------------------------------------*/
+
+static struct tsch_stats_timing timing[tsch_stats_timing_phase_count];
+
+static const char *const timing_phase_names[tsch_stats_timing_phase_count] = {
+  "next-link",
+  "packet-fetch",
+  "tx-prepare",
+  "tx",
+  "tx-ack",
+  "rx-ack",
+  "slot",
+};
+
+/*---------------------------------------------------------------------------*/
+/* Records a duration. Called from slot operation, so kept short */
+void
+tsch_stats_timing_add(uint8_t phase, rtimer_clock_t duration)
+{
+  struct tsch_stats_timing *s;
+  uint32_t bucket;
+
+  if(phase >= tsch_stats_timing_phase_count) {
+    return;
+  }
+  s = &timing[phase];
+
+  if(s->count == 0 || duration < s->min) {
+    s->min = duration;
+  }
+  if(duration > s->max) {
+    s->max = duration;
+  }
+  if(s->sum > UINT32_MAX - duration) {
+    /* Keep the average, drop half of the history */
+    s->sum /= 2;
+    s->count /= 2;
+  }
+  s->sum += duration;
+  s->count++;
+
+  bucket = (uint32_t)duration * TSCH_STATS_TIMING_BUCKETS / tsch_timing[tsch_ts_timeslot_length];
+  if(bucket >= TSCH_STATS_TIMING_BUCKETS) {
+    bucket = TSCH_STATS_TIMING_BUCKETS - 1;
+  }
+  if(s->histogram[bucket] < UINT16_MAX) {
+    s->histogram[bucket]++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+const struct tsch_stats_timing *
+tsch_stats_timing_get(uint8_t phase)
+{
+  return phase < tsch_stats_timing_phase_count ? &timing[phase] : NULL;
+}
+/*---------------------------------------------------------------------------*/
+const char *
+tsch_stats_timing_phase_name(uint8_t phase)
+{
+  return phase < tsch_stats_timing_phase_count ? timing_phase_names[phase] : "?";
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_stats_timing_reset(void)
+{
+  memset(timing, 0, sizeof(timing));
+}
+/*---------------------------------------------------------------------------*/
+#endif /* TSCH_STATS_SLOT_TIMING */
+/*---------------------------------------------------------------------------*/
@@ -109,6 +109,21 @@
 #define TSCH_STATS_FIRST_CHANNEL 11
 #endif
 
+/* Profile slot operation: record how long each phase of a slot takes? */
+#ifdef TSCH_STATS_CONF_SLOT_TIMING
+#define TSCH_STATS_SLOT_TIMING TSCH_STATS_CONF_SLOT_TIMING
+#else
+#define TSCH_STATS_SLOT_TIMING 0
+#endif
+
+/* The number of histogram buckets per slot phase, each covering an equal
+ * part of the timeslot length */
+#ifdef TSCH_STATS_CONF_TIMING_BUCKETS
+#define TSCH_STATS_TIMING_BUCKETS TSCH_STATS_CONF_TIMING_BUCKETS
+#else
+#define TSCH_STATS_TIMING_BUCKETS 8
+#endif
+
 /* Internal: the scaling of the various stats */
 #define TSCH_STATS_RSSI_SCALING_FACTOR    -16
 #define TSCH_STATS_LQI_SCALING_FACTOR      16
@@ -166,6 +181,30 @@ struct tsch_neighbor_stats {
 
 struct tsch_neighbor; /* Forward declaration */
 
+/* The phases of slot operation profiled with TSCH_STATS_SLOT_TIMING */
+enum tsch_stats_timing_phase {
+  tsch_stats_timing_next_link,    /* tsch_schedule_get_next_active_link */
+  tsch_stats_timing_packet_fetch, /* get_packet_and_neighbor_for_link */
+  tsch_stats_timing_tx_prepare,   /* Start of a Tx slot to packet in radio buffer */
+  tsch_stats_timing_tx,           /* Radio transmit call */
+  tsch_stats_timing_tx_ack,       /* End of ACK reception to ACK parsed */
+  tsch_stats_timing_rx_ack,       /* End of reception to ACK in radio buffer */
+  tsch_stats_timing_slot,         /* Start of an active slot to its end */
+  tsch_stats_timing_phase_count
+};
+
+/* Durations of one phase, in rtimer ticks */
+struct tsch_stats_timing {
+  rtimer_clock_t min;
+  rtimer_clock_t max;
+  uint32_t sum;
+  uint32_t count;
+  /* Bucket i counts the durations between i and i + 1 times
+   * (timeslot length / TSCH_STATS_TIMING_BUCKETS); the last one also
+   * counts those longer than the timeslot */
+  uint16_t histogram[TSCH_STATS_TIMING_BUCKETS];
+};
+
 
 /************ External variables ***********/
 
@@ -206,6 +245,30 @@ void tsch_stats_reset_neighbor_stats(void);
 
 #endif /* TSCH_STATS_ON */
 
+#if TSCH_STATS_SLOT_TIMING
+
+void tsch_stats_timing_add(uint8_t phase, rtimer_clock_t duration);
+
+const struct tsch_stats_timing *tsch_stats_timing_get(uint8_t phase);
+
+const char *tsch_stats_timing_phase_name(uint8_t phase);
+
+void tsch_stats_timing_reset(void);
+
+/* Time a phase of slot operation, with a rtimer_clock_t variable */
+#define TSCH_STATS_TIMING_START(start) ((start) = RTIMER_NOW())
+#define TSCH_STATS_TIMING_END(phase, start) tsch_stats_timing_add((phase), RTIMER_NOW() - (start))
+
+#else /* TSCH_STATS_SLOT_TIMING */
+
+#define tsch_stats_timing_add(phase, duration)
+#define tsch_stats_timing_get(phase) NULL
+#define tsch_stats_timing_reset()
+#define TSCH_STATS_TIMING_START(start)
+#define TSCH_STATS_TIMING_END(phase, start)
+
+#endif /* TSCH_STATS_SLOT_TIMING */
+
 static inline uint8_t
 tsch_stats_channel_to_index(uint8_t channel)
 {
@@ -93,4 +93,89 @@ const tsch_timeslot_timing_usec tsch_timeslot_timing_us_10000 = {
   10000, /* TimeslotLength */
 };
 
+/* Same as the 10ms template, with more time to prepare the frame, to
+ * process it before the ACK, and to process the ACK */
+const tsch_timeslot_timing_usec tsch_timeslot_timing_us_15000 = {
+   1800, /* CCAOffset */
+    128, /* CCA */
+   4000, /* TxOffset */
+  (4000 - (TSCH_CONF_RX_WAIT / 2)), /* RxOffset */
+   3600, /* RxAckDelay */
+   4000, /* TxAckDelay */
+  TSCH_CONF_RX_WAIT, /* RxWait */
+    800, /* AckWait */
+   2072, /* RxTx */
+   2400, /* MaxAck */
+   4256, /* MaxTx */
+  15000, /* TimeslotLength */
+};
+
+const uint16_t *const tsch_timeslot_timing_templates[] = {
+  tsch_timeslot_timing_us_10000,
+  tsch_timeslot_timing_us_15000,
+  NULL
+};
+
+#if TSCH_STATS_SLOT_TIMING
+/*---------------------------------------------------------------------------*/
+/* Largest duration measured for a phase, plus the calibration margin */
+static rtimer_clock_t
+measured_max(uint8_t phase)
+{
+  const struct tsch_stats_timing *s = tsch_stats_timing_get(phase);
+  return (uint32_t)s->max * (100 + TSCH_TIMING_CALIBRATION_MARGIN) / 100;
+}
+/*---------------------------------------------------------------------------*/
+/* Does a template leave room for each phase of slot operation, as
+ * measured on this platform? */
+static int
+template_fits(const uint16_t *timing_us)
+{
+  rtimer_clock_t t[tsch_ts_elements_count];
+  rtimer_clock_t tx_end;
+  rtimer_clock_t rx_end;
+  uint8_t i;
+
+  for(i = 0; i < tsch_ts_elements_count; i++) {
+    t[i] = US_TO_RTIMERTICKS(timing_us[i]);
+  }
+
+  /* Tx: the link's packet fetched and in the radio buffer before CCA or Tx */
+  if(measured_max(tsch_stats_timing_packet_fetch) + measured_max(tsch_stats_timing_tx_prepare)
+     + RADIO_DELAY_BEFORE_TX > (TSCH_CCA_ENABLED ? t[tsch_ts_cca_offset] : t[tsch_ts_tx_offset])) {
+    return 0;
+  }
+  /* Rx: the frame processed and the ACK in the radio buffer in time */
+  if(measured_max(tsch_stats_timing_rx_ack) + RADIO_DELAY_BEFORE_TX > t[tsch_ts_tx_ack_delay]) {
+    return 0;
+  }
+  /* The slot over, ACK processed, and the next one planned, before the
+   * timeslot ends: worst case on either side */
+  tx_end = t[tsch_ts_tx_offset] + t[tsch_ts_max_tx] + t[tsch_ts_rx_ack_delay]
+    + t[tsch_ts_ack_wait] + t[tsch_ts_max_ack] + measured_max(tsch_stats_timing_tx_ack);
+  rx_end = t[tsch_ts_rx_offset] + t[tsch_ts_rx_wait] + t[tsch_ts_max_tx]
+    + t[tsch_ts_tx_ack_delay] + t[tsch_ts_max_ack];
+  if(MAX(tx_end, rx_end) + measured_max(tsch_stats_timing_next_link) > t[tsch_ts_timeslot_length]) {
+    return 0;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+const uint16_t *
+tsch_timing_calibrate(void)
+{
+  uint8_t i;
+  if(tsch_stats_timing_get(tsch_stats_timing_slot)->count < TSCH_TIMING_CALIBRATION_MIN_SLOTS) {
+    return NULL;
+  }
+  for(i = 0; tsch_timeslot_timing_templates[i] != NULL; i++) {
+    if(template_fits(tsch_timeslot_timing_templates[i])) {
+      return tsch_timeslot_timing_templates[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* TSCH_STATS_SLOT_TIMING */
+
 /** @} */
@@ -0,0 +1,142 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Deferred trace of TSCH schedule changes. Changes made with the
+ *         TSCH lock held are recorded as fixed-size binary records in a
+ *         ring buffer, and printed out later from the pending events
+ *         process, so that no formatting or UART output happens while slot
+ *         operation is kept waiting.
+ */
+
+/**
+ * \addtogroup tsch
+ * @{
+*/
+
+#include "contiki.h"
+#include <stdio.h>
+#include "net/mac/tsch/tsch.h"
+#include "lib/ringbufindex.h"
+#include "sys/log.h"
+
+#if TSCH_TRACE_ENABLED
+
+PROCESS_NAME(tsch_pending_events_process);
+
+/* Check if TSCH_TRACE_QUEUE_LEN is a power of two */
+#if (TSCH_TRACE_QUEUE_LEN & (TSCH_TRACE_QUEUE_LEN - 1)) != 0
+#error TSCH_TRACE_QUEUE_LEN must be power of two
+#endif
+static struct ringbufindex trace_ringbuf;
+static struct tsch_trace_event trace_array[TSCH_TRACE_QUEUE_LEN];
+static int trace_dropped = 0;
+static int trace_active = 0;
+
+/*---------------------------------------------------------------------------*/
+void
+tsch_trace_add(uint8_t type, uint16_t slotframe_handle, uint16_t timeslot,
+               uint16_t channel_offset, uint8_t link_options, uint8_t link_type,
+               const linkaddr_t *addr)
+{
+  int trace_index;
+  struct tsch_trace_event *e;
+
+  if(trace_active == 0) {
+    return;
+  }
+  trace_index = ringbufindex_peek_put(&trace_ringbuf);
+  if(trace_index == -1) {
+    trace_dropped++;
+    return;
+  }
+  e = &trace_array[trace_index];
+  e->asn = tsch_current_asn;
+  e->type = type;
+  e->slotframe_handle = slotframe_handle;
+  e->timeslot = timeslot;
+  e->channel_offset = channel_offset;
+  e->link_options = link_options;
+  e->link_type = link_type;
+  linkaddr_copy(&e->addr, addr != NULL ? addr : &linkaddr_null);
+  ringbufindex_put(&trace_ringbuf);
+  process_poll(&tsch_pending_events_process);
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_trace_process_pending(void)
+{
+  static int last_trace_dropped = 0;
+  int16_t trace_index;
+
+  if(trace_dropped != last_trace_dropped) {
+    printf("[WARN: TSCH-TRACE] traces dropped %u\n", trace_dropped);
+    last_trace_dropped = trace_dropped;
+  }
+  while((trace_index = ringbufindex_peek_get(&trace_ringbuf)) != -1) {
+    struct tsch_trace_event *e = &trace_array[trace_index];
+    switch(e->type) {
+      case tsch_trace_add_slotframe:
+        printf("add a slotframe : sf=%u size=%u\n", e->slotframe_handle, e->timeslot);
+        break;
+      case tsch_trace_remove_slotframe:
+        printf("remove a slotframe : sf=%u size=%u\n", e->slotframe_handle, e->timeslot);
+        break;
+      case tsch_trace_add_link:
+      case tsch_trace_remove_link:
+        printf("%s a link : type=%s sf=%u opt=%s  ts=%u ch=%d addr=",
+               e->type == tsch_trace_add_link ? "add" : "remove",
+               tsch_schedule_print_link_type(e->link_type), e->slotframe_handle,
+               tsch_schedule_print_link_options(e->link_options),
+               e->timeslot, e->channel_offset);
+        log_lladdr_compact(&e->addr);
+        printf("\n");
+        break;
+      case tsch_trace_locked_lookup:
+        printf("tsch is locked : sf=%u ts=%u ch=%u\n",
+               e->slotframe_handle, e->timeslot, e->channel_offset);
+        break;
+    }
+    /* Remove the record from the ringbuf */
+    ringbufindex_get(&trace_ringbuf);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_trace_init(void)
+{
+  if(trace_active == 0) {
+    ringbufindex_init(&trace_ringbuf, TSCH_TRACE_QUEUE_LEN);
+    trace_active = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+#endif /* TSCH_TRACE_ENABLED */
+/** @} */
@@ -0,0 +1,132 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \addtogroup tsch
+ * @{
+ * \file
+ *	Deferred binary trace of TSCH schedule changes
+*/
+
+#ifndef __TSCH_TRACE_H__
+#define __TSCH_TRACE_H__
+
+/********** Includes **********/
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+#include "net/mac/tsch/tsch-asn.h"
+
+/******** Configuration *******/
+
+/* Trace schedule changes. Enabled by default: the records replace the
+ * printouts the schedule used to make while holding the TSCH lock */
+#ifdef TSCH_TRACE_CONF_ENABLED
+#define TSCH_TRACE_ENABLED TSCH_TRACE_CONF_ENABLED
+#else
+#define TSCH_TRACE_ENABLED 1
+#endif
+
+/* Number of trace records held until printout. Must be power of two */
+#ifdef TSCH_TRACE_CONF_QUEUE_LEN
+#define TSCH_TRACE_QUEUE_LEN TSCH_TRACE_CONF_QUEUE_LEN
+#else
+#define TSCH_TRACE_QUEUE_LEN 16
+#endif
+
+/********** Data types **********/
+
+enum tsch_trace_event_type {
+  tsch_trace_add_slotframe,
+  tsch_trace_remove_slotframe,
+  tsch_trace_add_link,
+  tsch_trace_remove_link,
+  tsch_trace_locked_lookup,
+};
+
+/** \brief One schedule change. Fixed size, filled in with no formatting */
+struct tsch_trace_event {
+  struct tsch_asn_t asn;
+  uint8_t type; /* enum tsch_trace_event_type */
+  uint8_t link_options;
+  uint8_t link_type;
+  uint16_t slotframe_handle;
+  uint16_t timeslot; /* Slotframe size for slotframe events */
+  uint16_t channel_offset;
+  linkaddr_t addr;
+};
+
+#if TSCH_TRACE_ENABLED
+
+/********** Functions *********/
+
+/**
+ * \brief Initialize the trace module. Call before any schedule change.
+ */
+void tsch_trace_init(void);
+/**
+ * \brief Record a schedule change. Safe to call with the TSCH lock held:
+ * copies a few fields into the ring buffer and polls the printout.
+ * \param type The change (enum tsch_trace_event_type)
+ * \param slotframe_handle The slotframe handle
+ * \param timeslot The timeslot, or the slotframe size for slotframe events
+ * \param channel_offset The channel offset
+ * \param link_options The link options, 0 for slotframe events
+ * \param link_type The link type, 0 for slotframe events
+ * \param addr The link address, NULL if none
+ */
+void tsch_trace_add(uint8_t type, uint16_t slotframe_handle, uint16_t timeslot,
+                    uint16_t channel_offset, uint8_t link_options, uint8_t link_type,
+                    const linkaddr_t *addr);
+/**
+ * \brief Print out pending trace records. Call from process context.
+ */
+void tsch_trace_process_pending(void);
+
+#else /* TSCH_TRACE_ENABLED */
+
+#define tsch_trace_init()
+#define tsch_trace_add(type, slotframe_handle, timeslot, channel_offset, link_options, link_type, addr)
+#define tsch_trace_process_pending()
+
+#endif /* TSCH_TRACE_ENABLED */
+
+/************ Macros **********/
+
+/** \brief Trace a change of a link */
+#define TSCH_TRACE_LINK(type, l) \
+  tsch_trace_add((type), (l)->slotframe_handle, (l)->timeslot, (l)->channel_offset, \
+                 (l)->link_options, (l)->link_type, &(l)->addr)
+
+/** \brief Trace a change of a slotframe */
+#define TSCH_TRACE_SLOTFRAME(type, sf) \
+  tsch_trace_add((type), (sf)->handle, (sf)->size.val, 0, 0, 0, NULL)
+
+#endif /* __TSCH_TRACE_H__ */
+/** @} */
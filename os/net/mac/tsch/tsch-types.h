@@ -75,6 +75,12 @@ struct tsch_link {
   uint8_t link_options;
   
   uint8_t reserved;
+  /* Generation of the first schedule view built without this link, once
+   * it has been removed. Used to tell when slot operation is done with it. */
+  uint16_t retired_generation;
+  /* Neighbor queue of addr, cached by tsch_queue_get_nbr_for_link so that
+   * slot operation does not look it up. NULL until then. */
+  struct tsch_neighbor *nbr;
   /* Type of link. NORMAL = 0. ADVERTISING = 1, and indicates
      the link may be used to send an Enhanced beacon. */
   enum link_type link_type;
@@ -93,6 +99,18 @@ struct tsch_slotframe {
   struct tsch_asn_divisor_t size;
   /* List of links belonging to this slotframe */
   LIST_STRUCT(links_list);
+  /* Timeslot index, kept in sync with links_list by tsch-schedule.c.
+   * Only used when size.val <= TSCH_SCHEDULE_INDEX_MAX_LENGTH.
+   * Bit n of occupied is set iff timeslot n holds a link. */
+  uint32_t occupied[TSCH_SCHEDULE_INDEX_WORDS];
+  /* The link installed at each timeslot (at most one per timeslot) */
+  struct tsch_link *timeslot_links[TSCH_SCHEDULE_INDEX_MAX_LENGTH];
+};
+
+/** \brief Classes of the per-neighbor transmit queues, in decreasing priority */
+enum tsch_queue_class {
+  TSCH_QUEUE_CLASS_CONTROL, /* 6P and RPL */
+  TSCH_QUEUE_CLASS_DATA,
 };
 
 /** \brief TSCH packet information */
@@ -105,6 +123,11 @@ struct tsch_packet {
   uint8_t ret; /* status -- MAC return code */
   uint8_t header_len; /* length of header and header IEs (needed for link-layer security) */
   uint8_t tsch_sync_ie_offset; /* Offset within the frame used for quick update of EB ASN and join priority */
+  uint8_t queue_class; /* enum tsch_queue_class, the queue holding the packet */
+#if TSCH_QUEUE_WITH_DEADLINES
+  uint8_t has_deadline; /* is deadline set? */
+  struct tsch_asn_t deadline; /* ASN after which the packet is dropped */
+#endif /* TSCH_QUEUE_WITH_DEADLINES */
 };
 
 /** \brief TSCH neighbor information */
@@ -125,11 +148,14 @@ struct tsch_neighbor {
     uint8_t is_child;
   ////////////////////////////////////////////////////////////////
   
-  /* Array for the ringbuf. Contains pointers to packets.
+  /* Array for the ringbuf of data packets. Contains pointers to packets.
    * Its size must be a power of two to allow for atomic put */
   struct tsch_packet *tx_array[TSCH_QUEUE_NUM_PER_NEIGHBOR];
-  /* Circular buffer of pointers to packet. */
+  /* Circular buffer of pointers to data packets. */
   struct ringbufindex tx_ringbuf;
+  /* Same for control packets, served before data packets */
+  struct tsch_packet *tx_control_array[TSCH_QUEUE_NUM_CONTROL_PER_NEIGHBOR];
+  struct ringbufindex tx_control_ringbuf;
 };
 
 /** \brief TSCH timeslot timing elements. Used to index timeslot timing
@@ -158,7 +184,7 @@ typedef uint16_t tsch_timeslot_timing_usec[tsch_ts_elements_count];
 
 /** \brief Stores data about an incoming packet */
 struct input_packet {
-  uint8_t payload[TSCH_PACKET_MAX_LEN]; /* Packet payload */
+  uint8_t *payload; /* Packet payload, a buffer of TSCH_PACKET_MAX_LEN bytes */
   struct tsch_asn_t rx_asn; /* ASN when the packet was received */
   int len; /* Packet len */
   int16_t rssi; /* RSSI for this packet */
@@ -111,10 +111,6 @@ int current_number_slots_for_packet_generation=0;
 
 int allocate_slot_for_packet_generation=0;
 int check_ask_uplink=1;
-int need_send_back=0;
-linkaddr_t send_back_address[5];
-int send_back_number_links[5];
-sf_simple_cell_t cell_list_reserved[8];
 
 
 /* Default TSCH timeslot timing (in micro-second) */
@@ -188,53 +184,6 @@ PROCESS(tsch_pending_events_process, "pending events process");
 static void packet_input(void);
 
 /* Getters and setters */
-int add_to_cell_list_reserved(uint16_t time_offset, uint16_t channel_offset)
-{
-    int i=0;
-    for(i=0;i< 8; i++)
-    {
-        if (cell_list_reserved[i].channel_offset==0 && cell_list_reserved[i].timeslot_offset==0)
-        {
-            cell_list_reserved[i].channel_offset=channel_offset;
-            cell_list_reserved[i].timeslot_offset=time_offset;
-            return 1;
-        }
-    }
-    
-    
-    return 0;
-}
-
-int find_in_cell_list_reserved(uint16_t time_offset, uint16_t channel_offset)
-{
-    int i=0;
-    for(i=0;i< 8; i++)
-    {
-        if (cell_list_reserved[i].channel_offset==channel_offset && cell_list_reserved[i].timeslot_offset==time_offset)
-        {
-            return 1;
-        }
-    }
-    return 0;
-}
-
-
-int delete_from_cell_list_reserved(uint16_t time_offset, uint16_t channel_offset)
-{
-    int i=0;
-    for(i=0;i< 8; i++)
-    {
-        if (cell_list_reserved[i].channel_offset==channel_offset && cell_list_reserved[i].timeslot_offset==time_offset)
-        {
-            cell_list_reserved[i].channel_offset=0;
-            cell_list_reserved[i].timeslot_offset=0;
-            return 1;
-        }
-    }
-    return -1;
-}
-
-
 int convert_rate_to_slots(float rate)
 {
     if(rate<=1)
@@ -297,54 +246,6 @@ float convert_slots_to_rate(int slots)
     }
 }
 
-int find_free_place_in_send_back()
-{
-    int i=0;
-    for(i=0;i< 5; i++)
-    {
-        if(send_back_number_links[i] == 0)
-        {
-            return i;
-        }
-    }
-    return -1;
-}
-
-int find_first_place_in_send_back()
-{
-    int i=0;
-    for(i=0;i< 5; i++)
-    {
-        if(send_back_number_links[i] != 0)
-        {
-            return i;
-        }
-    }
-    need_send_back=0;
-    return -1;
-}
-
-int find_in_send_back_by_address(const linkaddr_t* in)
-{
-     int i=0;
-    for(i=0;i< 5; i++)
-    {
-        if(linkaddr_cmp(in, &send_back_address[i]))
-        {
-            if( send_back_number_links[i] > 0 )
-            {
-                  return i;
-            }
-            else
-            {
-                return -1;
-            }
-          
-        }
-    }
-   
-    return -1;
-}
 /*---------------------------------------------------------------------------*/
 void
 tsch_set_coordinator(int enable)
@@ -576,8 +477,12 @@ int find_shared_timeslot_children()
      }
        struct tsch_link *l;                                            
      int i;    
-  struct tsch_slotframe *sf_min =  tsch_schedule_get_slotframe_by_handle(0);                                
-     for(i=TSCH_SCHEDULE_CONF_DEFAULT_LENGTH-1;i>0;i--)
+  struct tsch_slotframe *sf_min =  tsch_schedule_get_slotframe_by_handle(TSCH_SCHEDULE_GT_SHARED_HANDLE);                                
+     if(sf_min == NULL)
+     {
+         return 0;
+     }
+     for(i=sf_min->size.val-1;i>0;i--)
     {
         l = tsch_schedule_get_link_by_just_timeslot(sf_min ,i); 
         if(l ==NULL)
@@ -656,6 +561,9 @@ eb_input(struct input_packet *current_input)
     /* Did the EB come from our time source? */
 
 
+    /* Learn which channel offset the sender's children use */
+    tsch_coloring_heard((linkaddr_t *)&frame.src_addr, eb_ies.frequency_offset);
+
 //dtsf////////////////////////////////////////////////////////////////////////////////
 
 if(check_shared_timeslot==0)
@@ -678,7 +586,7 @@ if(check_shared_timeslot==0)
                        shared_timeslot_parent=eb_ies.shared_timeslot;
                        if(parent_channel!=0 && shared_timeslot_parent!=0 && children_channel!=0)
                        {
-                           struct tsch_slotframe *sf_min  = tsch_schedule_get_slotframe_by_handle(0);
+                           struct tsch_slotframe *sf_min  = tsch_schedule_get_slotframe_by_handle(TSCH_SCHEDULE_GT_SHARED_HANDLE);
                            tsch_schedule_add_link(sf_min, (LINK_OPTION_RX | LINK_OPTION_TX | LINK_OPTION_SHARED), LINK_TYPE_NORMAL, &tsch_broadcast_address,shared_timeslot_parent, parent_channel);
                         //   printf("received shared timeslot %d  parent channel=%d\n",shared_timeslot_parent,parent_channel);
                            check_shared_timeslot=1;
@@ -759,8 +667,9 @@ tsch_rx_process_pending()
 
     if(is_data) {
       /* Skip EBs and other control messages */
-      /* Copy to packetbuf for processing */
-      packetbuf_copyfrom(current_input->payload, current_input->len);
+      /* Hand over to packetbuf for processing, the entry takes the
+       * previous packetbuf storage in exchange */
+      current_input->payload = packetbuf_exchange(current_input->payload, current_input->len);
       packetbuf_set_attr(PACKETBUF_ATTR_RSSI, current_input->rssi);
       packetbuf_set_attr(PACKETBUF_ATTR_CHANNEL, current_input->channel);
     }
@@ -787,7 +696,8 @@ tsch_tx_process_pending(void)
   while((dequeued_index = ringbufindex_peek_get(&dequeued_ringbuf)) != -1) {
     struct tsch_packet *p = dequeued_array[dequeued_index];
     /* Put packet into packetbuf for packet_sent callback */
-    queuebuf_to_packetbuf(p->qb);
+    queuebuf_move_to_packetbuf(p->qb);
+    p->qb = NULL;
     LOG_INFO("packet sent to ");
     LOG_INFO_LLADDR(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
     LOG_INFO_(", seqno %u, status %d, tx %d\n",
@@ -1034,11 +944,13 @@ PT_THREAD(tsch_scan(struct pt *pt))
   PT_BEGIN(pt);
 
   static struct input_packet input_eb;
+  static uint32_t input_eb_frame[(TSCH_PACKET_MAX_LEN + 3) / 4];
   static struct etimer scan_timer;
   /* Time when we started scanning on current_channel */
   static clock_time_t current_channel_since;
 
   TSCH_ASN_INIT(tsch_current_asn, 0, 0);
+  input_eb.payload = (uint8_t *)input_eb_frame;
 
   etimer_set(&scan_timer, CLOCK_SECOND / TSCH_ASSOCIATION_POLL_FREQUENCY);
   current_channel_since = clock_time();
@@ -1227,6 +1139,7 @@ PROCESS_THREAD(tsch_pending_events_process, ev, data)
     tsch_rx_process_pending();
     tsch_tx_process_pending();
     tsch_log_process_pending();
+    tsch_trace_process_pending();
     tsch_keepalive_process_pending();
 #ifdef TSCH_CALLBACK_SELECT_CHANNELS
     TSCH_CALLBACK_SELECT_CHANNELS();
@@ -1305,10 +1218,13 @@ tsch_init(void)
 
   /* Init TSCH sub-modules */
   tsch_reset();
+  tsch_trace_init();
   tsch_queue_init();
   tsch_schedule_init();
+  tsch_ledger_init();
+  tsch_coloring_init();
   tsch_log_init();
-  ringbufindex_init(&input_ringbuf, TSCH_MAX_INCOMING_PACKETS);
+  tsch_slot_operation_init();
   ringbufindex_init(&dequeued_ringbuf, TSCH_DEQUEUED_ARRAY_SIZE);
 #if TSCH_AUTOSELECT_TIME_SOURCE
   nbr_table_register(sync_stats, NULL);
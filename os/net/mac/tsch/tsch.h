@@ -61,6 +61,9 @@ frequency hopping for enhanced reliability.
 #include "net/mac/tsch/tsch-security.h"
 #include "net/mac/tsch/tsch-schedule.h"
 #include "net/mac/tsch/tsch-stats.h"
+#include "net/mac/tsch/tsch-ledger.h"
+#include "net/mac/tsch/tsch-coloring.h"
+#include "net/mac/tsch/tsch-trace.h"
 #if UIP_CONF_IPV6_RPL
 #include "net/mac/tsch/tsch-rpl.h"
 #endif /* UIP_CONF_IPV6_RPL */
@@ -168,6 +171,8 @@ extern const linkaddr_t tsch_eb_address;
 extern struct tsch_asn_t tsch_current_asn;
 extern uint8_t tsch_join_priority;
 extern struct tsch_link *current_link;
+/* The Rx link overlapping with current_link, run if current_link has nothing to send */
+extern struct tsch_link *backup_link;
 /* If we are inside a slot, this tells the current channel */
 extern uint8_t tsch_current_channel;
 /* TSCH channel hopping sequence */
@@ -189,15 +194,8 @@ extern int current_number_slots_for_packet_generation;
 //extern struct etimer start_timer;
 
 extern int check_ask_uplink;
-extern linkaddr_t send_back_address[5];
-extern int send_back_number_links[5];
-
-extern int need_send_back;
 extern int allocate_slot_for_packet_generation;
 
-
-extern sf_simple_cell_t cell_list_reserved[8];
-
 /////////////////////////////////////////////
 
 extern struct tsch_asn_divisor_t tsch_hopping_sequence_length;
@@ -213,6 +211,21 @@ extern int32_t min_drift_seen;
 extern int32_t max_drift_seen;
 /* The TSCH standard 10ms timeslot timing */
 extern const tsch_timeslot_timing_usec tsch_timeslot_timing_us_10000;
+/* A 15ms timeslot timing, for platforms too slow for the 10ms one */
+extern const tsch_timeslot_timing_usec tsch_timeslot_timing_us_15000;
+/* All validated timeslot timing templates, shortest first, NULL-terminated */
+extern const uint16_t *const tsch_timeslot_timing_templates[];
+
+#if TSCH_STATS_SLOT_TIMING
+/**
+ * \brief Timeslot timing calibration: picks the shortest template that
+ * leaves room, with TSCH_TIMING_CALIBRATION_MARGIN, for each phase of slot
+ * operation as measured so far on this platform. All nodes of a network
+ * must share one template: use the result as TSCH_CONF_DEFAULT_TIMESLOT_TIMING.
+ * \return The template, NULL if too few slots were measured or none fits
+ */
+const uint16_t *tsch_timing_calibrate(void);
+#endif /* TSCH_STATS_SLOT_TIMING */
 
 /* TSCH processes */
 PROCESS_NAME(tsch_process);
@@ -233,18 +246,6 @@ int convert_rate_to_slots(float rate);
 
 float convert_slots_to_rate(int slots);
 
-int add_to_cell_list_reserved(uint16_t time_offset, uint16_t channel_offset);
-
-int find_in_cell_list_reserved(uint16_t time_offset, uint16_t channel_offset);
-
-int delete_from_cell_list_reserved(uint16_t time_offset, uint16_t channel_offset);
-
-int find_free_place_in_send_back();
-
-int find_first_place_in_send_back();
-
-int find_in_send_back_by_address(const linkaddr_t* in);
-
 int find_shared_timeslot_children();
 
 
@@ -38,6 +38,7 @@
 #include <string.h>
 #include "lib/memb.h"
 #include "lib/list.h"
+#include "lib/probe-hash.h"
 #include "net/nbr-table.h"
 
 #define DEBUG 0
@@ -83,6 +84,36 @@ static unsigned num_tables;
 MEMB(neighbor_addr_mem, nbr_table_key_t, NBR_TABLE_MAX_NEIGHBORS);
 LIST(nbr_table_keys);
 
+#if (NBR_TABLE_HASH_SIZE & (NBR_TABLE_HASH_SIZE - 1)) != 0
+#error NBR_TABLE_HASH_SIZE must be power of two
+#endif
+#if NBR_TABLE_HASH_SIZE <= NBR_TABLE_MAX_NEIGHBORS
+#error NBR_TABLE_HASH_SIZE must be larger than NBR_TABLE_MAX_NEIGHBORS
+#endif
+
+/* A neighbor index plus one, 0 meaning none, so that the zero-initialized
+ * tables below start out empty */
+#if NBR_TABLE_MAX_NEIGHBORS < 0xff
+typedef uint8_t nbr_ref_t;
+#else
+typedef uint16_t nbr_ref_t;
+#endif
+#define REF_FROM_INDEX(index) ((nbr_ref_t)((index) + 1))
+#define INDEX_FROM_REF(ref) ((int)(ref) - 1)
+
+/* Index of nbr_table_keys by link-layer address: open addressing with
+ * linear probing */
+static nbr_ref_t lladdr_hash[NBR_TABLE_HASH_SIZE];
+#define LLADDR_HASH_NEXT(i) PROBE_HASH_NEXT(i, NBR_TABLE_HASH_SIZE)
+
+/* The keys of nbr_table_keys from least to most recently used, for
+ * eviction. Kept apart from nbr_table_keys so that looking up a neighbor
+ * does not reorder table iterations. */
+static nbr_ref_t lru_prev[NBR_TABLE_MAX_NEIGHBORS];
+static nbr_ref_t lru_next[NBR_TABLE_MAX_NEIGHBORS];
+static nbr_ref_t lru_head;
+static nbr_ref_t lru_tail;
+
 /*---------------------------------------------------------------------------*/
 /* Get a key from a neighbor index */
 static nbr_table_key_t *
@@ -126,22 +157,104 @@ key_from_item(nbr_table_t *table, const nbr_table_item_t *item)
   return key_from_index(index_from_item(table, item));
 }
 /*---------------------------------------------------------------------------*/
+/* Home bucket of a link-layer address */
+static uint16_t
+lladdr_hash_bucket(const linkaddr_t *lladdr)
+{
+  return probe_hash_bytes(lladdr->u8, LINKADDR_SIZE, NBR_TABLE_HASH_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+lladdr_hash_add(int index)
+{
+  uint16_t i = lladdr_hash_bucket(&key_from_index(index)->lladdr);
+  while(lladdr_hash[i] != 0) {
+    i = LLADDR_HASH_NEXT(i);
+  }
+  lladdr_hash[i] = REF_FROM_INDEX(index);
+}
+/*---------------------------------------------------------------------------*/
+/* Removes a neighbor, shifting back the entries that probed past it so that
+ * no tombstone is needed */
+static void
+lladdr_hash_remove(int index)
+{
+  uint16_t i = lladdr_hash_bucket(&key_from_index(index)->lladdr);
+  uint16_t j;
+  while(lladdr_hash[i] != REF_FROM_INDEX(index)) {
+    if(lladdr_hash[i] == 0) {
+      return;
+    }
+    i = LLADDR_HASH_NEXT(i);
+  }
+  lladdr_hash[i] = 0;
+  for(j = LLADDR_HASH_NEXT(i); lladdr_hash[j] != 0; j = LLADDR_HASH_NEXT(j)) {
+    uint16_t k = lladdr_hash_bucket(&key_from_index(INDEX_FROM_REF(lladdr_hash[j]))->lladdr);
+    if(probe_hash_can_fill(i, j, k)) {
+      lladdr_hash[i] = lladdr_hash[j];
+      lladdr_hash[j] = 0;
+      i = j;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+lru_remove(int index)
+{
+  nbr_ref_t prev = lru_prev[index];
+  nbr_ref_t next = lru_next[index];
+  if(prev != 0) {
+    lru_next[INDEX_FROM_REF(prev)] = next;
+  } else {
+    lru_head = next;
+  }
+  if(next != 0) {
+    lru_prev[INDEX_FROM_REF(next)] = prev;
+  } else {
+    lru_tail = prev;
+  }
+  lru_prev[index] = 0;
+  lru_next[index] = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+lru_add(int index)
+{
+  lru_prev[index] = lru_tail;
+  lru_next[index] = 0;
+  if(lru_tail != 0) {
+    lru_next[INDEX_FROM_REF(lru_tail)] = REF_FROM_INDEX(index);
+  } else {
+    lru_head = REF_FROM_INDEX(index);
+  }
+  lru_tail = REF_FROM_INDEX(index);
+}
+/*---------------------------------------------------------------------------*/
+/* Marks a neighbor as the most recently used */
+static void
+lru_touch(int index)
+{
+  if(lru_tail != REF_FROM_INDEX(index)) {
+    lru_remove(index);
+    lru_add(index);
+  }
+}
+/*---------------------------------------------------------------------------*/
 /* Get the index of a neighbor from its link-layer address */
 static int
 index_from_lladdr(const linkaddr_t *lladdr)
 {
-  nbr_table_key_t *key;
+  uint16_t i;
   /* Allow lladdr-free insertion, useful e.g. for IPv6 ND.
    * Only one such entry is possible at a time, indexed by linkaddr_null. */
   if(lladdr == NULL) {
     lladdr = &linkaddr_null;
   }
-  key = list_head(nbr_table_keys);
-  while(key != NULL) {
-    if(lladdr && linkaddr_cmp(lladdr, &key->lladdr)) {
-      return index_from_key(key);
+  for(i = lladdr_hash_bucket(lladdr); lladdr_hash[i] != 0; i = LLADDR_HASH_NEXT(i)) {
+    int index = INDEX_FROM_REF(lladdr_hash[i]);
+    if(linkaddr_cmp(lladdr, &key_from_index(index)->lladdr)) {
+      return index;
     }
-    key = list_item_next(key);
   }
   return -1;
 }
@@ -193,7 +306,9 @@ remove_key(nbr_table_key_t *least_used_key)
   }
   /* Empty used map */
   used_map[index_from_key(least_used_key)] = 0;
-  /* Remove neighbor from list */
+  /* Remove neighbor from list and indices */
+  lladdr_hash_remove(index_from_key(least_used_key));
+  lru_remove(index_from_key(least_used_key));
   list_remove(nbr_table_keys, least_used_key);
 }
 /*---------------------------------------------------------------------------*/
@@ -236,10 +351,10 @@ nbr_table_allocate(nbr_table_reason_t reason, void *data)
        * The replacement policy is the following: remove neighbor that is:
        * (1) not locked
        * (2) used by fewest tables
-       * (3) oldest (the list is ordered by insertion time)
+       * (3) least recently used
        * */
-      /* Get item from first key */
-      key = list_head(nbr_table_keys);
+      /* Get item from least recently used key */
+      key = key_from_index(INDEX_FROM_REF(lru_head));
       while(key != NULL) {
         int item_index = index_from_key(key);
         int locked = locked_map[item_index];
@@ -263,7 +378,7 @@ nbr_table_allocate(nbr_table_reason_t reason, void *data)
             }
           }
         }
-        key = list_item_next(key);
+        key = key_from_index(INDEX_FROM_REF(lru_next[item_index]));
       }
     }
 
@@ -381,6 +496,10 @@ nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lladdr, nbr_table_rea
 
     /* Set link-layer address */
     linkaddr_copy(&key->lladdr, lladdr);
+    lladdr_hash_add(index);
+    lru_add(index);
+  } else {
+    lru_touch(index);
   }
 
   /* Get item in the current table */
@@ -400,8 +519,13 @@ nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lladdr, nbr_table_rea
 void *
 nbr_table_get_from_lladdr(nbr_table_t *table, const linkaddr_t *lladdr)
 {
-  void *item = item_from_index(table, index_from_lladdr(lladdr));
-  return nbr_get_bit(used_map, table, item) ? item : NULL;
+  int index = index_from_lladdr(lladdr);
+  void *item = item_from_index(table, index);
+  if(nbr_get_bit(used_map, table, item)) {
+    lru_touch(index);
+    return item;
+  }
+  return NULL;
 }
 /*---------------------------------------------------------------------------*/
 /* Removes a neighbor from the current table (unset "used" bit) */
@@ -58,7 +58,8 @@ static uint8_t hdrlen;
 /* The declarations below ensure that the packet buffer is aligned on
    an even 32-bit boundary. On some platforms (most notably the
    msp430 or OpenRISC), having a potentially misaligned packet buffer may lead to
-   problems when accessing words. */
+   problems when accessing words. packetbuf_exchange() may replace this
+   storage with other buffers of the same size and alignment. */
 static uint32_t packetbuf_aligned[(PACKETBUF_SIZE + 3) / 4];
 static uint8_t *packetbuf = (uint8_t *)packetbuf_aligned;
 
@@ -92,6 +93,18 @@ packetbuf_copyfrom(const void *from, uint16_t len)
   return l;
 }
 /*---------------------------------------------------------------------------*/
+uint8_t *
+packetbuf_exchange(uint8_t *buf, uint16_t len)
+{
+  uint8_t *old;
+
+  packetbuf_clear();
+  old = packetbuf;
+  packetbuf = buf;
+  buflen = MIN(PACKETBUF_SIZE, len);
+  return old;
+}
+/*---------------------------------------------------------------------------*/
 int
 packetbuf_copyto(void *to)
 {
@@ -106,16 +119,12 @@ packetbuf_copyto(void *to)
 int
 packetbuf_hdralloc(int size)
 {
-  int16_t i;
-
   if(size + packetbuf_totlen() > PACKETBUF_SIZE) {
     return 0;
   }
 
   /* shift data to the right */
-  for(i = packetbuf_totlen() - 1; i >= 0; i--) {
-    packetbuf[i + size] = packetbuf[i];
-  }
+  memmove(packetbuf + size, packetbuf, packetbuf_totlen());
   hdrlen += size;
   return 1;
 }
@@ -146,6 +146,22 @@ void packetbuf_set_datalen(uint16_t len);
  */
 int packetbuf_copyfrom(const void *from, uint16_t len);
 
+/**
+ * \brief      Exchange the packetbuf storage with an external buffer
+ * \param buf  A buffer holding a frame, of PACKETBUF_SIZE bytes and
+ *             aligned as the packetbuf
+ * \param len  The length of the frame in buf
+ * \retval     The previous storage of the packetbuf
+ *
+ *             This function has the effect of packetbuf_copyfrom(buf,
+ *             len), without copying: buf becomes the packetbuf, and the
+ *             buffer that held the packetbuf until now is returned for
+ *             the caller to use in place of buf. Pointers into the
+ *             packetbuf obtained before the call must not be used after.
+ *
+ */
+uint8_t *packetbuf_exchange(uint8_t *buf, uint16_t len);
+
 /**
  * \brief      Copy the entire packetbuf to an external buffer
  * \param to   A pointer to the buffer to which the data is to be copied
@@ -229,6 +245,9 @@ enum {
   PACKETBUF_ATTR_TSCH_TIMESLOT,
   PACKETBUF_ATTR_TSCH_CHANNEL_OFFSET,
 #endif /* TSCH_WITH_LINK_SELECTOR */
+#if TSCH_QUEUE_WITH_DEADLINES
+  PACKETBUF_ATTR_TSCH_LIFETIME,
+#endif /* TSCH_QUEUE_WITH_DEADLINES */
 
   /* Scope 1 attributes: used between two neighbors only. */
   PACKETBUF_ATTR_FRAME_TYPE,
@@ -73,7 +73,14 @@ struct queuebuf {
 
 /* The actual queuebuf data */
 struct queuebuf_data {
+#if WITH_SWAP
+  /* Swapped buffers are written to CFS in one piece: keep the frame inline */
   uint8_t data[PACKETBUF_SIZE];
+#else /* WITH_SWAP */
+  /* The frame, in one of frames[], or in a buffer exchanged with packetbuf
+     by queuebuf_move_to_packetbuf() */
+  uint8_t *data;
+#endif /* WITH_SWAP */
   uint16_t len;
   struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
   struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
@@ -81,6 +88,10 @@ struct queuebuf_data {
 
 MEMB(bufmem, struct queuebuf, QUEUEBUF_NUM);
 MEMB(buframmem, struct queuebuf_data, QUEUEBUFRAM_NUM);
+#if !WITH_SWAP
+/* Frame storage of the buffers of buframmem, aligned as packetbuf */
+static uint32_t frames[QUEUEBUFRAM_NUM][(PACKETBUF_SIZE + 3) / 4];
+#endif /* !WITH_SWAP */
 
 #if WITH_SWAP
 
@@ -280,8 +291,8 @@ queuebuf_load_to_ram(struct queuebuf *b)
 void
 queuebuf_init(void)
 {
-#if WITH_SWAP
   int i;
+#if WITH_SWAP
   for(i=0; i<NQBUF_FILES; i++) {
     qbuf_files[i].renewable = 1;
     qbuf_renew_file(i);
@@ -289,6 +300,11 @@ queuebuf_init(void)
 #endif
   memb_init(&buframmem);
   memb_init(&bufmem);
+#if !WITH_SWAP
+  for(i = 0; i < QUEUEBUFRAM_NUM; i++) {
+    ((struct queuebuf_data *)buframmem.mem)[i].data = (uint8_t *)frames[i];
+  }
+#endif /* !WITH_SWAP */
 #if QUEUEBUF_STATS
   queuebuf_max_len = 0;
 #endif /* QUEUEBUF_STATS */
@@ -426,6 +442,21 @@ queuebuf_to_packetbuf(struct queuebuf *b)
   }
 }
 /*---------------------------------------------------------------------------*/
+void
+queuebuf_move_to_packetbuf(struct queuebuf *b)
+{
+  if(memb_inmemb(&bufmem, b)) {
+#if WITH_SWAP
+    queuebuf_to_packetbuf(b);
+#else /* WITH_SWAP */
+    struct queuebuf_data *buframptr = b->ram_ptr;
+    buframptr->data = packetbuf_exchange(buframptr->data, buframptr->len);
+    packetbuf_attr_copyfrom(buframptr->attrs, buframptr->addrs);
+#endif /* WITH_SWAP */
+    queuebuf_free(b);
+  }
+}
+/*---------------------------------------------------------------------------*/
 void *
 queuebuf_dataptr(struct queuebuf *b)
 {
@@ -105,6 +105,9 @@ void queuebuf_update_attr_from_packetbuf(struct queuebuf *b);
 void queuebuf_update_from_packetbuf(struct queuebuf *b);
 
 void queuebuf_to_packetbuf(struct queuebuf *b);
+/* Same as queuebuf_to_packetbuf() followed by queuebuf_free(), but the
+   frame is handed over to packetbuf rather than copied */
+void queuebuf_move_to_packetbuf(struct queuebuf *b);
 void queuebuf_free(struct queuebuf *b);
 
 void *queuebuf_dataptr(struct queuebuf *b);
@@ -833,6 +833,55 @@ PT_THREAD(cmd_tsch_schedule(struct pt *pt, shell_output_func output, char *args)
   }
   PT_END(pt);
 }
+#if TSCH_STATS_SLOT_TIMING
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(cmd_tsch_timing(struct pt *pt, shell_output_func output, char *args))
+{
+  uint8_t phase;
+  uint8_t i;
+  char *next_args;
+
+  PT_BEGIN(pt);
+
+  SHELL_ARGS_INIT(args, next_args);
+
+  /* Get first arg (reset, optional) */
+  SHELL_ARGS_NEXT(args, next_args);
+
+  if(args != NULL && !strcmp(args, "reset")) {
+    tsch_stats_timing_reset();
+    SHELL_OUTPUT(output, "TSCH timing reset\n");
+    PT_EXIT(pt);
+  }
+
+  SHELL_OUTPUT(output, "TSCH timing (usec), timeslot %lu:\n",
+               (unsigned long)RTIMERTICKS_TO_US(tsch_timing[tsch_ts_timeslot_length]));
+  for(phase = 0; phase < tsch_stats_timing_phase_count; phase++) {
+    const struct tsch_stats_timing *s = tsch_stats_timing_get(phase);
+    SHELL_OUTPUT(output, "-- %s: count %lu", tsch_stats_timing_phase_name(phase), (unsigned long)s->count);
+    if(s->count > 0) {
+      SHELL_OUTPUT(output, ", min %lu, avg %lu, max %lu, histogram",
+                   (unsigned long)RTIMERTICKS_TO_US(s->min),
+                   (unsigned long)RTIMERTICKS_TO_US(s->sum / s->count),
+                   (unsigned long)RTIMERTICKS_TO_US(s->max));
+      for(i = 0; i < TSCH_STATS_TIMING_BUCKETS; i++) {
+        SHELL_OUTPUT(output, " %u", s->histogram[i]);
+      }
+    }
+    SHELL_OUTPUT(output, "\n");
+  }
+
+  if(tsch_timing_calibrate() != NULL) {
+    SHELL_OUTPUT(output, "-- Shortest safe timeslot template: %u usec\n",
+                 tsch_timing_calibrate()[tsch_ts_timeslot_length]);
+  } else {
+    SHELL_OUTPUT(output, "-- Shortest safe timeslot template: unknown yet\n");
+  }
+
+  PT_END(pt);
+}
+#endif /* TSCH_STATS_SLOT_TIMING */
 #endif /* MAC_CONF_WITH_TSCH */
 /*---------------------------------------------------------------------------*/
 #if TSCH_WITH_SIXTOP
@@ -1007,6 +1056,9 @@ const struct shell_command_t builtin_shell_commands[] = {
   { "tsch-set-coordinator", cmd_tsch_set_coordinator, "'> tsch-set-coordinator 0/1 [0/1]': Sets node as coordinator (1) or not (0). Second, optional parameter: enable (1) or disable (0) security." },
   { "tsch-schedule",        cmd_tsch_schedule,        "'> tsch-schedule': Shows the current TSCH schedule" },
   { "tsch-status",          cmd_tsch_status,          "'> tsch-status': Shows a summary of the current TSCH state" },
+#if TSCH_STATS_SLOT_TIMING
+  { "tsch-timing",          cmd_tsch_timing,          "'> tsch-timing [reset]': Shows (or resets) how long each phase of TSCH slot operation takes" },
+#endif /* TSCH_STATS_SLOT_TIMING */
 #endif /* MAC_CONF_WITH_TSCH */
 #if TSCH_WITH_SIXTOP
   { "6top",                 cmd_6top,                 "'> 6top help': Shows 6top command usage" },
@@ -49,10 +49,285 @@
 #include "sys/etimer.h"
 #include "sys/process.h"
 
-static struct etimer *timerlist;
 static clock_time_t next_expiration;
 
 PROCESS(etimer_process, "Event timer");
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+expiration_time(struct etimer *t)
+{
+  return t->timer.start + t->timer.interval;
+}
+/*---------------------------------------------------------------------------*/
+#if ETIMER_WITH_WHEEL
+/*
+ * Hierarchical timing wheel. Clock time is split into digits of WHEEL_BITS
+ * bits, and level l of the wheel has a slot per value of digit l. A timer
+ * is kept at the most significant digit where its expiration time differs
+ * from wheel_time, in the slot of its own digit there. When wheel_time
+ * reaches the start of a slot, its timers move down to lower levels, and
+ * end up in the expired list when wheel_time reaches their expiration
+ * time. The levels cover all digits of clock_time_t, so that wrap-arounds
+ * need no special case.
+ */
+#define WHEEL_BITS 4
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS ((sizeof(clock_time_t) * 8 + WHEEL_BITS - 1) / WHEEL_BITS)
+#define DIGIT(time, level) ((unsigned)((time) >> ((level) * WHEEL_BITS)) & (WHEEL_SLOTS - 1))
+
+/* The wheel slots, then the timers expired but not yet posted */
+static struct etimer *slots[WHEEL_LEVELS * WHEEL_SLOTS + 1];
+#define EXPIRED (WHEEL_LEVELS * WHEEL_SLOTS)
+/* For each level, a bitmap of the non-empty slots */
+static uint16_t occupied[WHEEL_LEVELS];
+static clock_time_t wheel_time;
+static unsigned num_timers;
+
+/*---------------------------------------------------------------------------*/
+/* Returns the link to a timer in the slot it is filed in, NULL if it is not
+ * in the wheel. The slot number of the timer is only a hint, checked by a
+ * walk of that slot: a timer never set, whatever its contents, is not
+ * mistaken for one in the wheel. */
+static struct etimer **
+find_link(struct etimer *t)
+{
+  struct etimer **l;
+
+  if(t->p == PROCESS_NONE || t->slot > EXPIRED) {
+    return NULL;
+  }
+  for(l = &slots[t->slot]; *l != NULL; l = &(*l)->next) {
+    if(*l == t) {
+      return l;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+slot_add(struct etimer *t, unsigned slot)
+{
+  t->next = slots[slot];
+  t->slot = slot;
+  slots[slot] = t;
+  if(slot != EXPIRED) {
+    occupied[slot / WHEEL_SLOTS] |= 1 << (slot % WHEEL_SLOTS);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Removes a timer from its slot, given the link to it */
+static void
+slot_remove(struct etimer *t, struct etimer **link)
+{
+  *link = t->next;
+  if(t->slot != EXPIRED && slots[t->slot] == NULL) {
+    /* Was the only timer of its slot */
+    occupied[t->slot / WHEEL_SLOTS] &= ~(1 << (t->slot % WHEEL_SLOTS));
+  }
+  t->next = NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Files a timer that expires at time, which is not before wheel_time */
+static void
+place(struct etimer *t, clock_time_t time)
+{
+  clock_time_t diff = time ^ wheel_time;
+  unsigned level = WHEEL_LEVELS - 1;
+
+  if(diff == 0) {
+    slot_add(t, EXPIRED);
+    return;
+  }
+  while(DIGIT(diff, level) == 0) {
+    level--;
+  }
+  if(DIGIT(time, level) < DIGIT(wheel_time, level)) {
+    /* Almost a whole clock period ahead: wait for the top level to come
+     * round */
+    level = WHEEL_LEVELS - 1;
+  }
+  slot_add(t, level * WHEEL_SLOTS + DIGIT(time, level));
+}
+/*---------------------------------------------------------------------------*/
+static unsigned
+lowest_bit(uint16_t bitmap)
+{
+  unsigned i = 0;
+  while((bitmap & 1) == 0) {
+    bitmap >>= 1;
+    i++;
+  }
+  return i;
+}
+/*---------------------------------------------------------------------------*/
+/* Finds the next slot that wheel_time will reach, and the time it does.
+ * Returns -1 if the wheel is empty. */
+static int
+next_slot(clock_time_t *time)
+{
+  unsigned level;
+  for(level = 0; level < WHEEL_LEVELS; level++) {
+    /* Slots after the current digit. Those before it can only be used at
+     * the top level, by timers due after the clock wraps around. */
+    uint16_t later = occupied[level] & ~((2u << DIGIT(wheel_time, level)) - 1);
+    clock_time_t prefix;
+    if(later == 0) {
+      if(level < WHEEL_LEVELS - 1 || occupied[level] == 0) {
+        continue;
+      }
+      later = occupied[level];
+    }
+    /* Slots of lower levels all come before those of higher levels */
+    prefix = level < WHEEL_LEVELS - 1
+      ? wheel_time >> ((level + 1) * WHEEL_BITS) << ((level + 1) * WHEEL_BITS) : 0;
+    *time = prefix | (clock_time_t)lowest_bit(later) << (level * WHEEL_BITS);
+    return level * WHEEL_SLOTS + lowest_bit(later);
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+/* Moves wheel_time up to now, filing the timers of every slot reached on
+ * the way into lower levels or the expired list */
+static void
+advance(clock_time_t now)
+{
+  clock_time_t time;
+  int slot;
+
+  /* A slot exactly one clock period ahead has time == wheel_time, hence
+   * the - 1 */
+  while((slot = next_slot(&time)) >= 0
+        && (clock_time_t)(time - wheel_time - 1) < (clock_time_t)(now - wheel_time)) {
+    wheel_time = time;
+    while(slots[slot] != NULL) {
+      struct etimer *t = slots[slot];
+      slot_remove(t, &slots[slot]);
+      place(t, expiration_time(t));
+    }
+  }
+  wheel_time = now;
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_time(void)
+{
+  clock_time_t time;
+  int slot;
+
+  if(num_timers == 0) {
+    next_expiration = 0;
+  } else if(slots[EXPIRED] != NULL) {
+    next_expiration = expiration_time(slots[EXPIRED]);
+  } else if((slot = next_slot(&time)) < WHEEL_SLOTS) {
+    /* Level 0: all timers of the slot expire at its time */
+    next_expiration = time;
+  } else {
+    /* The earliest timer is in the first slot to be reached */
+    struct etimer *t;
+    clock_time_t tdist = expiration_time(slots[slot]) - wheel_time;
+    for(t = slots[slot]->next; t != NULL; t = t->next) {
+      if((clock_time_t)(expiration_time(t) - wheel_time) < tdist) {
+        tdist = expiration_time(t) - wheel_time;
+      }
+    }
+    next_expiration = wheel_time + tdist;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_to_backend(struct etimer *timer)
+{
+  struct etimer **link = find_link(timer);
+  int was_linked = link != NULL;
+
+  if(was_linked) {
+    slot_remove(timer, link);
+  } else {
+    num_timers++;
+  }
+
+  /* Times are filed relative to wheel_time: bring it to now, so that any
+   * interval fits in a clock period */
+  advance(clock_time());
+
+  timer->p = PROCESS_CURRENT();
+  if(timer_expired(&timer->timer)) {
+    slot_add(timer, EXPIRED);
+  } else {
+    place(timer, expiration_time(timer));
+  }
+
+  if(was_linked || num_timers == 1 || slots[EXPIRED] != NULL) {
+    update_time();
+  } else if((clock_time_t)(expiration_time(timer) - wheel_time)
+            < (clock_time_t)(next_expiration - wheel_time)) {
+    next_expiration = expiration_time(timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_from_backend(struct etimer *et)
+{
+  struct etimer **link = find_link(et);
+
+  if(link != NULL) {
+    slot_remove(et, link);
+    num_timers--;
+    update_time();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_process_timers(struct process *p)
+{
+  unsigned slot;
+  for(slot = 0; slot <= EXPIRED; slot++) {
+    struct etimer **link = &slots[slot];
+    while(*link != NULL) {
+      struct etimer *t = *link;
+      if(t->p == p) {
+        slot_remove(t, link);
+        t->p = PROCESS_NONE;
+        num_timers--;
+      } else {
+        link = &t->next;
+      }
+    }
+  }
+  update_time();
+}
+/*---------------------------------------------------------------------------*/
+static void
+post_expired(void)
+{
+  advance(clock_time());
+
+  while(slots[EXPIRED] != NULL) {
+    struct etimer *t = slots[EXPIRED];
+    if(process_post(t->p, PROCESS_EVENT_TIMER, t) != PROCESS_ERR_OK) {
+      etimer_request_poll();
+      break;
+    }
+    /* Reset the process ID of the event timer, to signal that the
+       etimer has expired. This is later checked in the
+       etimer_expired() function. */
+    t->p = PROCESS_NONE;
+    slot_remove(t, &slots[EXPIRED]);
+    num_timers--;
+  }
+  update_time();
+}
+/*---------------------------------------------------------------------------*/
+static int
+backend_pending(void)
+{
+  return num_timers != 0;
+}
+/*---------------------------------------------------------------------------*/
+#else /* ETIMER_WITH_WHEEL */
+
+static struct etimer *timerlist;
+
 /*---------------------------------------------------------------------------*/
 static void
 update_time(void)
@@ -67,74 +342,142 @@ update_time(void)
     now = clock_time();
     t = timerlist;
     /* Must calculate distance to next time into account due to wraps */
-    tdist = t->timer.start + t->timer.interval - now;
+    tdist = expiration_time(t) - now;
     for(t = t->next; t != NULL; t = t->next) {
-      if(t->timer.start + t->timer.interval - now < tdist) {
-        tdist = t->timer.start + t->timer.interval - now;
+      if((clock_time_t)(expiration_time(t) - now) < tdist) {
+        tdist = expiration_time(t) - now;
       }
     }
     next_expiration = now + tdist;
   }
 }
 /*---------------------------------------------------------------------------*/
-PROCESS_THREAD(etimer_process, ev, data)
+static void
+add_to_backend(struct etimer *timer)
 {
-  struct etimer *t, *u;
+  struct etimer *t;
 
-  PROCESS_BEGIN();
+  if(timer->p != PROCESS_NONE) {
+    for(t = timerlist; t != NULL; t = t->next) {
+      if(t == timer) {
+        /* Timer already on list, bail out. */
+        timer->p = PROCESS_CURRENT();
+        update_time();
+        return;
+      }
+    }
+  }
 
-  timerlist = NULL;
+  /* Timer not on list. */
+  timer->p = PROCESS_CURRENT();
+  timer->next = timerlist;
+  timerlist = timer;
 
-  while(1) {
-    PROCESS_YIELD();
+  update_time();
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_from_backend(struct etimer *et)
+{
+  struct etimer *t;
 
-    if(ev == PROCESS_EVENT_EXITED) {
-      struct process *p = data;
+  /* First check if et is the first event timer on the list. */
+  if(et == timerlist) {
+    timerlist = timerlist->next;
+    update_time();
+  } else {
+    /* Else walk through the list and try to find the item before the
+       et timer. */
+    for(t = timerlist; t != NULL && t->next != et; t = t->next) {
+    }
 
-      while(timerlist != NULL && timerlist->p == p) {
-        timerlist = timerlist->next;
-      }
+    if(t != NULL) {
+      /* We've found the item before the event timer that we are about
+         to remove. We point the items next pointer to the event after
+         the removed item. */
+      t->next = et->next;
 
-      if(timerlist != NULL) {
-        t = timerlist;
-        while(t->next != NULL) {
-          if(t->next->p == p) {
-            t->next = t->next->next;
-          } else {
-            t = t->next;
-          }
-        }
-      }
-      continue;
-    } else if(ev != PROCESS_EVENT_POLL) {
-      continue;
+      update_time();
     }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_process_timers(struct process *p)
+{
+  struct etimer *t;
 
-again:
+  while(timerlist != NULL && timerlist->p == p) {
+    timerlist = timerlist->next;
+  }
 
-    u = NULL;
+  if(timerlist != NULL) {
+    t = timerlist;
+    while(t->next != NULL) {
+      if(t->next->p == p) {
+        t->next = t->next->next;
+      } else {
+        t = t->next;
+      }
+    }
+  }
+  update_time();
+}
+/*---------------------------------------------------------------------------*/
+static void
+post_expired(void)
+{
+  struct etimer *t, *u, *next;
 
-    for(t = timerlist; t != NULL; t = t->next) {
-      if(timer_expired(&t->timer)) {
-        if(process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK) {
-
-          /* Reset the process ID of the event timer, to signal that the
-             etimer has expired. This is later checked in the
-             etimer_expired() function. */
-          t->p = PROCESS_NONE;
-          if(u != NULL) {
-            u->next = t->next;
-          } else {
-            timerlist = t->next;
-          }
-          t->next = NULL;
-          update_time();
-          goto again;
+  /* A single pass: posting an event does not change the list */
+  u = NULL;
+  for(t = timerlist; t != NULL; t = next) {
+    next = t->next;
+    if(timer_expired(&t->timer)) {
+      if(process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK) {
+
+        /* Reset the process ID of the event timer, to signal that the
+           etimer has expired. This is later checked in the
+           etimer_expired() function. */
+        t->p = PROCESS_NONE;
+        if(u != NULL) {
+          u->next = next;
         } else {
-          etimer_request_poll();
+          timerlist = next;
         }
+        t->next = NULL;
+        continue;
+      } else {
+        etimer_request_poll();
       }
-      u = t;
+    }
+    u = t;
+  }
+  update_time();
+}
+/*---------------------------------------------------------------------------*/
+static int
+backend_pending(void)
+{
+  return timerlist != NULL;
+}
+#endif /* ETIMER_WITH_WHEEL */
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(etimer_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+#if !ETIMER_WITH_WHEEL
+  timerlist = NULL;
+#endif /* !ETIMER_WITH_WHEEL */
+
+  while(1) {
+    PROCESS_YIELD();
+
+    if(ev == PROCESS_EVENT_EXITED) {
+      remove_process_timers(data);
+    } else if(ev == PROCESS_EVENT_POLL) {
+      post_expired();
     }
   }
 
@@ -150,27 +493,8 @@ etimer_request_poll(void)
 static void
 add_timer(struct etimer *timer)
 {
-  struct etimer *t;
-
   etimer_request_poll();
-
-  if(timer->p != PROCESS_NONE) {
-    for(t = timerlist; t != NULL; t = t->next) {
-      if(t == timer) {
-        /* Timer already on list, bail out. */
-        timer->p = PROCESS_CURRENT();
-        update_time();
-        return;
-      }
-    }
-  }
-
-  /* Timer not on list. */
-  timer->p = PROCESS_CURRENT();
-  timer->next = timerlist;
-  timerlist = timer;
-
-  update_time();
+  add_to_backend(timer);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -206,7 +530,16 @@ void
 etimer_adjust(struct etimer *et, int timediff)
 {
   et->timer.start += timediff;
+#if ETIMER_WITH_WHEEL
+  if(find_link(et) != NULL) {
+    /* Refile it under its new expiration time */
+    PROCESS_CONTEXT_BEGIN(et->p);
+    add_timer(et);
+    PROCESS_CONTEXT_END(et->p);
+  }
+#else /* ETIMER_WITH_WHEEL */
   update_time();
+#endif /* ETIMER_WITH_WHEEL */
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -218,7 +551,7 @@ etimer_expired(struct etimer *et)
 clock_time_t
 etimer_expiration_time(struct etimer *et)
 {
-  return et->timer.start + et->timer.interval;
+  return expiration_time(et);
 }
 /*---------------------------------------------------------------------------*/
 clock_time_t
@@ -230,7 +563,7 @@ etimer_start_time(struct etimer *et)
 int
 etimer_pending(void)
 {
-  return timerlist != NULL;
+  return backend_pending();
 }
 /*---------------------------------------------------------------------------*/
 clock_time_t
@@ -242,27 +575,7 @@ etimer_next_expiration_time(void)
 void
 etimer_stop(struct etimer *et)
 {
-  struct etimer *t;
-
-  /* First check if et is the first event timer on the list. */
-  if(et == timerlist) {
-    timerlist = timerlist->next;
-    update_time();
-  } else {
-    /* Else walk through the list and try to find the item before the
-       et timer. */
-    for(t = timerlist; t != NULL && t->next != et; t = t->next) {
-    }
-
-    if(t != NULL) {
-      /* We've found the item before the event timer that we are about
-         to remove. We point the items next pointer to the event after
-         the removed item. */
-      t->next = et->next;
-
-      update_time();
-    }
-  }
+  remove_from_backend(et);
 
   /* Remove the next pointer from the item to be removed. */
   et->next = NULL;
@@ -65,6 +65,19 @@
 
 #include "contiki.h"
 
+/*
+ * Backend keeping track of the event timers. By default, an unsorted list:
+ * adding, stopping and expiring a timer cost a walk of all timers. With
+ * ETIMER_CONF_WITH_WHEEL, a hierarchical timing wheel: these cost a walk
+ * of the timers due around the same time only. As with the list, a timer
+ * needs no initialisation before etimer_set() or etimer_stop().
+ */
+#ifdef ETIMER_CONF_WITH_WHEEL
+#define ETIMER_WITH_WHEEL ETIMER_CONF_WITH_WHEEL
+#else /* ETIMER_CONF_WITH_WHEEL */
+#define ETIMER_WITH_WHEEL 0
+#endif /* ETIMER_CONF_WITH_WHEEL */
+
 /**
  * A timer.
  *
@@ -77,6 +90,9 @@ struct etimer {
   struct timer timer;
   struct etimer *next;
   struct process *p;
+#if ETIMER_WITH_WHEEL
+  uint16_t slot;
+#endif /* ETIMER_WITH_WHEEL */
 };
 
 /**
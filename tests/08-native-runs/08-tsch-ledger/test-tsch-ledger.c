@@ -0,0 +1,268 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "unit-test.h"
+#include "net/mac/tsch/tsch.h"
+#include <stdio.h>
+
+PROCESS(test_process, "test");
+AUTOSTART_PROCESSES(&test_process);
+
+#define NUM_CHILDREN 4
+#define NUM_STEPS 5000
+
+static linkaddr_t children[NUM_CHILDREN];
+
+/*---------------------------------------------------------------------------*/
+static void
+init_children(void)
+{
+  int i;
+  for(i = 0; i < NUM_CHILDREN; i++) {
+    linkaddr_copy(&children[i], &linkaddr_null);
+    children[i].u8[0] = i + 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Reference answers, walking the entries of all children */
+static uint8_t
+scan_channel_users(uint8_t channel)
+{
+  uint8_t count = 0;
+  int i;
+  for(i = 0; i < NUM_CHILDREN; i++) {
+    struct tsch_ledger_entry *e = tsch_ledger_get(&children[i]);
+    if(e != NULL && e->channel == channel) {
+      count++;
+    }
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+static int
+scan_is_pending(uint16_t timeslot, uint16_t channel_offset)
+{
+  int i;
+  uint8_t j;
+  for(i = 0; i < NUM_CHILDREN; i++) {
+    struct tsch_ledger_entry *e = tsch_ledger_get(&children[i]);
+    for(j = 0; e != NULL && j < e->pending_count; j++) {
+      if(e->pending[j].timeslot_offset == timeslot
+         && e->pending[j].channel_offset == channel_offset) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+scan_owed_total(void)
+{
+  uint16_t total = 0;
+  int i;
+  for(i = 0; i < NUM_CHILDREN; i++) {
+    struct tsch_ledger_entry *e = tsch_ledger_get(&children[i]);
+    if(e != NULL) {
+      total += e->owed;
+    }
+  }
+  return total;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(ledger_channels, "Ledger channel counters");
+UNIT_TEST(ledger_channels)
+{
+  UNIT_TEST_BEGIN();
+
+  tsch_ledger_init();
+  UNIT_TEST_ASSERT(tsch_ledger_set_channel(&children[0], 1));
+  UNIT_TEST_ASSERT(tsch_ledger_set_channel(&children[1], 1));
+  UNIT_TEST_ASSERT(tsch_ledger_channel_users(1) == 2);
+  UNIT_TEST_ASSERT(tsch_ledger_set_channel(&children[1], 2));
+  UNIT_TEST_ASSERT(tsch_ledger_channel_users(1) == 1);
+  UNIT_TEST_ASSERT(tsch_ledger_channel_users(2) == 1);
+  UNIT_TEST_ASSERT(tsch_ledger_set_channel(&children[0], 0));
+  UNIT_TEST_ASSERT(tsch_ledger_channel_in_use(1) == 0);
+  UNIT_TEST_ASSERT(tsch_ledger_channel_in_use(0) == 0);
+  UNIT_TEST_ASSERT(tsch_ledger_channel_users(TSCH_HOPPING_SEQUENCE_MAX_LEN) == 0);
+
+  /* Dropping the entries must take them out of the counters */
+  tsch_ledger_init();
+  UNIT_TEST_ASSERT(tsch_ledger_channel_users(2) == 0);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(ledger_pending, "Ledger pending cell index");
+UNIT_TEST(ledger_pending)
+{
+  uint16_t i;
+
+  UNIT_TEST_BEGIN();
+
+  tsch_ledger_init();
+  /* A cell offered to two children stays pending until both answered */
+  UNIT_TEST_ASSERT(tsch_ledger_add_pending(&children[0], 10, 3));
+  UNIT_TEST_ASSERT(tsch_ledger_add_pending(&children[1], 10, 3));
+  UNIT_TEST_ASSERT(tsch_ledger_is_pending(10, 3));
+  UNIT_TEST_ASSERT(tsch_ledger_remove_pending(&children[0], 10, 3));
+  UNIT_TEST_ASSERT(tsch_ledger_is_pending(10, 3));
+  UNIT_TEST_ASSERT(tsch_ledger_remove_pending(&children[1], 10, 3));
+  UNIT_TEST_ASSERT(!tsch_ledger_is_pending(10, 3));
+  UNIT_TEST_ASSERT(!tsch_ledger_remove_pending(&children[1], 10, 3));
+
+  /* Cells sharing a home bucket remain reachable after a removal */
+  UNIT_TEST_ASSERT(tsch_ledger_add_pending(&children[0], 0, 1));
+  UNIT_TEST_ASSERT(tsch_ledger_add_pending(&children[0], TSCH_LEDGER_PENDING_HASH_SIZE, 1));
+  UNIT_TEST_ASSERT(tsch_ledger_add_pending(&children[0], 2 * TSCH_LEDGER_PENDING_HASH_SIZE, 1));
+  UNIT_TEST_ASSERT(tsch_ledger_remove_pending(&children[0], 0, 1));
+  UNIT_TEST_ASSERT(tsch_ledger_is_pending(TSCH_LEDGER_PENDING_HASH_SIZE, 1));
+  UNIT_TEST_ASSERT(tsch_ledger_is_pending(2 * TSCH_LEDGER_PENDING_HASH_SIZE, 1));
+  tsch_ledger_clear_pending(&children[0]);
+  UNIT_TEST_ASSERT(!tsch_ledger_is_pending(TSCH_LEDGER_PENDING_HASH_SIZE, 1));
+
+  /* The index holds at most TSCH_LEDGER_MAX_PENDING_TOTAL cells */
+  for(i = 0; i < TSCH_LEDGER_MAX_PENDING_TOTAL; i++) {
+    UNIT_TEST_ASSERT(tsch_ledger_add_pending(&children[i % NUM_CHILDREN], i, 2));
+  }
+  UNIT_TEST_ASSERT(!tsch_ledger_add_pending(&children[0], 100, 2));
+  UNIT_TEST_ASSERT(!tsch_ledger_is_pending(100, 2));
+  tsch_ledger_init();
+  for(i = 0; i < TSCH_LEDGER_MAX_PENDING_TOTAL; i++) {
+    UNIT_TEST_ASSERT(!tsch_ledger_is_pending(i, 2));
+  }
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(ledger_owed, "Ledger owed cells");
+UNIT_TEST(ledger_owed)
+{
+  UNIT_TEST_BEGIN();
+
+  tsch_ledger_init();
+  UNIT_TEST_ASSERT(tsch_ledger_add_owed(&children[0], 200) == 200);
+  UNIT_TEST_ASSERT(tsch_ledger_add_owed(&children[1], 3) == 3);
+  /* The debt of a child saturates, and the total follows */
+  UNIT_TEST_ASSERT(tsch_ledger_add_owed(&children[0], 100) == 55);
+  UNIT_TEST_ASSERT(tsch_ledger_get(&children[0])->owed == 255);
+  UNIT_TEST_ASSERT(tsch_ledger_owed_total() == 258);
+  UNIT_TEST_ASSERT(tsch_ledger_remove_owed(&children[0], 0xff) == 255);
+  UNIT_TEST_ASSERT(tsch_ledger_owed_total() == 3);
+  tsch_ledger_init();
+  UNIT_TEST_ASSERT(tsch_ledger_owed_total() == 0);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(ledger_random, "Ledger counters against a full scan");
+UNIT_TEST(ledger_random)
+{
+  int step;
+  uint16_t ts;
+  uint8_t ch;
+  int mismatches = 0;
+
+  UNIT_TEST_BEGIN();
+
+  tsch_ledger_init();
+  for(step = 0; step < NUM_STEPS; step++) {
+    const linkaddr_t *addr = &children[random_rand() % NUM_CHILDREN];
+    /* Few cells and channels, so that they collide often */
+    ts = random_rand() % 8;
+    ch = random_rand() % 4;
+    switch(random_rand() % 6) {
+    case 0:
+      tsch_ledger_set_channel(addr, ch);
+      break;
+    case 1:
+      tsch_ledger_add_pending(addr, ts, ch);
+      break;
+    case 2:
+    case 3:
+      tsch_ledger_remove_pending(addr, ts, ch);
+      break;
+    case 4:
+      if(random_rand() % 8 == 0) {
+        tsch_ledger_clear_pending(addr);
+      } else {
+        tsch_ledger_add_owed(addr, random_rand() % 100);
+      }
+      break;
+    default:
+      tsch_ledger_remove_owed(addr, random_rand() % 100);
+      break;
+    }
+
+    for(ch = 1; ch < 4; ch++) {
+      mismatches += tsch_ledger_channel_users(ch) != scan_channel_users(ch);
+    }
+    for(ts = 0; ts < 8; ts++) {
+      for(ch = 0; ch < 4; ch++) {
+        mismatches += tsch_ledger_is_pending(ts, ch) != scan_is_pending(ts, ch);
+      }
+    }
+    mismatches += tsch_ledger_owed_total() != scan_owed_total();
+  }
+  printf("TEST: %d steps, %d mismatches\n", NUM_STEPS, mismatches);
+  UNIT_TEST_ASSERT(mismatches == 0);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("Run unit-test\n");
+  printf("---\n");
+
+  init_children();
+
+  UNIT_TEST_RUN(ledger_channels);
+  UNIT_TEST_RUN(ledger_pending);
+  UNIT_TEST_RUN(ledger_owed);
+  UNIT_TEST_RUN(ledger_random);
+
+  if(unit_test_ledger_channels.result == unit_test_failure ||
+     unit_test_ledger_pending.result == unit_test_failure ||
+     unit_test_ledger_owed.result == unit_test_failure ||
+     unit_test_ledger_random.result == unit_test_failure) {
+    printf("=check-me= FAILED\n");
+    printf("---\n");
+  }
+
+  printf("=check-me= DONE\n");
+  printf("---\n");
+
+  PROCESS_END();
+}
@@ -0,0 +1,306 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+#include "contiki.h"
+#include "unit-test.h"
+#include "net/mac/tsch/tsch.h"
+#include <stdio.h>
+
+PROCESS(test_process, "test");
+AUTOSTART_PROCESSES(&test_process);
+
+/*---------------------------------------------------------------------------*/
+/* The rest of TSCH, stubbed out: the schedule is tested alone, with the
+ * test standing in for slot operation */
+const linkaddr_t tsch_broadcast_address = { { 0xff, 0xff } };
+int tsch_is_coordinator = 1;
+int tsch_is_associated = 1;
+struct tsch_link *current_link;
+struct tsch_link *backup_link;
+uint8_t default_channel;
+uint8_t parent_channel = 1;
+uint8_t children_channel = 2;
+uint16_t required_slots;
+uint16_t free_uplink_timeslots;
+float packet_generation_rate;
+float current_packet_generation_rate;
+int current_number_slots_for_packet_generation;
+int allocate_slot_for_packet_generation;
+
+int tsch_get_lock(void) { return 1; }
+void tsch_release_lock(void) { }
+int tsch_is_locked(void) { return 0; }
+struct tsch_neighbor *tsch_queue_add_nbr(const linkaddr_t *addr) { return NULL; }
+struct tsch_neighbor *tsch_queue_get_nbr(const linkaddr_t *addr) { return NULL; }
+struct tsch_neighbor *tsch_queue_get_nbr_for_link(struct tsch_link *link) { return NULL; }
+struct tsch_neighbor *tsch_queue_get_time_source(void) { return NULL; }
+int tsch_queue_nbr_packet_count(const struct tsch_neighbor *n) { return 0; }
+float convert_slots_to_rate(int slots) { return slots; }
+int find_shared_timeslot_children() { return 0; }
+
+/*---------------------------------------------------------------------------*/
+#define SF_LENGTH 31
+#define CHANNEL 3
+
+static struct tsch_slotframe *sf;
+static linkaddr_t child = { { 0x01 } };
+static struct tsch_asn_t asn;
+
+/* Runs slot operation once, as at a slot boundary: it adopts the view
+ * published since the last call, if any */
+static struct tsch_link *
+slot_boundary(void)
+{
+  uint16_t timeslot_diff;
+  struct tsch_link *backup;
+  return tsch_schedule_get_next_active_link(&asn, &timeslot_diff, &backup);
+}
+/*---------------------------------------------------------------------------*/
+static struct tsch_link *
+add(uint16_t timeslot)
+{
+  return tsch_schedule_add_link(sf, LINK_OPTION_RX, LINK_TYPE_NORMAL, &child,
+                                timeslot, CHANNEL);
+}
+/*---------------------------------------------------------------------------*/
+static int
+delete(uint16_t timeslot)
+{
+  return tsch_schedule_delete_link(sf, LINK_OPTION_RX, LINK_TYPE_NORMAL, &child,
+                                   timeslot, CHANNEL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+reset(void)
+{
+  tsch_schedule_remove_all_slotframes();
+  slot_boundary();
+  current_link = NULL;
+  backup_link = NULL;
+  tsch_ledger_init();
+  sf = tsch_schedule_add_slotframe(0, SF_LENGTH);
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(schedule_reclaim, "Retired links outlive the adopted view");
+UNIT_TEST(schedule_reclaim)
+{
+  struct tsch_link *a;
+  struct tsch_link *b;
+
+  UNIT_TEST_BEGIN();
+
+  reset();
+  a = add(1);
+  UNIT_TEST_ASSERT(a != NULL);
+  UNIT_TEST_ASSERT(slot_boundary() == a);
+
+  /* Slot operation still runs on the view holding a: its memory must not
+   * be handed out again */
+  UNIT_TEST_ASSERT(delete(1) == 1);
+  b = add(2);
+  UNIT_TEST_ASSERT(b != NULL && b != a);
+
+  /* Once the view without a is adopted, a goes back to the pool */
+  UNIT_TEST_ASSERT(slot_boundary() == b);
+  UNIT_TEST_ASSERT(add(3) == a);
+
+  /* The links slot operation holds survive adoption */
+  reset();
+  a = add(1);
+  b = add(2);
+  slot_boundary();
+  current_link = a;
+  backup_link = b;
+  UNIT_TEST_ASSERT(delete(1) == 1);
+  UNIT_TEST_ASSERT(delete(2) == 1);
+  slot_boundary();
+  UNIT_TEST_ASSERT(add(4) != a);
+  UNIT_TEST_ASSERT(add(5) != b);
+  current_link = NULL;
+  backup_link = NULL;
+  slot_boundary();
+  /* Freed by the next change */
+  UNIT_TEST_ASSERT(add(6) != NULL);
+  UNIT_TEST_ASSERT(tsch_schedule_get_link_by_timeslot(sf, 7, CHANNEL) == NULL);
+  {
+    struct tsch_link *c = add(7);
+    UNIT_TEST_ASSERT(c == a || c == b);
+  }
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(schedule_batch, "Batched add and delete");
+UNIT_TEST(schedule_batch)
+{
+  static const sf_simple_cell_t first[] = { { 1, CHANNEL }, { 2, CHANNEL }, { 3, CHANNEL } };
+  static const sf_simple_cell_t second[] = { { 4, CHANNEL }, { 5, CHANNEL }, { 6, CHANNEL } };
+  struct tsch_link *old[3];
+  uint8_t done[3];
+  int i;
+  int j;
+
+  UNIT_TEST_BEGIN();
+
+  reset();
+  UNIT_TEST_ASSERT(tsch_schedule_add_links(sf, LINK_OPTION_RX, LINK_TYPE_NORMAL, &child,
+                                           first, 3, done) == 3);
+  for(i = 0; i < 3; i++) {
+    UNIT_TEST_ASSERT(done[i] == 1);
+    old[i] = tsch_schedule_get_link_by_timeslot(sf, first[i].timeslot_offset, CHANNEL);
+    UNIT_TEST_ASSERT(old[i] != NULL);
+  }
+  /* Nothing is visible to slot operation before the batch is published */
+  UNIT_TEST_ASSERT(slot_boundary() == old[0]);
+
+  /* Swap the cells without slot operation adopting anything in between */
+  UNIT_TEST_ASSERT(tsch_schedule_delete_links(sf, LINK_OPTION_RX, LINK_TYPE_NORMAL, &child,
+                                              first, 3, done) == 3);
+  UNIT_TEST_ASSERT(tsch_schedule_add_links(sf, LINK_OPTION_RX, LINK_TYPE_NORMAL, &child,
+                                           second, 3, done) == 3);
+  for(i = 0; i < 3; i++) {
+    struct tsch_link *l = tsch_schedule_get_link_by_timeslot(sf, second[i].timeslot_offset, CHANNEL);
+    UNIT_TEST_ASSERT(l != NULL);
+    for(j = 0; j < 3; j++) {
+      UNIT_TEST_ASSERT(l != old[j]);
+    }
+  }
+  /* The view slot operation runs on still holds the old cells, intact */
+  for(i = 0; i < 3; i++) {
+    UNIT_TEST_ASSERT(old[i]->timeslot == first[i].timeslot_offset);
+    UNIT_TEST_ASSERT(linkaddr_cmp(&old[i]->addr, &child));
+  }
+
+  /* Adopting the last view runs the new cells only */
+  UNIT_TEST_ASSERT(slot_boundary()->timeslot == 4);
+  UNIT_TEST_ASSERT(tsch_schedule_delete_links(sf, LINK_OPTION_RX, LINK_TYPE_NORMAL, &child,
+                                              first, 3, done) == 0);
+
+  /* One cell already in use: nothing is installed, the others are flagged */
+  {
+    static const sf_simple_cell_t clash[] = { { 7, CHANNEL }, { 5, CHANNEL }, { 8, CHANNEL } };
+    UNIT_TEST_ASSERT(tsch_schedule_add_links(sf, LINK_OPTION_RX, LINK_TYPE_NORMAL, &child,
+                                             clash, 3, done) == -1);
+    UNIT_TEST_ASSERT(done[0] == 1 && done[1] == 0 && done[2] == 1);
+    UNIT_TEST_ASSERT(tsch_schedule_get_link_by_timeslot(sf, 7, CHANNEL) == NULL);
+    UNIT_TEST_ASSERT(tsch_schedule_get_link_by_timeslot(sf, 8, CHANNEL) == NULL);
+  }
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+/* Cells first, first + 1, ... */
+static void
+make_cells(sf_simple_cell_t *cells, uint16_t first, uint16_t count)
+{
+  uint16_t i;
+  for(i = 0; i < count; i++) {
+    cells[i].timeslot_offset = first + i;
+    cells[i].channel_offset = CHANNEL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(schedule_full, "Relocation on a full schedule");
+UNIT_TEST(schedule_full)
+{
+  sf_simple_cell_t old[TSCH_SCHEDULE_MAX_RETIRED_LINKS + 1];
+  sf_simple_cell_t new[TSCH_SCHEDULE_MAX_RETIRED_LINKS + 1];
+  uint8_t done[TSCH_SCHEDULE_MAX_RETIRED_LINKS + 1];
+  uint16_t i;
+
+  UNIT_TEST_BEGIN();
+
+  reset();
+  for(i = 0; i < TSCH_SCHEDULE_MAX_LINKS; i++) {
+    UNIT_TEST_ASSERT(add(i) != NULL);
+  }
+  /* The headroom is for retired links only */
+  UNIT_TEST_ASSERT(add(TSCH_SCHEDULE_MAX_LINKS) == NULL);
+  make_cells(new, TSCH_SCHEDULE_MAX_LINKS, 1);
+  UNIT_TEST_ASSERT(tsch_schedule_add_links(sf, LINK_OPTION_RX, LINK_TYPE_NORMAL, &child,
+                                           new, 1, done) == -1);
+  slot_boundary();
+
+  /* Relocating as many cells as the headroom, with no slot boundary between
+   * the delete and the add */
+  make_cells(old, 0, TSCH_SCHEDULE_MAX_RETIRED_LINKS);
+  make_cells(new, TSCH_SCHEDULE_MAX_LINKS, TSCH_SCHEDULE_MAX_RETIRED_LINKS);
+  UNIT_TEST_ASSERT(tsch_schedule_delete_links(sf, LINK_OPTION_RX, LINK_TYPE_NORMAL, &child,
+                                              old, TSCH_SCHEDULE_MAX_RETIRED_LINKS, done)
+                   == TSCH_SCHEDULE_MAX_RETIRED_LINKS);
+  UNIT_TEST_ASSERT(tsch_schedule_add_links(sf, LINK_OPTION_RX, LINK_TYPE_NORMAL, &child,
+                                           new, TSCH_SCHEDULE_MAX_RETIRED_LINKS, done)
+                   == TSCH_SCHEDULE_MAX_RETIRED_LINKS);
+  slot_boundary();
+
+  /* One more than the headroom: the add waits for the next slot boundary */
+  make_cells(old, TSCH_SCHEDULE_MAX_RETIRED_LINKS, TSCH_SCHEDULE_MAX_RETIRED_LINKS + 1);
+  make_cells(new, 0, TSCH_SCHEDULE_MAX_RETIRED_LINKS + 1);
+  UNIT_TEST_ASSERT(tsch_schedule_delete_links(sf, LINK_OPTION_RX, LINK_TYPE_NORMAL, &child,
+                                              old, TSCH_SCHEDULE_MAX_RETIRED_LINKS + 1, done)
+                   == TSCH_SCHEDULE_MAX_RETIRED_LINKS + 1);
+  UNIT_TEST_ASSERT(tsch_schedule_add_links(sf, LINK_OPTION_RX, LINK_TYPE_NORMAL, &child,
+                                           new, TSCH_SCHEDULE_MAX_RETIRED_LINKS + 1, done) == -1);
+  for(i = 0; i < TSCH_SCHEDULE_MAX_RETIRED_LINKS + 1; i++) {
+    UNIT_TEST_ASSERT(done[i] == 0);
+  }
+  slot_boundary();
+  UNIT_TEST_ASSERT(tsch_schedule_add_links(sf, LINK_OPTION_RX, LINK_TYPE_NORMAL, &child,
+                                           new, TSCH_SCHEDULE_MAX_RETIRED_LINKS + 1, done)
+                   == TSCH_SCHEDULE_MAX_RETIRED_LINKS + 1);
+  UNIT_TEST_ASSERT(add(TSCH_SCHEDULE_MAX_LINKS + TSCH_SCHEDULE_MAX_RETIRED_LINKS) == NULL);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("Run unit-test\n");
+  printf("---\n");
+
+  tsch_schedule_init();
+
+  UNIT_TEST_RUN(schedule_reclaim);
+  UNIT_TEST_RUN(schedule_batch);
+  UNIT_TEST_RUN(schedule_full);
+
+  if(unit_test_schedule_reclaim.result == unit_test_failure ||
+     unit_test_schedule_batch.result == unit_test_failure ||
+     unit_test_schedule_full.result == unit_test_failure) {
+    printf("=check-me= FAILED\n");
+    printf("---\n");
+  }
+
+  printf("=check-me= DONE\n");
+  printf("---\n");
+
+  PROCESS_END();
+}
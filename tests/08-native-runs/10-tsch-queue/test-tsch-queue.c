@@ -0,0 +1,187 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+#include "contiki.h"
+#include "unit-test.h"
+#include "net/packetbuf.h"
+#include "net/mac/tsch/tsch.h"
+#include <stdio.h>
+
+PROCESS(test_process, "test");
+AUTOSTART_PROCESSES(&test_process);
+
+/*---------------------------------------------------------------------------*/
+/* The rest of TSCH, stubbed out: the queue is tested alone, with the test
+ * standing in for slot operation and tsch_pending_events_process */
+const linkaddr_t tsch_broadcast_address = { { 0xff, 0xff } };
+const linkaddr_t tsch_eb_address = { { 0, 0 } };
+struct tsch_asn_t tsch_current_asn;
+int tsch_is_coordinator;
+struct ringbufindex dequeued_ringbuf;
+struct tsch_packet *dequeued_array[TSCH_DEQUEUED_ARRAY_SIZE];
+static int locked;
+
+int tsch_get_lock(void) { return locked ? 0 : (locked = 1); }
+void tsch_release_lock(void) { locked = 0; }
+int tsch_is_locked(void) { return locked; }
+void tsch_schedule_forget_nbr(const struct tsch_neighbor *n) { }
+void tsch_set_ka_timeout(uint32_t timeout) { }
+PROCESS(tsch_pending_events_process, "pending events");
+PROCESS_THREAD(tsch_pending_events_process, ev, data)
+{
+  PROCESS_BEGIN();
+  PROCESS_END();
+}
+
+extern int stale_drops;
+
+/*---------------------------------------------------------------------------*/
+static linkaddr_t peer = { { 0x01 } };
+
+/* Enqueues a data packet with a lifetime in timeslots, 0 for none */
+static struct tsch_packet *
+send(uint16_t lifetime)
+{
+  packetbuf_clear();
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &peer);
+  packetbuf_set_attr(PACKETBUF_ATTR_TSCH_LIFETIME, lifetime);
+  return tsch_queue_add_packet(&peer, 1, NULL, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+reset(void)
+{
+  tsch_queue_reset();
+  /* What tsch_tx_process_pending would do */
+  while(ringbufindex_peek_get(&dequeued_ringbuf) != -1) {
+    tsch_queue_free_packet(dequeued_array[ringbufindex_get(&dequeued_ringbuf)]);
+  }
+  TSCH_ASN_INIT(tsch_current_asn, 0, 0);
+  stale_drops = 0;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(queue_purge, "Expired packets are purged from the whole queue");
+UNIT_TEST(queue_purge)
+{
+  struct tsch_neighbor *n;
+  struct tsch_packet *p1, *p2, *p3, *p4;
+
+  UNIT_TEST_BEGIN();
+
+  reset();
+  p1 = send(100);
+  p2 = send(10);
+  p3 = send(0);
+  p4 = send(10);
+  UNIT_TEST_ASSERT(p1 != NULL && p2 != NULL && p3 != NULL && p4 != NULL);
+  n = tsch_queue_get_nbr(&peer);
+
+  /* Not yet expired */
+  TSCH_ASN_INC(tsch_current_asn, 10);
+  UNIT_TEST_ASSERT(tsch_queue_purge_stale_packets() == 0);
+
+  /* The head is still fresh: slot operation drops nothing */
+  TSCH_ASN_INC(tsch_current_asn, 10);
+  UNIT_TEST_ASSERT(tsch_queue_remove_stale_packet(n) == NULL);
+
+  /* The purge gets the expired packets behind it, and keeps the order of
+   * the others */
+  UNIT_TEST_ASSERT(tsch_queue_purge_stale_packets() == 2);
+  UNIT_TEST_ASSERT(stale_drops == 2);
+  UNIT_TEST_ASSERT(!tsch_is_locked());
+  UNIT_TEST_ASSERT(tsch_queue_nbr_packet_count(n) == 2);
+  UNIT_TEST_ASSERT(ringbufindex_elements(&dequeued_ringbuf) == 2);
+  UNIT_TEST_ASSERT(dequeued_array[ringbufindex_peek_get(&dequeued_ringbuf)] == p2);
+  UNIT_TEST_ASSERT(p2->ret == MAC_TX_ERR && p4->ret == MAC_TX_ERR);
+  UNIT_TEST_ASSERT(tsch_queue_remove_packet_from_queue(n) == p1);
+  UNIT_TEST_ASSERT(tsch_queue_remove_packet_from_queue(n) == p3);
+  tsch_queue_free_packet(p1);
+  tsch_queue_free_packet(p3);
+
+  /* Past its deadline, the head goes at the next Tx cell */
+  reset();
+  p1 = send(5);
+  n = tsch_queue_get_nbr(&peer);
+  TSCH_ASN_INC(tsch_current_asn, 5);
+  UNIT_TEST_ASSERT(tsch_queue_remove_stale_packet(n) == NULL);
+  TSCH_ASN_INC(tsch_current_asn, 1);
+  UNIT_TEST_ASSERT(tsch_queue_remove_stale_packet(n) == p1);
+  tsch_queue_free_packet(p1);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(queue_full, "A full queue makes room from expired packets");
+UNIT_TEST(queue_full)
+{
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  reset();
+  for(i = 0; i < TSCH_QUEUE_NUM_PER_NEIGHBOR - 1; i++) {
+    UNIT_TEST_ASSERT(send(i == 1 ? 3 : 0) != NULL);
+  }
+
+  /* Full, and nothing expired */
+  UNIT_TEST_ASSERT(send(0) == NULL);
+
+  /* The expired packet leaves its place to the new one */
+  TSCH_ASN_INC(tsch_current_asn, 4);
+  UNIT_TEST_ASSERT(send(0) != NULL);
+  UNIT_TEST_ASSERT(stale_drops == 1);
+  UNIT_TEST_ASSERT(tsch_queue_packet_count(&peer) == TSCH_QUEUE_NUM_PER_NEIGHBOR - 1);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("Run unit-test\n");
+  printf("---\n");
+
+  ringbufindex_init(&dequeued_ringbuf, TSCH_DEQUEUED_ARRAY_SIZE);
+  tsch_queue_init();
+
+  UNIT_TEST_RUN(queue_purge);
+  UNIT_TEST_RUN(queue_full);
+
+  if(unit_test_queue_purge.result == unit_test_failure ||
+     unit_test_queue_full.result == unit_test_failure) {
+    printf("=check-me= FAILED\n");
+    printf("---\n");
+  }
+
+  printf("=check-me= DONE\n");
+  printf("---\n");
+
+  PROCESS_END();
+}
@@ -0,0 +1,366 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+#include "contiki.h"
+#include "unit-test.h"
+#include "lib/random.h"
+#include <stdio.h>
+#include <string.h>
+
+PROCESS(test_process, "test");
+PROCESS(owner_process, "timer owner");
+AUTOSTART_PROCESSES(&test_process);
+
+/*---------------------------------------------------------------------------*/
+/* Stands in for the clock, so that the test decides when time passes. The
+ * rest of the system gets it through -Wl,--wrap=clock_time. Time only goes
+ * forward, and not by much: the periodic timers of the system catch up
+ * with every period skipped. It starts close enough to the wrap-around for
+ * the tests to reach it. */
+#define TIME_ORIGIN ((clock_time_t)0 - 0x400000)
+static clock_time_t now = TIME_ORIGIN;
+
+clock_time_t
+__wrap_clock_time(void)
+{
+  return now;
+}
+/*---------------------------------------------------------------------------*/
+#define NUM_TIMERS 32
+
+static struct etimer timers[NUM_TIMERS];
+/* Timer events received, and when */
+static unsigned fired[NUM_TIMERS];
+static clock_time_t fired_at[NUM_TIMERS];
+/* Random test: timers set and not yet fired, and faults seen */
+static uint8_t armed[NUM_TIMERS];
+static unsigned early;
+
+/* Owns the timers of the test: their events come here */
+PROCESS_THREAD(owner_process, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_YIELD();
+    if(ev == PROCESS_EVENT_TIMER) {
+      int i = (struct etimer *)data - timers;
+      if(i >= 0 && i < NUM_TIMERS) {
+        fired[i]++;
+        fired_at[i] = now;
+        if(!timer_expired(&timers[i].timer)) {
+          early++;
+        }
+        armed[i] = 0;
+      }
+    }
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+/* Lets etimer_process post the events due at the current time */
+static void
+run(void)
+{
+  etimer_request_poll();
+  while(process_run() > 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+set(int i, clock_time_t interval)
+{
+  PROCESS_CONTEXT_BEGIN(&owner_process);
+  etimer_set(&timers[i], interval);
+  PROCESS_CONTEXT_END(&owner_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+reset(clock_time_t start)
+{
+  int i;
+  for(i = 0; i < NUM_TIMERS; i++) {
+    etimer_stop(&timers[i]);
+  }
+  now = start;
+  run();
+  memset(fired, 0, sizeof(fired));
+  memset(armed, 0, sizeof(armed));
+  early = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Sets a timer per interval, all at once, then moves the clock to just
+ * before and to each expiration in turn. Intervals go up, equal ones
+ * next to each other. Returns 1 if
+ * every timer fired exactly at its expiration. */
+static int
+check_expirations(const clock_time_t *intervals, int count)
+{
+  clock_time_t start = now;
+  int i;
+  int j;
+
+  for(i = 0; i < count; i++) {
+    set(i, intervals[i]);
+  }
+  for(i = 0; i < count; i++) {
+    clock_time_t expiration = start + intervals[i];
+    if(i > 0 && intervals[i] == intervals[i - 1]) {
+      /* Due with the previous one */
+      if(fired[i] != 1 || fired_at[i] != expiration) {
+        printf("timer %d did not fire with timer %d\n", i, i - 1);
+        return 0;
+      }
+      continue;
+    }
+    /* The wheel never hints at a later wake-up than the next timer */
+    if((clock_time_t)(etimer_next_expiration_time() - now)
+       > (clock_time_t)(expiration - now)) {
+      printf("timer %d: next expiration %lu after %lu\n", i,
+             (unsigned long)etimer_next_expiration_time(), (unsigned long)expiration);
+      return 0;
+    }
+    now = expiration - 1;
+    run();
+    for(j = i; j < count; j++) {
+      if(fired[j] != 0) {
+        printf("timer %d fired before %lu\n", j, (unsigned long)expiration);
+        return 0;
+      }
+    }
+    now = expiration;
+    run();
+    if(fired[i] != 1 || fired_at[i] != expiration || !etimer_expired(&timers[i])) {
+      printf("timer %d: fired %u times, at %lu instead of %lu\n", i,
+             fired[i], (unsigned long)fired_at[i], (unsigned long)expiration);
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(etimer_cascade, "Timers cascade down the levels of the wheel");
+UNIT_TEST(etimer_cascade)
+{
+  /* On both sides of slot and level boundaries, from a time with non-zero
+   * low digits */
+  static const clock_time_t intervals[] = {
+    1, 9, 15, 16, 16, 17, 255, 256, 257, 4095, 4096, 4097, 65537, 1048577
+  };
+
+  UNIT_TEST_BEGIN();
+
+  reset(TIME_ORIGIN + 0x12345 + 7);
+  UNIT_TEST_ASSERT(check_expirations(intervals, sizeof(intervals) / sizeof(intervals[0])));
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(etimer_wrap, "Timers expire across a clock wrap-around");
+UNIT_TEST(etimer_wrap)
+{
+  static const clock_time_t intervals[] = { 5, 19, 20, 21, 36, 300, 70000 };
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  /* A jump over several levels at once */
+  reset((clock_time_t)0 - 200000);
+  for(i = 0; i < 8; i++) {
+    set(i, 1 + i * 1000);
+  }
+  now += 100000;
+  run();
+  for(i = 0; i < 8; i++) {
+    UNIT_TEST_ASSERT(fired[i] == 1);
+  }
+
+  reset((clock_time_t)0 - 20);
+  UNIT_TEST_ASSERT(check_expirations(intervals, sizeof(intervals) / sizeof(intervals[0])));
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(etimer_uninit, "Timers need no initialisation");
+UNIT_TEST(etimer_uninit)
+{
+  struct etimer junk;
+
+  UNIT_TEST_BEGIN();
+
+  reset(now + 1000);
+  set(0, 10);
+
+  /* Garbage that looks like a timer in the wheel, in a slot that is in use:
+   * stopping it must leave the real timer alone */
+  memset(&junk, 0xa5, sizeof(junk));
+  junk.slot = timers[0].slot;
+  etimer_stop(&junk);
+  UNIT_TEST_ASSERT(etimer_expired(&junk));
+
+  memset(&junk, 0xa5, sizeof(junk));
+  PROCESS_CONTEXT_BEGIN(&owner_process);
+  etimer_set(&junk, 5);
+  PROCESS_CONTEXT_END(&owner_process);
+  UNIT_TEST_ASSERT(!etimer_expired(&junk));
+  now += 5;
+  run();
+  UNIT_TEST_ASSERT(etimer_expired(&junk));
+
+  now += 5;
+  run();
+  UNIT_TEST_ASSERT(fired[0] == 1);
+
+  /* Set again while running, then stopped: no event */
+  set(0, 10);
+  set(0, 20);
+  now += 10;
+  run();
+  UNIT_TEST_ASSERT(fired[0] == 1);
+  etimer_stop(&timers[0]);
+  now += 10;
+  run();
+  UNIT_TEST_ASSERT(fired[0] == 1);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+random_interval(void)
+{
+  unsigned r = random_rand() % 100;
+  if(r < 60) {
+    return random_rand() % 50;
+  } else if(r < 90) {
+    return random_rand() % 3000;
+  }
+  return (clock_time_t)random_rand() * 7919;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(etimer_random, "Random operations match timer_expired");
+UNIT_TEST(etimer_random)
+{
+  unsigned step;
+  unsigned missed = 0;
+  unsigned mismatch = 0;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  reset(now + 5000);
+  random_init(1);
+
+  for(step = 0; step < 20000; step++) {
+    unsigned ops = random_rand() % 4;
+    while(ops-- > 0) {
+      unsigned op = random_rand() % 10;
+      i = random_rand() % NUM_TIMERS;
+      PROCESS_CONTEXT_BEGIN(&owner_process);
+      if(op < 5) {
+        etimer_set(&timers[i], random_interval());
+        armed[i] = 1;
+      } else if(op < 6 && timers[i].timer.interval != 0) {
+        etimer_reset(&timers[i]);
+        armed[i] = 1;
+      } else if(op < 7 && timers[i].timer.interval != 0) {
+        etimer_restart(&timers[i]);
+        armed[i] = 1;
+      } else if(op < 9) {
+        etimer_stop(&timers[i]);
+        armed[i] = 0;
+      } else if(armed[i]) {
+        etimer_adjust(&timers[i], (int)(random_rand() % 21) - 10);
+      }
+      PROCESS_CONTEXT_END(&owner_process);
+    }
+    run();
+
+    /* Small steps, straight to the next expiration, or a jump */
+    switch(random_rand() % 10) {
+    case 0: case 1: case 2: case 3: case 4: case 5:
+      now += random_rand() % 3;
+      break;
+    case 6: case 7: case 8:
+      if(etimer_pending()
+         && (clock_time_t)(etimer_next_expiration_time() - now) < 20000) {
+        now = etimer_next_expiration_time();
+      } else {
+        now++;
+      }
+      break;
+    default:
+      now += random_rand() % 500;
+      break;
+    }
+    run();
+
+    for(i = 0; i < NUM_TIMERS; i++) {
+      if(armed[i] && timer_expired(&timers[i].timer)) {
+        missed++;
+        armed[i] = 0;
+      }
+      if(etimer_expired(&timers[i]) != !armed[i]) {
+        mismatch++;
+        armed[i] = !etimer_expired(&timers[i]);
+      }
+    }
+  }
+  printf("early %u missed %u mismatch %u, up to %lu\n", early, missed, mismatch,
+         (unsigned long)now);
+  UNIT_TEST_ASSERT(early == 0 && missed == 0 && mismatch == 0);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("Run unit-test\n");
+  printf("---\n");
+
+  process_start(&owner_process, NULL);
+
+  /* In the order of the times they use */
+  UNIT_TEST_RUN(etimer_cascade);
+  UNIT_TEST_RUN(etimer_random);
+  UNIT_TEST_RUN(etimer_wrap);
+  UNIT_TEST_RUN(etimer_uninit);
+
+  if(unit_test_etimer_cascade.result == unit_test_failure ||
+     unit_test_etimer_wrap.result == unit_test_failure ||
+     unit_test_etimer_uninit.result == unit_test_failure ||
+     unit_test_etimer_random.result == unit_test_failure) {
+    printf("=check-me= FAILED\n");
+    printf("---\n");
+  }
+
+  printf("=check-me= DONE\n");
+  printf("---\n");
+
+  PROCESS_END();
+}
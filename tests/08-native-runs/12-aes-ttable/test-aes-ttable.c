@@ -0,0 +1,143 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+#include "contiki.h"
+#include "unit-test.h"
+#include "lib/aes-128.h"
+#include "lib/hexconv.h"
+#include "lib/random.h"
+#include <stdio.h>
+#include <string.h>
+
+PROCESS(test_process, "test");
+AUTOSTART_PROCESSES(&test_process);
+
+/* The default software driver, as a reference. On native, AES_128 is the
+ * T-table driver, so aes-128.h does not declare it. */
+extern const struct aes_128_driver aes_128_driver;
+
+/* A list of key, plaintext => ciphertext, from FIPS-197 */
+static const char *testcases[][3] = {
+  /* Appendix B, cipher example */
+  { "2b7e151628aed2a6abf7158809cf4f3c",
+    "3243f6a8885a308d313198a2e0370734",
+    "3925841d02dc09fbdc118597196a0b32" },
+  /* Appendix C.1, AES-128 */
+  { "000102030405060708090a0b0c0d0e0f",
+    "00112233445566778899aabbccddeeff",
+    "69c4e0d86a7b0430d8cdb78070b4c55a" },
+};
+
+#define NUM_TESTCASES (sizeof(testcases)/sizeof(testcases[0]))
+#define NUM_RANDOM_BLOCKS 256
+
+/*---------------------------------------------------------------------------*/
+static void
+random_bytes(uint8_t *buf, size_t len)
+{
+  size_t i;
+
+  for(i = 0; i < len; i++) {
+    buf[i] = random_rand();
+  }
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(aes_ttable_fips197, "AES T-table against FIPS-197");
+UNIT_TEST(aes_ttable_fips197)
+{
+  int i;
+  uint8_t key[AES_128_KEY_LENGTH];
+  uint8_t block[AES_128_BLOCK_SIZE];
+  uint8_t expected[AES_128_BLOCK_SIZE];
+
+  UNIT_TEST_BEGIN();
+
+  for(i = 0; i < NUM_TESTCASES; i++) {
+    hexconv_unhexlify(testcases[i][0], strlen(testcases[i][0]),
+                      key, sizeof(key));
+    hexconv_unhexlify(testcases[i][1], strlen(testcases[i][1]),
+                      block, sizeof(block));
+    hexconv_unhexlify(testcases[i][2], strlen(testcases[i][2]),
+                      expected, sizeof(expected));
+
+    aes_128_ttable_driver.set_key(key);
+    aes_128_ttable_driver.encrypt(block);
+    UNIT_TEST_ASSERT(memcmp(block, expected, sizeof(block)) == 0);
+  }
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(aes_ttable_random, "AES T-table against the default");
+UNIT_TEST(aes_ttable_random)
+{
+  int i;
+  uint8_t key[AES_128_KEY_LENGTH];
+  uint8_t block[AES_128_BLOCK_SIZE];
+  uint8_t expected[AES_128_BLOCK_SIZE];
+
+  UNIT_TEST_BEGIN();
+
+  /* Keys are set afresh for every block, and each driver keeps its own */
+  for(i = 0; i < NUM_RANDOM_BLOCKS; i++) {
+    random_bytes(key, sizeof(key));
+    random_bytes(block, sizeof(block));
+    memcpy(expected, block, sizeof(block));
+
+    aes_128_driver.set_key(key);
+    aes_128_driver.encrypt(expected);
+    aes_128_ttable_driver.set_key(key);
+    aes_128_ttable_driver.encrypt(block);
+    UNIT_TEST_ASSERT(memcmp(block, expected, sizeof(block)) == 0);
+  }
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("Run unit-test\n");
+  printf("---\n");
+
+  UNIT_TEST_RUN(aes_ttable_fips197);
+  UNIT_TEST_RUN(aes_ttable_random);
+
+  if(unit_test_aes_ttable_fips197.result == unit_test_failure ||
+     unit_test_aes_ttable_random.result == unit_test_failure) {
+    printf("=check-me= FAILED\n");
+    printf("---\n");
+  }
+
+  printf("=check-me= DONE\n");
+  printf("---\n");
+
+  PROCESS_END();
+}
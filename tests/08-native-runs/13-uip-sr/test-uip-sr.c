@@ -0,0 +1,293 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+#include "contiki.h"
+#include "unit-test.h"
+#include "net/routing/routing.h"
+#include "net/ipv6/uip-sr.h"
+#include "lib/random.h"
+#include <stdio.h>
+#include <string.h>
+
+PROCESS(test_process, "test");
+AUTOSTART_PROCESSES(&test_process);
+
+#define LIFETIME 1000
+#define NUM_RANDOM_NODES 12
+#define NUM_RANDOM_UPDATES 2000
+
+static uip_ipaddr_t root_addr;
+
+/*---------------------------------------------------------------------------*/
+/* Address of node id, in the prefix of the root. Ids above 0xff differ
+ * from the others in one more byte, which shows in the SRH compression. */
+static uip_ipaddr_t *
+node_addr(uint16_t id)
+{
+  static uip_ipaddr_t addr;
+  memcpy(&addr, &root_addr, 8);
+  memset(addr.u8 + 8, 0, 8);
+  addr.u8[8] = 0x0a;
+  addr.u8[14] = id >> 8;
+  addr.u8[15] = id & 0xff;
+  return &addr;
+}
+/*---------------------------------------------------------------------------*/
+static void
+update(uint16_t child, uint16_t parent)
+{
+  uip_ipaddr_t child_addr;
+  uip_ipaddr_copy(&child_addr, node_addr(child));
+  uip_sr_update_node(NULL, &child_addr,
+                     parent == 0 ? &root_addr : node_addr(parent), LIFETIME);
+}
+/*---------------------------------------------------------------------------*/
+static int
+route(uint16_t id, uint8_t *path_len, uint8_t *cmpr)
+{
+  return uip_sr_get_route(uip_sr_get_node(NULL, node_addr(id)),
+                          uip_sr_get_node(NULL, &root_addr), path_len, cmpr);
+}
+/*---------------------------------------------------------------------------*/
+/* uip_sr_get_route the long way: walks the parents every time */
+static int
+reference_route(uip_sr_node_t *dest, uip_sr_node_t *root, uint8_t *path_len, uint8_t *cmpr)
+{
+  uip_ipaddr_t dest_addr;
+  uip_ipaddr_t addr;
+  uip_sr_node_t *n;
+  int hops = 0;
+  int c = 15;
+  int i;
+
+  for(n = dest; n != NULL && n != root && hops < UIP_SR_LINK_NUM; n = n->parent) {
+    hops++;
+  }
+  if(dest == NULL || root == NULL || n != root || hops == 0) {
+    return 0;
+  }
+  NETSTACK_ROUTING.get_sr_node_ipaddr(&dest_addr, dest);
+  for(n = dest->parent; n != root; n = n->parent) {
+    NETSTACK_ROUTING.get_sr_node_ipaddr(&addr, n);
+    for(i = 0; i < c && addr.u8[i] == dest_addr.u8[i]; i++);
+    c = i;
+  }
+  *path_len = hops - 1;
+  *cmpr = c;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Do all nodes get the route the long way gives? */
+static int
+routes_match_reference(void)
+{
+  uip_sr_node_t *root = uip_sr_get_node(NULL, &root_addr);
+  uip_sr_node_t *n;
+  for(n = uip_sr_node_head(); n != NULL; n = uip_sr_node_next(n)) {
+    uint8_t len = 0, cmpr = 0, ref_len = 0, ref_cmpr = 0;
+    int found = uip_sr_get_route(n, root, &len, &cmpr);
+    if(found != reference_route(n, root, &ref_len, &ref_cmpr)
+       || (found && (len != ref_len || cmpr != ref_cmpr))) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(sr_parent_change, "Routes follow parent changes");
+UNIT_TEST(sr_parent_change)
+{
+  uint8_t len, cmpr;
+
+  UNIT_TEST_BEGIN();
+
+  uip_sr_free_all();
+  /* root <- 1 <- 2 <- 3, and root <- 0x101 */
+  update(1, 0);
+  update(2, 1);
+  update(3, 2);
+  update(0x101, 0);
+  UNIT_TEST_ASSERT(uip_sr_num_nodes() == 5);
+
+  UNIT_TEST_ASSERT(route(1, &len, &cmpr) && len == 0 && cmpr == 15);
+  UNIT_TEST_ASSERT(route(3, &len, &cmpr) && len == 2 && cmpr == 15);
+  /* Cached now: asked again, same answer */
+  UNIT_TEST_ASSERT(route(3, &len, &cmpr) && len == 2 && cmpr == 15);
+
+  /* 2 moves up under the root: 3 is one hop closer */
+  update(2, 0);
+  UNIT_TEST_ASSERT(route(3, &len, &cmpr) && len == 1 && cmpr == 15);
+
+  /* 2 moves under 0x101, which shares one byte less with 3 */
+  update(2, 0x101);
+  UNIT_TEST_ASSERT(route(3, &len, &cmpr) && len == 2 && cmpr == 14);
+  UNIT_TEST_ASSERT(route(2, &len, &cmpr) && len == 1 && cmpr == 14);
+  UNIT_TEST_ASSERT(route(1, &len, &cmpr) && len == 0);
+  UNIT_TEST_ASSERT(routes_match_reference());
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(sr_loop, "Updates making a loop are refused");
+UNIT_TEST(sr_loop)
+{
+  uint8_t len, cmpr;
+
+  UNIT_TEST_BEGIN();
+
+  uip_sr_free_all();
+  /* root <- 1 <- 2 <- 3 */
+  update(1, 0);
+  update(2, 1);
+  update(3, 2);
+  UNIT_TEST_ASSERT(route(3, &len, &cmpr) && len == 2);
+
+  /* 1 under its own descendant: refused, 1 keeps the root */
+  update(1, 3);
+  UNIT_TEST_ASSERT(route(1, &len, &cmpr) && len == 0);
+  UNIT_TEST_ASSERT(route(3, &len, &cmpr) && len == 2);
+
+  /* A loop among nodes the root cannot reach is taken, and reaches
+   * nothing */
+  update(10, 11);
+  update(11, 10);
+  UNIT_TEST_ASSERT(!route(10, &len, &cmpr));
+  UNIT_TEST_ASSERT(!route(11, &len, &cmpr));
+  /* Until one of them finds the root */
+  update(11, 3);
+  UNIT_TEST_ASSERT(route(10, &len, &cmpr) && len == 4);
+  UNIT_TEST_ASSERT(routes_match_reference());
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(sr_expiry, "Expired nodes take their routes with them");
+UNIT_TEST(sr_expiry)
+{
+  uip_ipaddr_t parent_addr;
+  uint8_t len, cmpr;
+
+  UNIT_TEST_BEGIN();
+
+  uip_sr_free_all();
+  /* root <- 1 <- 2 <- 3 */
+  update(1, 0);
+  update(2, 1);
+  update(3, 2);
+  UNIT_TEST_ASSERT(route(3, &len, &cmpr) && len == 2);
+
+  /* 2 expires, after the removal delay */
+  uip_ipaddr_copy(&parent_addr, node_addr(1));
+  uip_sr_expire_parent(NULL, node_addr(2), &parent_addr);
+  uip_sr_periodic(UIP_SR_REMOVAL_DELAY - 1);
+  UNIT_TEST_ASSERT(route(3, &len, &cmpr) && len == 2);
+  uip_sr_periodic(1);
+  uip_sr_periodic(1);
+  UNIT_TEST_ASSERT(uip_sr_get_node(NULL, node_addr(2)) == NULL);
+  UNIT_TEST_ASSERT(uip_sr_num_nodes() == 3);
+
+  /* 3 lost its parent, until it advertises a new one */
+  UNIT_TEST_ASSERT(!route(3, &len, &cmpr));
+  update(3, 1);
+  UNIT_TEST_ASSERT(route(3, &len, &cmpr) && len == 1);
+
+  /* 2 comes back with the same address, under 3 */
+  update(2, 3);
+  UNIT_TEST_ASSERT(route(2, &len, &cmpr) && len == 2);
+  UNIT_TEST_ASSERT(routes_match_reference());
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(sr_random, "Routes match a walk of the parents");
+UNIT_TEST(sr_random)
+{
+  uip_ipaddr_t parent_addr;
+  int i;
+  int ok = 1;
+
+  UNIT_TEST_BEGIN();
+
+  uip_sr_free_all();
+  random_init(0);
+  for(i = 0; i < NUM_RANDOM_UPDATES && ok; i++) {
+    uint16_t child = 1 + random_rand() % NUM_RANDOM_NODES;
+    uint16_t parent = random_rand() % (NUM_RANDOM_NODES + 1);
+    /* Some nodes differ from the others in one more byte */
+    if(random_rand() % 4 == 0) {
+      child |= 0x100;
+    }
+    switch(random_rand() % 8) {
+    case 0:
+      uip_ipaddr_copy(&parent_addr, parent == 0 ? &root_addr : node_addr(parent));
+      uip_sr_expire_parent(NULL, node_addr(child), &parent_addr);
+      break;
+    case 1:
+      uip_sr_periodic(UIP_SR_REMOVAL_DELAY / 2);
+      break;
+    default:
+      update(child, parent);
+      break;
+    }
+    ok = routes_match_reference();
+  }
+  UNIT_TEST_ASSERT(ok);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("Run unit-test\n");
+  printf("---\n");
+
+  /* A root, for the prefix and the root address of the source routes */
+  NETSTACK_ROUTING.root_start();
+  NETSTACK_ROUTING.get_root_ipaddr(&root_addr);
+
+  UNIT_TEST_RUN(sr_parent_change);
+  UNIT_TEST_RUN(sr_loop);
+  UNIT_TEST_RUN(sr_expiry);
+  UNIT_TEST_RUN(sr_random);
+
+  if(unit_test_sr_parent_change.result == unit_test_failure ||
+     unit_test_sr_loop.result == unit_test_failure ||
+     unit_test_sr_expiry.result == unit_test_failure ||
+     unit_test_sr_random.result == unit_test_failure) {
+    printf("=check-me= FAILED\n");
+    printf("---\n");
+  }
+
+  printf("=check-me= DONE\n");
+  printf("---\n");
+
+  PROCESS_END();
+}
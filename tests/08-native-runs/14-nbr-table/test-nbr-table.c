@@ -0,0 +1,392 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+#include "contiki.h"
+#include "unit-test.h"
+#include "net/nbr-table.h"
+#include "lib/probe-hash.h"
+#include "lib/random.h"
+#include <stdio.h>
+#include <string.h>
+
+PROCESS(test_process, "test");
+AUTOSTART_PROCESSES(&test_process);
+
+/* Addresses are drawn from a few home buckets around the end of the
+ * lladdr index, so that every probe sequence collides and some wrap */
+#define NUM_HOMES 3
+#define ADDRS_PER_HOME NBR_TABLE_MAX_NEIGHBORS
+#define NUM_ADDRS (NUM_HOMES * ADDRS_PER_HOME)
+#define NUM_RANDOM_OPS 5000
+
+struct test_nbr {
+  uint16_t id;
+};
+NBR_TABLE(struct test_nbr, test_nbrs);
+
+static linkaddr_t addrs[NUM_ADDRS];
+/* Address last evicted, as reported by the table callback. Copied, as the
+ * key is reused for the new neighbor. */
+static linkaddr_t evicted_addr;
+static const linkaddr_t *evicted;
+
+/* Model of the table: resident addresses from least to most recently
+ * used, with their locks */
+static uint8_t model[NBR_TABLE_MAX_NEIGHBORS];
+static uint8_t model_locked[NUM_ADDRS];
+static uint8_t model_len;
+
+/*---------------------------------------------------------------------------*/
+static uint16_t
+home_bucket(const linkaddr_t *addr)
+{
+  return probe_hash_bytes(addr->u8, LINKADDR_SIZE, NBR_TABLE_HASH_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+/* ADDRS_PER_HOME addresses for each of the homes HASH_SIZE - 2,
+ * HASH_SIZE - 1 and 0 */
+static void
+make_addrs(void)
+{
+  uint8_t found[NUM_HOMES] = { 0 };
+  uint16_t n = 0;
+  uint32_t id;
+  linkaddr_t addr;
+
+  for(id = 1; n < NUM_ADDRS; id++) {
+    uint16_t h;
+    memset(&addr, 0, sizeof(addr));
+    addr.u8[0] = 0x02;
+    addr.u8[LINKADDR_SIZE - 2] = id >> 8;
+    addr.u8[LINKADDR_SIZE - 1] = id & 0xff;
+    h = (home_bucket(&addr) + 2) & (NBR_TABLE_HASH_SIZE - 1);
+    if(h < NUM_HOMES && found[h] < ADDRS_PER_HOME) {
+      linkaddr_copy(&addrs[h * ADDRS_PER_HOME + found[h]], &addr);
+      found[h]++;
+      n++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+removed_callback(nbr_table_item_t *item)
+{
+  linkaddr_copy(&evicted_addr, nbr_table_get_lladdr(test_nbrs, item));
+  evicted = &evicted_addr;
+}
+/*---------------------------------------------------------------------------*/
+/* Evicts every neighbor by filling the table with fresh unused keys */
+static void
+clear_table(void)
+{
+  struct test_nbr *n;
+  for(n = nbr_table_head(test_nbrs); n != NULL; n = nbr_table_next(test_nbrs, n)) {
+    nbr_table_unlock(test_nbrs, n);
+  }
+  for(n = nbr_table_head(test_nbrs); n != NULL; n = nbr_table_head(test_nbrs)) {
+    nbr_table_remove(test_nbrs, n);
+  }
+  memset(model_locked, 0, sizeof(model_locked));
+  model_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+static struct test_nbr *
+add(uint8_t a)
+{
+  struct test_nbr *n;
+  evicted = NULL;
+  n = nbr_table_add_lladdr(test_nbrs, &addrs[a], NBR_TABLE_REASON_UNDEFINED, NULL);
+  if(n != NULL) {
+    n->id = a;
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static struct test_nbr *
+lookup(uint8_t a)
+{
+  return nbr_table_get_from_lladdr(test_nbrs, &addrs[a]);
+}
+/*---------------------------------------------------------------------------*/
+static int
+model_find(uint8_t a)
+{
+  int i;
+  for(i = 0; i < model_len; i++) {
+    if(model[i] == a) {
+      return i;
+    }
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+model_remove_at(int i)
+{
+  memmove(&model[i], &model[i + 1], model_len - i - 1);
+  model_len--;
+}
+/*---------------------------------------------------------------------------*/
+static void
+model_touch(uint8_t a)
+{
+  int i = model_find(a);
+  if(i >= 0) {
+    model_remove_at(i);
+  }
+  model[model_len++] = a;
+}
+/*---------------------------------------------------------------------------*/
+/* Adds to the table and the model. Returns 0 on a mismatch. */
+static int
+add_and_check(uint8_t a)
+{
+  struct test_nbr *n;
+  int expected = -1;
+  int i;
+
+  if(model_find(a) < 0 && model_len == NBR_TABLE_MAX_NEIGHBORS) {
+    /* At capacity: the least recently used unlocked neighbor goes */
+    for(i = 0; i < model_len; i++) {
+      if(!model_locked[model[i]]) {
+        expected = model[i];
+        break;
+      }
+    }
+    if(expected < 0) {
+      return add(a) == NULL && evicted == NULL;
+    }
+  }
+
+  n = add(a);
+  if(n == NULL || n->id != a) {
+    return 0;
+  }
+  if(expected >= 0) {
+    if(evicted == NULL || !linkaddr_cmp(evicted, &addrs[expected])) {
+      return 0;
+    }
+    model_locked[expected] = 0;
+    model_remove_at(model_find(expected));
+  } else if(evicted != NULL) {
+    return 0;
+  }
+  model_touch(a);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Looks up every address, in the table order of the model so that the
+ * recency order is unchanged */
+static int
+table_matches_model(void)
+{
+  uint8_t order[NBR_TABLE_MAX_NEIGHBORS];
+  uint8_t len = model_len;
+  int a;
+  int i;
+
+  for(a = 0; a < NUM_ADDRS; a++) {
+    if(model_find(a) < 0 && lookup(a) != NULL) {
+      return 0;
+    }
+  }
+  memcpy(order, model, len);
+  for(i = 0; i < len; i++) {
+    struct test_nbr *n = lookup(order[i]);
+    if(n == NULL || n->id != order[i]
+       || !linkaddr_cmp(nbr_table_get_lladdr(test_nbrs, n), &addrs[order[i]])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(nbr_collide, "Colliding addresses are all found");
+UNIT_TEST(nbr_collide)
+{
+  int a;
+
+  UNIT_TEST_BEGIN();
+
+  clear_table();
+  /* All from the last bucket: the probe sequence wraps to the start */
+  for(a = ADDRS_PER_HOME; a < 2 * ADDRS_PER_HOME; a++) {
+    UNIT_TEST_ASSERT(home_bucket(&addrs[a]) == NBR_TABLE_HASH_SIZE - 1);
+    UNIT_TEST_ASSERT(add_and_check(a));
+  }
+  UNIT_TEST_ASSERT(table_matches_model());
+
+  /* Adding a resident address again does not take a new entry */
+  UNIT_TEST_ASSERT(add_and_check(ADDRS_PER_HOME));
+  UNIT_TEST_ASSERT(evicted == NULL);
+  UNIT_TEST_ASSERT(table_matches_model());
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(nbr_evict_wrap, "Evictions shift back wrapped entries");
+UNIT_TEST(nbr_evict_wrap)
+{
+  int a;
+
+  UNIT_TEST_BEGIN();
+
+  clear_table();
+  /* Fill from the last bucket, wrapping to the start */
+  for(a = ADDRS_PER_HOME; a < 2 * ADDRS_PER_HOME; a++) {
+    UNIT_TEST_ASSERT(add_and_check(a));
+  }
+  /* The first one, at the end of the index, goes: all the others must be
+   * shifted back across the end */
+  UNIT_TEST_ASSERT(add_and_check(0));
+  UNIT_TEST_ASSERT(evicted != NULL && linkaddr_cmp(evicted, &addrs[ADDRS_PER_HOME]));
+  UNIT_TEST_ASSERT(table_matches_model());
+
+  /* A lookup makes a neighbor the most recently used: the next one goes */
+  UNIT_TEST_ASSERT(lookup(ADDRS_PER_HOME + 1) != NULL);
+  model_touch(ADDRS_PER_HOME + 1);
+  UNIT_TEST_ASSERT(add_and_check(1));
+  UNIT_TEST_ASSERT(evicted != NULL && linkaddr_cmp(evicted, &addrs[ADDRS_PER_HOME + 2]));
+  UNIT_TEST_ASSERT(table_matches_model());
+
+  /* Home buckets before and after the end */
+  for(a = 2 * ADDRS_PER_HOME; a < NUM_ADDRS; a++) {
+    UNIT_TEST_ASSERT(add_and_check(a));
+    UNIT_TEST_ASSERT(table_matches_model());
+  }
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(nbr_evict_locked, "Locked neighbors are never evicted");
+UNIT_TEST(nbr_evict_locked)
+{
+  int a;
+
+  UNIT_TEST_BEGIN();
+
+  clear_table();
+  for(a = 0; a < NBR_TABLE_MAX_NEIGHBORS; a++) {
+    UNIT_TEST_ASSERT(add_and_check(a));
+    UNIT_TEST_ASSERT(nbr_table_lock(test_nbrs, lookup(a)));
+    model_touch(a);
+    model_locked[a] = 1;
+  }
+  /* Full and locked: no room */
+  UNIT_TEST_ASSERT(add_and_check(NUM_ADDRS - 1));
+  UNIT_TEST_ASSERT(lookup(NUM_ADDRS - 1) == NULL);
+
+  /* The only unlocked neighbor goes, wherever it is in the recency order */
+  UNIT_TEST_ASSERT(nbr_table_unlock(test_nbrs, lookup(3)));
+  model_touch(3);
+  model_locked[3] = 0;
+  UNIT_TEST_ASSERT(add_and_check(NUM_ADDRS - 1));
+  UNIT_TEST_ASSERT(evicted != NULL && linkaddr_cmp(evicted, &addrs[3]));
+  UNIT_TEST_ASSERT(table_matches_model());
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST_REGISTER(nbr_random, "Random adds, lookups and locks match a model");
+UNIT_TEST(nbr_random)
+{
+  int ok = 1;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  clear_table();
+  for(i = 0; ok && i < NUM_RANDOM_OPS; i++) {
+    uint8_t a = random_rand() % NUM_ADDRS;
+    struct test_nbr *n;
+    switch(random_rand() % 4) {
+    case 0:
+    case 1:
+      ok = add_and_check(a);
+      break;
+    case 2:
+      n = lookup(a);
+      ok = (n != NULL) == (model_find(a) >= 0);
+      if(n != NULL) {
+        model_touch(a);
+      }
+      break;
+    default:
+      /* Lock or unlock, keeping some room for evictions */
+      n = lookup(a);
+      if(n != NULL) {
+        model_touch(a);
+        if(model_locked[a]) {
+          nbr_table_unlock(test_nbrs, n);
+          model_locked[a] = 0;
+        } else if(random_rand() % 2) {
+          nbr_table_lock(test_nbrs, n);
+          model_locked[a] = 1;
+        }
+      }
+      break;
+    }
+    if(i % 50 == 0) {
+      ok = ok && table_matches_model();
+    }
+  }
+  UNIT_TEST_ASSERT(ok && table_matches_model());
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("Run unit-test\n");
+  printf("---\n");
+
+  random_init(0);
+  nbr_table_register(test_nbrs, removed_callback);
+  make_addrs();
+
+  UNIT_TEST_RUN(nbr_collide);
+  UNIT_TEST_RUN(nbr_evict_wrap);
+  UNIT_TEST_RUN(nbr_evict_locked);
+  UNIT_TEST_RUN(nbr_random);
+
+  if(unit_test_nbr_collide.result == unit_test_failure ||
+     unit_test_nbr_evict_wrap.result == unit_test_failure ||
+     unit_test_nbr_evict_locked.result == unit_test_failure ||
+     unit_test_nbr_random.result == unit_test_failure) {
+    printf("=check-me= FAILED\n");
+    printf("---\n");
+  }
+
+  printf("=check-me= DONE\n");
+  printf("---\n");
+
+  PROCESS_END();
+}